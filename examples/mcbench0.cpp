@@ -0,0 +1,148 @@
+#include <mi4/marching_cubes.hpp>
+#include <mi4/Timer.hpp>
+#include <iostream>
+#include <iterator>
+// cells per second of the marching cubes kernels on a noisy sphere.
+template <typename V>
+static size_t polygonize_array ( const mi4::VolumeData<float>& volume, const float isovalue, mi4::Mesh& mesh )
+{
+        const auto& info = volume.getInfo();
+        const auto size = info.getSize();
+        std::array<V, 8> value;
+        std::array<V, 8> iso;
+        iso.fill ( isovalue );
+        size_t numTriangles = 0;
+
+        for ( int z = 0 ; z < size.z() - 1 ; ++z ) {
+                for ( int y = 0 ; y < size.y() - 1 ; ++y ) {
+                        const float* row[4] = { volume.data ( y, z ), volume.data ( y + 1, z ), volume.data ( y, z + 1 ), volume.data ( y + 1, z + 1 ) };
+
+                        for ( int x = 0 ; x < size.x() - 1 ; ++x ) {
+                                for ( int i = 0 ; i < 8 ; ++i ) {
+                                        value[i] = row[i >> 1][x + ( i & 1 )];
+                                }
+
+                                numTriangles += mi4::polygonize_cell ( value, iso, 1.0e-3, [&info, x, y, z] ( const int i ) {
+                                        return info.getPointInSpace ( mi4::Point3i ( x + ( i & 1 ), y + ( ( i >> 1 ) & 1 ), z + ( i >> 2 ) ) );
+                                }, [&mesh] ( const int, const Eigen::Vector3d & p, const double ) {
+                                        return mesh.addPoint ( p );
+                                }, mesh );
+                        }
+                }
+        }
+
+        return numTriangles;
+}
+
+/**
+ * Kernel before the std::array one : function-local vector tables and a vector of tuples per cell.
+ */
+static int legacy_polygonize_cell ( std::vector<mi4::cell_type>& cell, mi4::Mesh& mesh, std::vector<float>& isovalue, const double iso_eps )
+{
+        const static std::vector<int> edtable ( std::begin ( mc_edtable ), std::end ( mc_edtable ) );
+        const static std::vector<int> colidx ( std::begin ( mc_colidx ), std::end ( mc_colidx ) );
+        const static std::vector<int> idxtable ( std::begin ( mc_idxtable ), std::end ( mc_idxtable ) );
+        unsigned char tableid = 0x00;
+        int numTriangles = 0;
+
+        for ( int i = 0 ; i < 8 ; ++i ) {
+                auto& c = cell.at ( i );
+                auto& voxel_value = std::get<1> ( c );
+                auto& iso_value  = std::get<2> ( c );
+
+                if ( std::fabs ( voxel_value - iso_value ) < iso_eps ) {
+                        voxel_value = iso_value + iso_eps ;
+                }
+
+                if ( iso_value <=  voxel_value ) {
+                        tableid = static_cast<unsigned char> ( tableid | ( 0x01 << i ) );
+                }
+        }
+
+        if ( tableid != 0x00 && tableid != 0xFF ) {
+                Eigen::Vector3d ep[12];
+                double iso[12];
+
+                for ( int i = 0 ; i < 12 ; i++ ) {
+                        const auto& id0 = edtable[ 2 * i + 0];
+                        const auto& id1 = edtable[ 2 * i + 1];
+                        const auto& c0 = cell.at ( id0 );
+                        const auto& c1 = cell.at ( id1 );
+                        const auto& v0 = std::get<1> ( c0 );
+                        const auto& v1 = std::get<1> ( c1 );
+
+                        if ( ( ( tableid >> id0 ) & 0x01 )  == ( ( tableid >> id1 ) & 0x01 ) ) {
+                                continue;
+                        }
+
+                        const auto& iso0 = std::get<2> ( c0 );
+                        const auto& iso1 = std::get<2> ( c1 );
+                        const auto t = - ( v0 - iso0 )  / ( ( v1 - v0 ) - ( iso1 - iso0 ) ) ;
+                        ep[i]  = ( 1.0 - t ) * std::get<0> ( c0 ) + t * std::get<0> ( c1 );
+                        iso[i] = ( 1.0 - t ) * v0 + t * v1;
+                }
+
+                for ( int i =  colidx[tableid] ; i < colidx[tableid + 1] ; i += 3 ) {
+                        ++numTriangles;
+                        std::vector<size_t> index;
+
+                        for ( int j = 0 ; j < 3 ; ++j ) {
+                                const int e = idxtable[i + j];
+                                isovalue.push_back ( static_cast<float> ( iso[e] ) );
+                                index.push_back ( mesh.addPoint ( ep[e] ) );
+                        }
+
+                        mesh.addFace ( index );
+                }
+        }
+
+        return numTriangles;
+}
+
+static size_t polygonize_vector ( const mi4::VolumeData<float>& volume, const float isovalue, mi4::Mesh& mesh )
+{
+        const auto& info = volume.getInfo();
+        std::vector<float> value;
+        size_t numTriangles = 0;
+
+        for ( const auto& p : mi4::Range ( info.getMin(), info.getMax() - mi4::Point3i ( 1, 1, 1 ) ) ) {
+                std::vector<mi4::cell_type> cell;
+                cell.reserve ( 8 );
+
+                for ( const auto& dp : mi4::Range ( mi4::Point3i ( 0, 0, 0 ), mi4::Point3i ( 1, 1, 1 ) ) ) {
+                        cell.push_back ( std::make_tuple ( info.getPointInSpace ( p + dp ), volume.get ( p + dp ), isovalue ) );
+                }
+
+                numTriangles += legacy_polygonize_cell ( cell, mesh, value, 1.0e-3 );
+        }
+
+        return numTriangles;
+}
+
+template <class Function>
+static void bench ( const std::string& key, const mi4::VolumeData<float>& volume, const Function& fn )
+{
+        mi4::Mesh mesh;
+        mi4::Timer timer ( key, false );
+        const size_t numTriangles = fn ( volume, 40.0f, mesh );
+        timer.end();
+        const double numCells = static_cast<double> ( ( volume.getSize() - mi4::Point3i ( 1, 1, 1 ) ).prod() );
+        std::cout << timer.toString() << ", " << numTriangles << " triangles, "
+                  << numCells / std::max ( timer.time(), 1.0e-3 ) << " cells/sec" << std::endl;
+}
+
+int main ( int argc, char** argv )
+{
+        const int n = ( argc > 1 ) ? std::atoi ( argv[1] ) : 128;
+        mi4::VolumeData<float> volume ( mi4::VolumeInfo ( mi4::Point3i ( n, n, n ) ) );
+
+        for ( const auto& p : mi4::Range ( volume.getInfo() ) ) {
+                const double r = ( p - mi4::Point3i ( n / 2, n / 2, n / 2 ) ).cast<double>().norm();
+                volume.set ( p, static_cast<float> ( r + 2.0 * std::sin ( 0.7 * p.x() ) * std::cos ( 0.5 * p.y() ) ) );
+        }
+
+        bench ( "legacy vector<cell_type>", volume, polygonize_vector );
+        bench ( "array<double, 8>", volume, polygonize_array<double> );
+        bench ( "array<float, 8>", volume, polygonize_array<float> );
+        return 0;
+}
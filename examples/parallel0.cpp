@@ -1,6 +1,7 @@
 #include <mi4/ParallelFor.hpp>
 #include <iostream>
 #include <mutex>
+#include <functional>
 static std::mutex mutex;
 class fn
 {
@@ -31,6 +32,15 @@ int main ( int argc, char** argv )
         int sum = 0;
         mi4::parallel_for_each ( p.begin(), p.end(), fn ( p, sum ), std::thread::hardware_concurrency() );
         std::cerr << sum << std::endl;
+
+        // reduction without locks.
+        sum = mi4::parallel_reduce ( 0, p.size(), 0, [&p] ( const size_t b, const size_t e, int value ) {
+                for ( size_t i = b ; i < e ; ++i ) {
+                        value += p[i];
+                }
+                return value;
+        }, std::plus<int>() );
+        std::cerr << sum << std::endl;
         sum = 0;
 
         for ( auto i : p ) {
@@ -0,0 +1,341 @@
+/**
+ * @file  BinaryVolume.hpp
+ * @author Takashi Michikawa <michiawa@acm.org>
+ */
+#ifndef MI4_BINARY_VOLUME_HPP
+#define MI4_BINARY_VOLUME_HPP 1
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "VolumeData.hpp"
+#include "ParallelFor.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace mi4 {
+        inline int popcount64 (const uint64_t w)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+                return __builtin_popcountll(w);
+#elif defined(_MSC_VER) && defined(_M_X64)
+                return static_cast<int> (__popcnt64(w));
+#else
+                uint64_t v = w - ((w >> 1) & 0x5555555555555555ULL);
+                v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+                v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+                return static_cast<int> ((v * 0x0101010101010101ULL) >> 56);
+#endif
+        }
+
+        /**
+         * @brief Binary volume with 1 bit per voxel.
+         *
+         * Each x-row is packed into 64-voxel words (bit i of word j is voxel x = 64 * j + i).
+         * Bits beyond the row length are always zero.
+         */
+        class BinaryVolume {
+        public:
+                using word_type = uint64_t;
+                static constexpr int word_bits = 64;
+                using buffer_type = std::vector< word_type, AlignedAllocator< word_type > >;
+
+                explicit BinaryVolume (const VolumeInfo& info = VolumeInfo())
+                {
+                        this->init(info);
+                }
+
+                explicit BinaryVolume (const VolumeData< char >& data)
+                {
+                        this->fromVolumeData(data);
+                }
+
+                BinaryVolume (const BinaryVolume& that) = default;
+                BinaryVolume& operator = (const BinaryVolume& that) = default;
+                BinaryVolume (BinaryVolume&& that) = default;
+                BinaryVolume& operator = (BinaryVolume&& that) = default;
+                ~BinaryVolume (void) = default;
+
+                BinaryVolume& init (const VolumeInfo& info)
+                {
+                        this->info_ = info;
+                        const auto& size = info.getSize();
+                        this->wordsPerRow_ = (size.x() + word_bits - 1) / word_bits;
+                        this->words_.assign(static_cast<size_t> (this->wordsPerRow_) * static_cast<size_t> (size.y()) * static_cast<size_t> (size.z()), 0);
+                        return *this;
+                }
+
+                const VolumeInfo& getInfo (void) const
+                {
+                        return this->info_;
+                }
+
+                Point3i getSize (void) const
+                {
+                        return this->info_.getSize();
+                }
+
+                int getWordsPerRow (void) const
+                {
+                        return this->wordsPerRow_;
+                }
+
+                size_t getNumWords (void) const
+                {
+                        return this->words_.size();
+                }
+
+                bool get (const Point3i& p) const
+                {
+                        return this->at(p.x(), p.y(), p.z());
+                }
+
+                void set (const Point3i& p, const bool v)
+                {
+                        this->set(p.x(), p.y(), p.z(), v);
+                }
+
+                bool at (const int x, const int y, const int z) const
+                {
+                        return ((this->row(y, z)[x / word_bits] >> (x % word_bits)) & 1) != 0;
+                }
+
+                void set (const int x, const int y, const int z, const bool v)
+                {
+                        auto& w = this->row(y, z)[x / word_bits];
+                        const word_type bit = word_type(1) << (x % word_bits);
+                        w = v ? (w | bit) : (w & ~bit);
+                }
+
+                /**
+                 * @brief Set voxels [x, x + length) of the x-row (y, z) word by word.
+                 */
+                BinaryVolume& setRun (const int x, const int y, const int z, const int length)
+                {
+                        auto* w = this->row(y, z);
+                        const int end = x + length;
+                        for ( int x0 = x ; x0 < end ; ) {
+                                const int bit = x0 % word_bits;
+                                const int n = std::min(word_bits - bit, end - x0);
+                                w[x0 / word_bits] |= (n == word_bits) ? ~word_type(0) : (((word_type(1) << n) - 1) << bit);
+                                x0 += n;
+                        }
+                        return *this;
+                }
+
+                word_type* data (void)
+                {
+                        return this->words_.data();
+                }
+
+                const word_type* data (void) const
+                {
+                        return this->words_.data();
+                }
+
+                /**
+                 * @brief Words of the x-row (y, z).
+                 */
+                word_type* row (const int y, const int z)
+                {
+                        return this->words_.data() + this->row_offset(y, z);
+                }
+
+                const word_type* row (const int y, const int z) const
+                {
+                        return this->words_.data() + this->row_offset(y, z);
+                }
+
+                /**
+                 * @brief Number of voxels set.
+                 */
+                size_t count (void) const
+                {
+                        const auto* w = this->words_.data();
+                        return mi4::parallel_transform_reduce(0, this->words_.size(), size_t(0), [w] (const size_t i) {
+                                return static_cast<size_t> (mi4::popcount64(w[i]));
+                        }, std::plus< size_t >());
+                }
+
+                BinaryVolume& fill (const bool v)
+                {
+                        std::fill(this->words_.begin(), this->words_.end(), v ? ~word_type(0) : word_type(0));
+                        return v ? this->clear_tail() : *this;
+                }
+
+                BinaryVolume& operator &= (const BinaryVolume& that)
+                {
+                        return this->apply(that, [] (const word_type a, const word_type b) { return a & b; });
+                }
+
+                BinaryVolume& operator |= (const BinaryVolume& that)
+                {
+                        return this->apply(that, [] (const word_type a, const word_type b) { return a | b; });
+                }
+
+                BinaryVolume& operator ^= (const BinaryVolume& that)
+                {
+                        return this->apply(that, [] (const word_type a, const word_type b) { return a ^ b; });
+                }
+
+                /**
+                 * @brief this = this & ~that.
+                 */
+                BinaryVolume& andNot (const BinaryVolume& that)
+                {
+                        return this->apply(that, [] (const word_type a, const word_type b) { return a & ~b; });
+                }
+
+                BinaryVolume& negate (void)
+                {
+                        auto* w = this->words_.data();
+                        mi4::parallel_for(0, this->words_.size(), [w] (const size_t b, const size_t e) {
+                                for ( size_t i = b ; i < e ; ++i ) {
+                                        w[i] = ~w[i];
+                                }
+                        }, 4096);
+                        return this->clear_tail();
+                }
+
+                BinaryVolume operator ~ (void) const
+                {
+                        return BinaryVolume(*this).negate();
+                }
+
+                /**
+                 * @brief Shifted volume : result(p) = this(p - d). Voxels shifted in are 0.
+                 */
+                BinaryVolume shift (const Point3i& d) const
+                {
+                        BinaryVolume result(this->info_);
+                        const auto& size = this->getSize();
+                        const int nw = this->wordsPerRow_;
+                        const int wshift = ((d.x() >= 0) ? d.x() : -d.x()) / word_bits;
+                        const int bshift = ((d.x() >= 0) ? d.x() : -d.x()) % word_bits;
+
+                        mi4::parallel_for(0, static_cast<size_t> (size.z()), [&] (const size_t b, const size_t e) {
+                                for ( auto z = static_cast<int> (b) ; z < static_cast<int> (e) ; ++z ) {
+                                        const int sz = z - d.z();
+                                        if ( sz < 0 || size.z() <= sz ) {
+                                                continue;
+                                        }
+                                        for ( int y = 0 ; y < size.y() ; ++y ) {
+                                                const int sy = y - d.y();
+                                                if ( sy < 0 || size.y() <= sy ) {
+                                                        continue;
+                                                }
+                                                const auto* src = this->row(sy, sz);
+                                                auto* dst = result.row(y, z);
+                                                auto word = [src, nw] (const int i) {
+                                                        return (0 <= i && i < nw) ? src[i] : word_type(0);
+                                                };
+                                                for ( int i = 0 ; i < nw ; ++i ) {
+                                                        if ( d.x() >= 0 ) {
+                                                                const auto lo = word(i - wshift - 1);
+                                                                const auto hi = word(i - wshift);
+                                                                dst[i] = (bshift == 0) ? hi : ((hi << bshift) | (lo >> (word_bits - bshift)));
+                                                        } else {
+                                                                const auto lo = word(i + wshift);
+                                                                const auto hi = word(i + wshift + 1);
+                                                                dst[i] = (bshift == 0) ? lo : ((lo >> bshift) | (hi << (word_bits - bshift)));
+                                                        }
+                                                }
+                                        }
+                                }
+                        });
+                        return result.clear_tail();
+                }
+
+                bool fromVolumeData (const VolumeData< char >& data, const char bg = 0)
+                {
+                        this->init(data.getInfo());
+                        const auto& size = this->getSize();
+                        mi4::parallel_for(0, static_cast<size_t> (size.z()), [&] (const size_t b, const size_t e) {
+                                for ( auto z = static_cast<int> (b) ; z < static_cast<int> (e) ; ++z ) {
+                                        for ( int y = 0 ; y < size.y() ; ++y ) {
+                                                const char *src = data.data(y, z);
+                                                auto *dst = this->row(y, z);
+                                                for ( int x = 0 ; x < size.x() ; ++x ) {
+                                                        dst[x / word_bits] |= static_cast<word_type> (src[x] != bg) << (x % word_bits);
+                                                }
+                                        }
+                                }
+                        });
+                        return true;
+                }
+
+                VolumeData< char > toVolumeData (const char fg = 1) const
+                {
+                        VolumeData< char > result(this->info_);
+                        const auto& size = this->getSize();
+                        mi4::parallel_for(0, static_cast<size_t> (size.z()), [&] (const size_t b, const size_t e) {
+                                for ( auto z = static_cast<int> (b) ; z < static_cast<int> (e) ; ++z ) {
+                                        for ( int y = 0 ; y < size.y() ; ++y ) {
+                                                const auto *src = this->row(y, z);
+                                                char *dst = result.data(y, z);
+                                                for ( int x = 0 ; x < size.x() ; ++x ) {
+                                                        dst[x] = ((src[x / word_bits] >> (x % word_bits)) & 1) ? fg : 0;
+                                                }
+                                        }
+                                }
+                        });
+                        return result;
+                }
+        private:
+                size_t row_offset (const int y, const int z) const
+                {
+                        assert(0 <= y && y < this->getSize().y() && 0 <= z && z < this->getSize().z());
+                        return static_cast<size_t> (this->wordsPerRow_) * (static_cast<size_t> (y) + static_cast<size_t> (this->getSize().y()) * static_cast<size_t> (z));
+                }
+
+                template < class Operator >
+                BinaryVolume& apply (const BinaryVolume& that, const Operator& op)
+                {
+                        assert(this->getSize() == that.getSize());
+                        auto* w0 = this->words_.data();
+                        const auto* w1 = that.words_.data();
+                        mi4::parallel_for(0, this->words_.size(), [w0, w1, &op] (const size_t b, const size_t e) {
+                                for ( size_t i = b ; i < e ; ++i ) {
+                                        w0[i] = op(w0[i], w1[i]);
+                                }
+                        }, 4096);
+                        return *this;
+                }
+
+                /**
+                 * @brief Reset bits beyond the row length.
+                 */
+                BinaryVolume& clear_tail (void)
+                {
+                        const int rest = this->getSize().x() % word_bits;
+                        if ( rest != 0 && this->wordsPerRow_ > 0 ) {
+                                const word_type mask = (word_type(1) << rest) - 1;
+                                for ( size_t i = static_cast<size_t> (this->wordsPerRow_ - 1) ; i < this->words_.size() ; i += static_cast<size_t> (this->wordsPerRow_)) {
+                                        this->words_[i] &= mask;
+                                }
+                        }
+                        return *this;
+                }
+        private:
+                VolumeInfo info_;
+                int wordsPerRow_;
+                buffer_type words_;
+        };
+
+        inline BinaryVolume operator & (BinaryVolume a, const BinaryVolume& b)
+        {
+                return a &= b;
+        }
+
+        inline BinaryVolume operator | (BinaryVolume a, const BinaryVolume& b)
+        {
+                return a |= b;
+        }
+
+        inline BinaryVolume operator ^ (BinaryVolume a, const BinaryVolume& b)
+        {
+                return a ^= b;
+        }
+}
+#endif// MI4_BINARY_VOLUME_HPP
@@ -0,0 +1,435 @@
+/**
+ * @file  BrickedVolumeData.hpp
+ * @author Takashi Michikawa <michiawa@acm.org>
+ */
+#ifndef MI4_BRICKED_VOLUME_DATA_HPP
+#define MI4_BRICKED_VOLUME_DATA_HPP 1
+#include <cstdio>
+#include <list>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include "VolumeData.hpp"
+
+namespace mi4 {
+        /**
+         * @brief Volume data stored as B^3 bricks.
+         *
+         * Voxels of a brick are contiguous, so 3D neighbourhoods touch a few cache lines instead of several scanlines.
+         * When the number of resident bricks is bounded, the least recently used brick is paged out to a backing file.
+         * A brick that cannot be written stays in memory beyond the bound, and hasPagingError() returns true.
+         * @note References returned by at() are valid until the next access. Not thread-safe.
+         */
+        template < typename T, int B = 16 >
+        class BrickedVolumeData {
+                static_assert(B > 0 && (B & (B - 1)) == 0, "brick size must be a power of two.");
+        public:
+                static constexpr int brick_size = B;
+                static constexpr size_t brick_voxels = static_cast<size_t> (B) * B * B;
+                using brick_type = std::vector< T, AlignedAllocator< T > >;
+        private:
+                BrickedVolumeData (const BrickedVolumeData&) = delete;
+                BrickedVolumeData& operator = (const BrickedVolumeData&) = delete;
+        public:
+                /**
+                 * @param [in] info Volume info.
+                 * @param [in] maxResidentBricks Maximum number of bricks in memory. 0 keeps all bricks in memory.
+                 * @param [in] backingFile Scratch file to which evicted bricks are written. Required when maxResidentBricks > 0.
+                 * It must not exist yet, and is removed when the volume is released.
+                 */
+                explicit BrickedVolumeData (const VolumeInfo& info = VolumeInfo(), const size_t maxResidentBricks = 0, const std::string& backingFile = std::string())
+                {
+                        this->init(info, maxResidentBricks, backingFile);
+                }
+                ~BrickedVolumeData (void)
+                {
+                        this->close_backing_file();
+                }
+                BrickedVolumeData (BrickedVolumeData&& that) = default;
+
+                /**
+                 * @brief Move assignment. The current backing file is removed first.
+                 */
+                BrickedVolumeData& operator = (BrickedVolumeData&& that)
+                {
+                        if ( this != &that ) {
+                                this->close_backing_file();
+                                this->info_ = that.info_;
+                                this->numBricks_ = that.numBricks_;
+                                this->capacity_ = that.capacity_;
+                                this->slots_ = std::move(that.slots_);
+                                this->slotOwner_ = std::move(that.slotOwner_);
+                                this->dirty_ = std::move(that.dirty_);
+                                this->freeSlots_ = std::move(that.freeSlots_);
+                                this->lru_ = std::move(that.lru_);
+                                this->lruPos_ = std::move(that.lruPos_);
+                                this->brickSlot_ = std::move(that.brickSlot_);
+                                this->stored_ = std::move(that.stored_);
+                                this->lastBrick_ = that.lastBrick_;
+                                this->lastSlot_ = that.lastSlot_;
+                                this->pagingError_ = that.pagingError_;
+                                this->backingFileName_ = std::move(that.backingFileName_);
+                                this->backing_ = std::move(that.backing_);
+                        }
+                        return *this;
+                }
+
+                BrickedVolumeData& init (const VolumeInfo& info, const size_t maxResidentBricks = 0, const std::string& backingFile = std::string())
+                {
+                        this->close_backing_file();
+                        this->info_ = info;
+                        const auto& size = info.getSize();
+                        this->numBricks_ = (size + Point3i::Constant(B - 1)) / B;
+                        const auto nb = this->getNumBricks();
+
+                        this->capacity_ = (maxResidentBricks == 0) ? nb : std::min(maxResidentBricks, nb);
+                        this->slots_.clear();
+                        this->slotOwner_.clear();
+                        this->dirty_.clear();
+                        this->lru_.clear();
+                        this->lruPos_.clear();
+                        this->brickSlot_.assign(nb, -1);
+                        this->stored_.assign(nb, false);
+                        this->lastBrick_ = -1;
+                        this->lastSlot_ = -1;
+                        this->pagingError_ = false;
+                        this->backingFileName_ = backingFile;
+
+                        if ( this->capacity_ < nb ) {
+                                if ( backingFile.empty()) {
+                                        std::cerr << " error : backing file is required for bounded brick cache." << std::endl;
+                                        this->capacity_ = nb;
+                                } else if ( std::ifstream(backingFile.c_str()).is_open()) {
+                                        std::cerr << " error : " << backingFile << " already exists." << std::endl;
+                                        this->capacity_ = nb;
+                                } else {
+                                        this->backing_.open(backingFile.c_str(), std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+                                        if ( !this->backing_ ) {
+                                                std::cerr << " error : " << backingFile << " cannot be open." << std::endl;
+                                                this->capacity_ = nb;
+                                        }
+                                }
+                        }
+                        return *this;
+                }
+
+                const VolumeInfo& getInfo (void) const
+                {
+                        return this->info_;
+                }
+
+                Point3i getSize (void) const
+                {
+                        return this->getInfo().getSize();
+                }
+
+                Point3i getNumBricksXyz (void) const
+                {
+                        return this->numBricks_;
+                }
+
+                size_t getNumBricks (void) const
+                {
+                        return static_cast<size_t> (this->numBricks_.x()) * static_cast<size_t> (this->numBricks_.y()) * static_cast<size_t> (this->numBricks_.z());
+                }
+
+                size_t getNumResidentBricks (void) const
+                {
+                        return this->slots_.size() - this->freeSlots_.size();
+                }
+
+                size_t getCapacity (void) const
+                {
+                        return this->capacity_;
+                }
+
+                /**
+                 * @brief Whether a brick failed to be paged out or in since init().
+                 */
+                bool hasPagingError (void) const
+                {
+                        return this->pagingError_;
+                }
+
+                /**
+                 * @brief Voxel range covered by a brick (clamped by the volume).
+                 */
+                Range getBrickRange (const size_t brickId) const
+                {
+                        const auto& nb = this->numBricks_;
+                        const auto id = static_cast<int64_t> (brickId);
+                        const Point3i b(static_cast<int> (id % nb.x()), static_cast<int> ((id / nb.x()) % nb.y()), static_cast<int> (id / (static_cast<int64_t> (nb.x()) * nb.y())));
+                        const Point3i bmin = b * B;
+                        const Point3i bmax = (bmin + Point3i::Constant(B - 1)).cwiseMin(this->info_.getMax());
+                        return Range(bmin, bmax);
+                }
+
+                T get (const Point3i& p) const
+                {
+                        return this->at(p);
+                }
+
+                void set (const Point3i& p, const T v)
+                {
+                        this->at(p) = v;
+                }
+
+                T at (const Point3i& p) const
+                {
+                        return this->at(p.x(), p.y(), p.z());
+                }
+
+                T& at (const Point3i& p)
+                {
+                        return this->at(p.x(), p.y(), p.z());
+                }
+
+                T at (const int x, const int y, const int z) const
+                {
+                        assert(this->info_.isValid(Point3i(x, y, z)));
+                        const auto slot = this->acquire(this->brick_id(x, y, z));
+                        return this->slots_[slot][this->voxel_id(x, y, z)];
+                }
+
+                T& at (const int x, const int y, const int z)
+                {
+                        assert(this->info_.isValid(Point3i(x, y, z)));
+                        const auto slot = this->acquire(this->brick_id(x, y, z));
+                        this->dirty_[slot] = true;
+                        return this->slots_[slot][this->voxel_id(x, y, z)];
+                }
+
+                BrickedVolumeData& fill (const T& value = T())
+                {
+                        for ( size_t i = 0 ; i < this->getNumBricks() ; ++i ) {
+                                const auto slot = this->acquire(i);
+                                std::fill(this->slots_[slot].begin(), this->slots_[slot].end(), value);
+                                this->dirty_[slot] = true;
+                        }
+                        return *this;
+                }
+
+                /**
+                 * @brief Write all modified resident bricks to the backing file.
+                 */
+                bool flush (void)
+                {
+                        if ( !this->hasBackingFile()) {
+                                return true;
+                        }
+                        for ( size_t slot = 0 ; slot < this->slots_.size() ; ++slot ) {
+                                if ( this->slotOwner_[slot] >= 0 && this->dirty_[slot] ) {
+                                        if ( !this->page_out(slot)) {
+                                                return false;
+                                        }
+                                }
+                        }
+                        this->backing_.flush();
+                        return this->backing_.good();
+                }
+
+                bool fromVolumeData (const VolumeData< T >& data)
+                {
+                        if ( data.getSize() != this->getSize()) {
+                                std::cerr << " error : size mismatch." << std::endl;
+                                return false;
+                        }
+                        for ( size_t i = 0 ; i < this->getNumBricks() ; ++i ) {
+                                for ( const auto& p : this->getBrickRange(i)) {
+                                        this->at(p) = data.at(p);
+                                }
+                        }
+                        return true;
+                }
+
+                VolumeData< T > toVolumeData (void) const
+                {
+                        VolumeData< T > result(this->getInfo());
+                        for ( size_t i = 0 ; i < this->getNumBricks() ; ++i ) {
+                                for ( const auto& p : this->getBrickRange(i)) {
+                                        result.at(p) = this->at(p);
+                                }
+                        }
+                        return result;
+                }
+        private:
+                size_t brick_id (const int x, const int y, const int z) const
+                {
+                        const auto& nb = this->numBricks_;
+                        return static_cast<size_t> (x / B) + static_cast<size_t> (nb.x()) * (static_cast<size_t> (y / B) + static_cast<size_t> (nb.y()) * static_cast<size_t> (z / B));
+                }
+
+                size_t voxel_id (const int x, const int y, const int z) const
+                {
+                        return static_cast<size_t> ((x & (B - 1)) + B * ((y & (B - 1)) + B * (z & (B - 1))));
+                }
+
+                bool hasBackingFile (void) const
+                {
+                        return this->backing_.is_open();
+                }
+
+                /**
+                 * @brief Make the brick resident and return its slot.
+                 */
+                size_t acquire (const size_t brickId) const
+                {
+                        if ( static_cast<int64_t> (brickId) == this->lastBrick_ ) {
+                                return static_cast<size_t> (this->lastSlot_);
+                        }
+
+                        auto slot = this->brickSlot_[brickId];
+
+                        if ( slot < 0 ) {
+                                slot = static_cast<int64_t> (this->page_in(brickId));
+                        } else if ( this->capacity_ < this->getNumBricks()) {
+                                // move to the most recently used position.
+                                this->lru_.splice(this->lru_.begin(), this->lru_, this->lruPos_[static_cast<size_t> (slot)]);
+                        }
+
+                        this->lastBrick_ = static_cast<int64_t> (brickId);
+                        this->lastSlot_ = slot;
+                        return static_cast<size_t> (slot);
+                }
+
+                size_t page_in (const size_t brickId) const
+                {
+                        size_t slot;
+
+                        if ( !this->freeSlots_.empty()) {
+                                slot = this->freeSlots_.back();
+                                this->freeSlots_.pop_back();
+                        } else if ( this->slots_.size() < this->capacity_ ) {
+                                slot = this->slots_.size();
+                                this->slots_.emplace_back(brick_voxels, T());
+                                this->slotOwner_.push_back(-1);
+                                this->dirty_.push_back(false);
+                                this->lruPos_.push_back(this->lru_.end());
+                        } else {
+                                // bricks that cannot be written are kept.
+                                auto iter = this->lru_.rbegin();
+                                while ( iter != this->lru_.rend() && !this->evict(*iter)) {
+                                        ++iter;
+                                }
+                                if ( iter != this->lru_.rend()) {
+                                        slot = this->freeSlots_.back();
+                                        this->freeSlots_.pop_back();
+                                } else {
+                                        std::cerr << " error : no brick can be paged out. the cache exceeds its capacity." << std::endl;
+                                        slot = this->slots_.size();
+                                        this->slots_.emplace_back(brick_voxels, T());
+                                        this->slotOwner_.push_back(-1);
+                                        this->dirty_.push_back(false);
+                                        this->lruPos_.push_back(this->lru_.end());
+                                }
+                        }
+
+                        auto& brick = this->slots_[slot];
+
+                        if ( this->stored_[brickId] ) {
+                                this->backing_.seekg(this->file_offset(brickId));
+                                this->backing_.read(reinterpret_cast<char *> (brick.data()), static_cast<std::streamsize> (brick_voxels * sizeof(T)));
+                                if ( !this->backing_ ) {
+                                        std::cerr << " error : brick " << brickId << " cannot be read." << std::endl;
+                                        this->backing_.clear();
+                                        this->pagingError_ = true;
+                                }
+                        } else {
+                                std::fill(brick.begin(), brick.end(), T());
+                        }
+
+                        this->brickSlot_[brickId] = static_cast<int64_t> (slot);
+                        this->slotOwner_[slot] = static_cast<int64_t> (brickId);
+                        this->dirty_[slot] = false;
+
+                        if ( this->capacity_ < this->getNumBricks()) {
+                                this->lru_.push_front(slot);
+                                this->lruPos_[slot] = this->lru_.begin();
+                        }
+                        return slot;
+                }
+
+                /**
+                 * @brief Page out the brick and free its slot. The brick stays resident if it cannot be written.
+                 */
+                bool evict (const size_t slot) const
+                {
+                        const auto owner = this->slotOwner_[slot];
+                        if ( this->dirty_[slot] && !this->page_out(slot)) {
+                                return false;
+                        }
+                        this->brickSlot_[static_cast<size_t> (owner)] = -1;
+                        this->slotOwner_[slot] = -1;
+                        this->lru_.erase(this->lruPos_[slot]);
+                        this->lruPos_[slot] = this->lru_.end();
+                        this->freeSlots_.push_back(slot);
+
+                        if ( this->lastBrick_ == owner ) {
+                                this->lastBrick_ = -1;
+                                this->lastSlot_ = -1;
+                        }
+                        return true;
+                }
+
+                bool page_out (const size_t slot) const
+                {
+                        const auto brickId = static_cast<size_t> (this->slotOwner_[slot]);
+                        this->backing_.seekp(this->file_offset(brickId));
+                        this->backing_.write(reinterpret_cast<const char *> (this->slots_[slot].data()), static_cast<std::streamsize> (brick_voxels * sizeof(T)));
+                        // flush so that a failure is reported for this brick, not the next one.
+                        this->backing_.flush();
+                        if ( !this->backing_ ) {
+                                std::cerr << " error : brick " << brickId << " cannot be written." << std::endl;
+                                this->backing_.clear();
+                                this->pagingError_ = true;
+                                return false;
+                        }
+                        this->stored_[brickId] = true;
+                        this->dirty_[slot] = false;
+                        return true;
+                }
+
+                std::streamoff file_offset (const size_t brickId) const
+                {
+                        return static_cast<std::streamoff> (brickId * brick_voxels * sizeof(T));
+                }
+
+                void close_backing_file (void)
+                {
+                        if ( this->hasBackingFile()) {
+                                this->backing_.close();
+                                std::remove(this->backingFileName_.c_str());
+                        }
+                        this->freeSlots_.clear();
+                }
+        private:
+                VolumeInfo info_;
+                Point3i numBricks_;
+                size_t capacity_; ///< Maximum number of resident bricks.
+
+                mutable std::vector< brick_type > slots_; ///< Resident bricks.
+                mutable std::vector< int64_t > slotOwner_; ///< Brick id of each slot. -1 : free.
+                mutable std::vector< bool > dirty_; ///< Modified since paged in.
+                mutable std::vector< size_t > freeSlots_;
+                mutable std::list< size_t > lru_; ///< Slots. front : most recently used.
+                mutable std::vector< std::list< size_t >::iterator > lruPos_;
+
+                mutable std::vector< int64_t > brickSlot_; ///< Slot of each brick. -1 : not resident.
+                mutable std::vector< bool > stored_; ///< Brick has been written to the backing file.
+                mutable int64_t lastBrick_;
+                mutable int64_t lastSlot_;
+                mutable bool pagingError_;
+
+                std::string backingFileName_;
+                mutable std::fstream backing_;
+        };
+
+        template < typename T, int B >
+        constexpr int BrickedVolumeData< T, B >::brick_size;
+
+        template < typename T, int B >
+        constexpr size_t BrickedVolumeData< T, B >::brick_voxels;
+}
+#endif// MI4_BRICKED_VOLUME_DATA_HPP
@@ -0,0 +1,149 @@
+/**
+ * @file ComponentStats.hpp
+ * @author Takashi Michikawa <michikawa@acm.org>
+ */
+#ifndef MI4_COMPONENT_STATS_HPP
+#define MI4_COMPONENT_STATS_HPP 1
+#include <limits>
+#include "VolumeData.hpp"
+
+namespace mi4 {
+        /**
+         * @brief Statistics of a connected component accumulated from run-length codes.
+         * Coordinates are in voxels.
+         * @tparam T Type of voxel values of the component.
+         */
+        template < typename T = char >
+        class ComponentStats {
+        public:
+                ComponentStats (void) : count_(0),
+                                        min_(Point3i::Constant(std::numeric_limits< int >::max())),
+                                        max_(Point3i::Constant(std::numeric_limits< int >::min())),
+                                        sum_(Eigen::Vector3d::Zero()),
+                                        sum2_(Eigen::Matrix3d::Zero()),
+                                        value_(T())
+                {
+                }
+
+                /**
+                 * @brief Add voxels [x, x + length) of row (y, z).
+                 */
+                ComponentStats& addRun (const int x, const int y, const int z, const int length)
+                {
+                        const int x1 = x + length - 1;
+                        const double n = length;
+                        const double sx = 0.5 * n * (x + x1);
+                        const double sxx = ComponentStats::sum_of_squares(x1) - ComponentStats::sum_of_squares(x - 1);
+
+                        this->count_ += static_cast<size_t> (length);
+                        this->min_ = this->min_.cwiseMin(Point3i(x, y, z));
+                        this->max_ = this->max_.cwiseMax(Point3i(x1, y, z));
+                        this->sum_ += Eigen::Vector3d(sx, n * y, n * z);
+
+                        Eigen::Matrix3d m;
+                        m << sxx, sx * y, sx * z,
+                                sx * y, n * y * y, n * y * z,
+                                sx * z, n * y * z, n * z * z;
+                        this->sum2_ += m;
+                        return *this;
+                }
+
+                ComponentStats& merge (const ComponentStats& that)
+                {
+                        this->count_ += that.count_;
+                        this->min_ = this->min_.cwiseMin(that.min_);
+                        this->max_ = this->max_.cwiseMax(that.max_);
+                        this->sum_ += that.sum_;
+                        this->sum2_ += that.sum2_;
+                        return *this;
+                }
+
+                ComponentStats& setValue (const T value)
+                {
+                        this->value_ = value;
+                        return *this;
+                }
+
+                /**
+                 * @brief Voxel value of the component.
+                 */
+                T getValue (void) const
+                {
+                        return this->value_;
+                }
+
+                size_t getCount (void) const
+                {
+                        return this->count_;
+                }
+
+                bool isEmpty (void) const
+                {
+                        return this->count_ == 0;
+                }
+
+                const Point3i& getMin (void) const
+                {
+                        return this->min_;
+                }
+
+                const Point3i& getMax (void) const
+                {
+                        return this->max_;
+                }
+
+                /**
+                 * @brief Size of the bounding box.
+                 */
+                Point3i getSize (void) const
+                {
+                        return this->isEmpty() ? Point3i(0, 0, 0) : Point3i(this->max_ - this->min_ + Point3i(1, 1, 1));
+                }
+
+                Point3d getCentroid (void) const
+                {
+                        return this->isEmpty() ? Point3d(0, 0, 0) : Point3d(this->sum_ / static_cast<double> (this->count_));
+                }
+
+                /**
+                 * @brief Sum of x, y and z of voxels.
+                 */
+                const Eigen::Vector3d& getFirstMoments (void) const
+                {
+                        return this->sum_;
+                }
+
+                /**
+                 * @brief Sum of xx, xy, ... , zz of voxels.
+                 */
+                const Eigen::Matrix3d& getSecondMoments (void) const
+                {
+                        return this->sum2_;
+                }
+
+                Eigen::Matrix3d getCovariance (void) const
+                {
+                        if ( this->isEmpty()) {
+                                return Eigen::Matrix3d::Zero();
+                        }
+                        const auto n = static_cast<double> (this->count_);
+                        const Point3d c = this->getCentroid();
+                        return Eigen::Matrix3d(this->sum2_ / n - c * c.transpose());
+                }
+        private:
+                static double sum_of_squares (const int k)
+                {
+                        // 0^2 + 1^2 + ... + k^2
+                        const double d = k;
+                        return (k < 0) ? 0 : d * (d + 1) * (2 * d + 1) / 6;
+                }
+        private:
+                size_t count_;
+                Point3i min_;
+                Point3i max_;
+                Eigen::Vector3d sum_;
+                Eigen::Matrix3d sum2_;
+                T value_;
+        };
+}
+#endif// MI4_COMPONENT_STATS_HPP
@@ -0,0 +1,286 @@
+/**
+ * @file DualContouring.hpp
+ * @author Takashi Michikawa <michikawa@acm.org>
+ */
+#ifndef MI4_DUAL_CONTOURING_HPP
+#define MI4_DUAL_CONTOURING_HPP 1
+#include <vector>
+#include <array>
+#include <memory>
+#include <algorithm>
+#include <Eigen/Dense>
+#include "VolumeData.hpp"
+#include "Mesh.hpp"
+#include "MinMaxPyramid.hpp"
+#include "ParallelFor.hpp"
+#include "mc_table.hpp"
+
+namespace mi4 {
+        /**
+         * @brief Isosurface with one vertex per cell.
+         *
+         * A cell is intersected when some of its corners are >= isovalue and the others are not. Each intersected
+         * cell has a vertex, and each intersected edge is a quad (two triangles) of the four cells around it.
+         * The vertex is the mean of the intersections of the edges of the cell (SurfaceNets) or the minimizer of the
+         * quadratic error of the tangent planes at the intersections, with normals from the gradients (Qef).
+         * Qef vertices are clamped to the cell.
+         *
+         * As VolumeDataPolygonizer, blocks of cells are skipped with a MinMaxPyramid kept until update(),
+         * and z-slabs are processed in parallel. The mesh does not depend on the slab size.
+         */
+        template < typename T >
+        class DualContouring {
+        public:
+                enum class Method {
+                        SurfaceNets,
+                        Qef
+                };
+
+                explicit DualContouring (const VolumeData< T >& data) : data_(data), slabSize_(0)
+                {
+                }
+
+                /**
+                 * @brief Discard the min/max pyramid of the volume. Call it after the volume is modified.
+                 */
+                DualContouring& update (void)
+                {
+                        this->pyramid_.reset();
+                        return *this;
+                }
+
+                /**
+                 * @param [in] slabSize Number of slices of cells per slab. 0 chooses it from the number of threads.
+                 */
+                DualContouring& setSlabSize (const int slabSize = 0)
+                {
+                        this->slabSize_ = slabSize;
+                        return *this;
+                }
+
+                Mesh polygonize (const double isovalue, const Method method = Method::SurfaceNets)
+                {
+                        const Point3i size = this->data_.getSize();
+                        const int numSlices = size.z() - 1;
+                        if ( size.x() < 2 || size.y() < 2 || numSlices < 1 ) {
+                                return Mesh();
+                        }
+                        if ( !this->pyramid_ ) {
+                                this->pyramid_.reset(new MinMaxPyramid< T >(this->data_));
+                        }
+
+                        this->slab_ = (this->slabSize_ > 0) ? this->slabSize_ : (numSlices - 1) / static_cast<int> (4 * mi4::ThreadPool::getInstance().getNumThreads()) + 1;
+                        const auto numSlabs = static_cast<size_t> ((numSlices + this->slab_ - 1) / this->slab_);
+                        const auto active = this->pyramid_->getActiveBlocks(isovalue, isovalue);
+                        std::vector< Slab > slabs(numSlabs);
+
+                        // vertices of cells.
+                        mi4::parallel_for(0, numSlabs, [&] (const size_t b, const size_t e) {
+                                for ( size_t i = b ; i < e ; ++i ) {
+                                        const int z0 = static_cast<int> (i) * this->slab_;
+                                        this->find_vertices(isovalue, method, active, z0, std::min(z0 + this->slab_, numSlices), slabs[i]);
+                                }
+                        });
+
+                        Mesh mesh;
+                        for ( auto& s : slabs ) {
+                                s.offset = mesh.getNumVertices();
+                                for ( const auto& p : s.points ) {
+                                        mesh.addPoint(p);
+                                }
+                        }
+
+                        // quads of edges.
+                        mi4::parallel_for(0, numSlabs, [&] (const size_t b, const size_t e) {
+                                for ( size_t i = b ; i < e ; ++i ) {
+                                        this->find_faces(isovalue, slabs, slabs[i]);
+                                }
+                        });
+
+                        for ( const auto& s : slabs ) {
+                                for ( size_t i = 0 ; i < s.faces.size() ; i += 3 ) {
+                                        mesh.addFace(s.faces[i], s.faces[i + 1], s.faces[i + 2]);
+                                }
+                        }
+                        return mesh;
+                }
+        private:
+                struct Slab {
+                        std::vector< int64_t > cells; ///< Indices of intersected cells in ascending order.
+                        std::vector< Point3d > points; ///< Vertices of the cells.
+                        std::vector< size_t > faces;
+                        size_t offset; ///< Vertex id of the first cell.
+                };
+
+                static Point3i corner (const int i)
+                {
+                        return Point3i(i & 1, (i >> 1) & 1, i >> 2);
+                }
+
+                int64_t cell_index (const Point3i& c) const
+                {
+                        const Point3i n = this->data_.getSize() - Point3i(1, 1, 1);
+                        return (static_cast<int64_t> (c.z()) * n.y() + c.y()) * n.x() + c.x();
+                }
+
+                void find_vertices (const double isovalue, const Method method, const std::vector< char >& active, const int z0, const int z1, Slab& slab) const
+                {
+                        const auto& info = this->data_.getInfo();
+                        const Point3i size = info.getSize();
+                        const int bs = this->pyramid_->getBlockSize();
+                        const Point3i numBlocks = this->pyramid_->getNumBlocks();
+                        std::array< double, 8 > value;
+
+                        for ( int z = z0 ; z < z1 ; ++z ) {
+                                for ( int y = 0 ; y < size.y() - 1 ; ++y ) {
+                                        const size_t row = (static_cast<size_t> (z / bs) * numBlocks.y() + y / bs) * numBlocks.x();
+                                        const T *vrow[4] = {this->data_.data(y, z), this->data_.data(y + 1, z), this->data_.data(y, z + 1), this->data_.data(y + 1, z + 1)};
+                                        for ( int x = 0 ; x < size.x() - 1 ; ++x ) {
+                                                if ( !active[row + x / bs] ) {
+                                                        x += bs - 1 - x % bs;
+                                                        continue;
+                                                }
+
+                                                unsigned int code = 0;
+                                                for ( int i = 0 ; i < 8 ; ++i ) {
+                                                        value[i] = static_cast<double> (vrow[i >> 1][x + (i & 1)]);
+                                                        code |= (isovalue <= value[i]) ? (0x01u << i) : 0x00u;
+                                                }
+                                                if ( code == 0x00 || code == 0xFF ) {
+                                                        continue;
+                                                }
+
+                                                const Point3i p(x, y, z);
+                                                slab.cells.push_back(this->cell_index(p));
+                                                slab.points.push_back(this->find_vertex(p, value, code, isovalue, method));
+                                        }
+                                }
+                        }
+                }
+
+                Point3d find_vertex (const Point3i& p, const std::array< double, 8 >& value, const unsigned int code, const double isovalue, const Method method) const
+                {
+                        const auto& info = this->data_.getInfo();
+                        Point3d ep[12];
+                        Eigen::Vector3d en[12];
+                        int k = 0;
+                        Point3d mean(0, 0, 0);
+                        for ( int e = 0 ; e < 12 ; ++e ) {
+                                const int i0 = mc_edtable[2 * e];
+                                const int i1 = mc_edtable[2 * e + 1];
+                                if ( ((code >> i0) & 0x01) == ((code >> i1) & 0x01)) {
+                                        continue;
+                                }
+                                const double t = (isovalue - value[i0]) / (value[i1] - value[i0]);
+                                ep[k] = (1.0 - t) * info.getPointInSpace(p + corner(i0)) + t * info.getPointInSpace(p + corner(i1));
+                                if ( method == Method::Qef ) {
+                                        en[k] = ((1.0 - t) * this->gradient(p + corner(i0)) + t * this->gradient(p + corner(i1))).normalized();
+                                }
+                                mean += ep[k];
+                                ++k;
+                        }
+                        mean /= k;
+
+                        if ( method == Method::SurfaceNets ) {
+                                return mean;
+                        }
+
+                        // minimize sum (n_i . (x - p_i))^2 around the mean with small eigenvalues truncated.
+                        Eigen::Matrix3d ata = Eigen::Matrix3d::Zero();
+                        Eigen::Vector3d atb = Eigen::Vector3d::Zero();
+                        for ( int i = 0 ; i < k ; ++i ) {
+                                ata += en[i] * en[i].transpose();
+                                atb += en[i] * en[i].dot(ep[i] - mean);
+                        }
+                        const Eigen::SelfAdjointEigenSolver< Eigen::Matrix3d > solver(ata);
+                        const Eigen::Vector3d& lambda = solver.eigenvalues();
+                        Eigen::Vector3d inv = Eigen::Vector3d::Zero();
+                        for ( int i = 0 ; i < 3 ; ++i ) {
+                                if ( lambda[i] > 0.01 * lambda.maxCoeff()) {
+                                        inv[i] = 1.0 / lambda[i];
+                                }
+                        }
+                        const Point3d x = mean + solver.eigenvectors() * inv.asDiagonal() * solver.eigenvectors().transpose() * atb;
+
+                        if ( !x.allFinite()) {
+                                return mean;
+                        }
+                        return x.cwiseMax(info.getPointInSpace(p)).cwiseMin(info.getPointInSpace(p + Point3i(1, 1, 1)));
+                }
+
+                /**
+                 * @brief Gradient by central differences (one-sided at the border).
+                 */
+                Eigen::Vector3d gradient (const Point3i& p) const
+                {
+                        const Point3i size = this->data_.getSize();
+                        const auto& pitch = this->data_.getInfo().getPitch();
+                        Eigen::Vector3d g;
+                        for ( int k = 0 ; k < 3 ; ++k ) {
+                                Point3i p0 = p;
+                                Point3i p1 = p;
+                                p0[k] = std::max(p[k] - 1, 0);
+                                p1[k] = std::min(p[k] + 1, size[k] - 1);
+                                g[k] = (p1[k] == p0[k]) ? 0 : (static_cast<double> (this->data_.get(p1)) - static_cast<double> (this->data_.get(p0))) / ((p1[k] - p0[k]) * pitch[k]);
+                        }
+                        return g;
+                }
+
+                /**
+                 * @brief Vertex id of cell c in slabs.
+                 * @param [out] point Position of the vertex.
+                 */
+                size_t find_vertex_id (const std::vector< Slab >& slabs, const Point3i& c, Point3d& point) const
+                {
+                        const Slab& s = slabs[static_cast<size_t> (c.z() / this->slab_)];
+                        const auto i = static_cast<size_t> (std::lower_bound(s.cells.begin(), s.cells.end(), this->cell_index(c)) - s.cells.begin());
+                        point = s.points[i];
+                        return s.offset + i;
+                }
+
+                /**
+                 * @brief Quads of the intersected edges from corner 0 of cells of the slab.
+                 */
+                void find_faces (const double isovalue, const std::vector< Slab >& slabs, Slab& slab) const
+                {
+                        const Point3i n = this->data_.getSize() - Point3i(1, 1, 1);
+                        for ( const auto idx : slab.cells ) {
+                                const Point3i p(static_cast<int> (idx % n.x()), static_cast<int> ((idx / n.x()) % n.y()), static_cast<int> (idx / (static_cast<int64_t> (n.x()) * n.y())));
+                                const bool isAbove = isovalue <= static_cast<double> (this->data_.get(p));
+                                for ( int d = 0 ; d < 3 ; ++d ) {
+                                        const int u = (d + 1) % 3;
+                                        const int v = (d + 2) % 3;
+                                        if ( p[u] == 0 || p[v] == 0 || isAbove == (isovalue <= static_cast<double> (this->data_.get(p + Point3i::Unit(d))))) {
+                                                continue;
+                                        }
+
+                                        // cells around the edge, counterclockwise around +d.
+                                        const Point3i cell[4] = {p - Point3i::Unit(u) - Point3i::Unit(v), p - Point3i::Unit(v), p, p - Point3i::Unit(u)};
+                                        size_t id[4];
+                                        Point3d q[4];
+                                        for ( int i = 0 ; i < 4 ; ++i ) {
+                                                id[i] = this->find_vertex_id(slabs, cell[i], q[i]);
+                                        }
+                                        // same orientation as marching cubes.
+                                        if ( !isAbove ) {
+                                                std::swap(id[1], id[3]);
+                                                std::swap(q[1], q[3]);
+                                        }
+
+                                        // split along the shorter diagonal.
+                                        if ( (q[0] - q[2]).squaredNorm() <= (q[1] - q[3]).squaredNorm()) {
+                                                slab.faces.insert(slab.faces.end(), {id[0], id[1], id[2], id[0], id[2], id[3]});
+                                        } else {
+                                                slab.faces.insert(slab.faces.end(), {id[0], id[1], id[3], id[1], id[2], id[3]});
+                                        }
+                                }
+                        }
+                }
+        private:
+                const VolumeData< T >& data_;
+                int slabSize_;
+                int slab_;
+                std::unique_ptr< MinMaxPyramid< T > > pyramid_;
+        };
+}
+#endif// MI4_DUAL_CONTOURING_HPP
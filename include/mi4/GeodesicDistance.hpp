@@ -0,0 +1,264 @@
+/**
+ * @file GeodesicDistance.hpp
+ * @author Takashi Michikawa <michikawa@acm.org>
+ */
+#ifndef MI4_GEODESIC_DISTANCE_HPP
+#define MI4_GEODESIC_DISTANCE_HPP 1
+#include <cmath>
+#include <vector>
+#include <atomic>
+#include <limits>
+#include <algorithm>
+#include <utility>
+#include "VolumeData.hpp"
+#include "PriorityQueue.hpp"
+#include "ParallelFor.hpp"
+
+namespace mi4 {
+        /**
+         * @brief Geodesic distance by the first-order Eikonal equation |grad T| = 1 / speed, honouring the pitch of the volume.
+         *
+         * Voxels of speed <= 0 are obstacles. Distances of voxels unreachable from the seeds are infinity.
+         * FastMarching floods with an IndexedPriorityQueue. FastSweeping splits the volume into z-slabs and sweeps
+         * slabs of the same parity in parallel (neighbouring slabs are read only), until nothing changes.
+         * Both converge to the same discrete solution.
+         */
+        class GeodesicDistance {
+        public:
+                enum class Method {
+                        FastMarching,
+                        FastSweeping
+                };
+
+                explicit GeodesicDistance (const VolumeData< float >& speed) : speed_(speed)
+                {
+                }
+
+                /**
+                 * @brief Add a seed of the distance.
+                 */
+                GeodesicDistance& addSeed (const Point3i& p, const float distance = 0)
+                {
+                        this->seeds_.emplace_back(p, distance);
+                        return *this;
+                }
+
+                GeodesicDistance& clearSeeds (void)
+                {
+                        this->seeds_.clear();
+                        return *this;
+                }
+
+                /**
+                 * @param [in] method Method.
+                 * @param [in] slabSize Number of slices per slab of FastSweeping. 0 chooses it from the number of threads.
+                 */
+                VolumeData< float > compute (const Method method = Method::FastMarching, const int slabSize = 0) const
+                {
+                        VolumeData< float > result(this->speed_.getInfo());
+                        result.fill(std::numeric_limits< float >::infinity());
+                        std::vector< char > isSeed(result.getNumVoxels(), 0);
+                        for ( const auto& seed : this->seeds_ ) {
+                                if ( result.getInfo().isValid(seed.first)) {
+                                        const auto i = static_cast<size_t> (result.getInfo().toIndex(seed.first));
+                                        result.data()[i] = std::min(result.data()[i], seed.second);
+                                        isSeed[i] = 1;
+                                }
+                        }
+
+                        if ( method == Method::FastMarching ) {
+                                this->fast_marching(result, isSeed);
+                        } else {
+                                this->fast_sweeping(result, isSeed, slabSize);
+                        }
+                        return result;
+                }
+        private:
+                void fast_marching (VolumeData< float >& result, const std::vector< char >& isSeed) const
+                {
+                        const auto& size = result.getSize();
+                        const auto n = static_cast<int64_t> (result.getNumVoxels());
+                        const int64_t sx = size.x();
+                        const int64_t sxy = sx * static_cast<int64_t> (size.y());
+                        float *dist = result.data();
+                        std::vector< char > isKnown(static_cast<size_t> (n), 0);
+
+                        IndexedPriorityQueue< float > pq(n);
+                        for ( int64_t i = 0 ; i < n ; ++i ) {
+                                if ( isSeed[static_cast<size_t> (i)] ) {
+                                        pq.push(i, dist[i]);
+                                }
+                        }
+
+                        auto value = [dist, &isKnown] (const int64_t i) {
+                                return isKnown[static_cast<size_t> (i)] ? dist[i] : std::numeric_limits< float >::infinity();
+                        };
+
+                        while ( !pq.empty()) {
+                                const auto u = pq.getTopIndex();
+                                pq.pop();
+                                isKnown[static_cast<size_t> (u)] = 1;
+
+                                const int64_t z = u / sxy;
+                                const int64_t y = (u % sxy) / sx;
+                                const int64_t x = u % sx;
+                                const int64_t nbr[6] = {
+                                        (x > 0) ? u - 1 : -1, (x + 1 < sx) ? u + 1 : -1,
+                                        (y > 0) ? u - sx : -1, (y + 1 < size.y()) ? u + sx : -1,
+                                        (z > 0) ? u - sxy : -1, (z + 1 < size.z()) ? u + sxy : -1
+                                };
+                                for ( const auto v : nbr ) {
+                                        if ( v < 0 || isKnown[static_cast<size_t> (v)] || isSeed[static_cast<size_t> (v)] ) {
+                                                continue;
+                                        }
+                                        const float t = this->update(v, size, value);
+                                        if ( t < dist[v] ) {
+                                                dist[v] = t;
+                                                pq.push(v, t);
+                                        }
+                                }
+                        }
+                }
+
+                void fast_sweeping (VolumeData< float >& result, const std::vector< char >& isSeed, const int slabSize) const
+                {
+                        const auto& size = result.getSize();
+                        const int numSlices = size.z();
+                        if ( numSlices == 0 ) {
+                                return;
+                        }
+                        const int slab = (slabSize > 0) ? slabSize : (numSlices - 1) / static_cast<int> (2 * mi4::ThreadPool::getInstance().getNumThreads()) + 1;
+                        const int numSlabs = (numSlices + slab - 1) / slab;
+                        const float tolerance = 1.0e-6f * static_cast<float> (result.getInfo().getPitch().minCoeff());
+
+                        bool isChanged = true;
+                        while ( isChanged ) {
+                                std::atomic< bool > changed(false);
+                                // slabs of the same parity do not touch each other.
+                                for ( int parity = 0 ; parity < 2 ; ++parity ) {
+                                        const auto numTasks = static_cast<size_t> ((numSlabs - parity + 1) / 2);
+                                        mi4::parallel_for(0, numTasks, [&] (const size_t b, const size_t e) {
+                                                for ( auto t = b ; t < e ; ++t ) {
+                                                        const int z0 = (static_cast<int> (t) * 2 + parity) * slab;
+                                                        const int z1 = std::min(z0 + slab, numSlices);
+                                                        while ( this->sweep(result, isSeed, z0, z1, tolerance)) {
+                                                                changed = true;
+                                                        }
+                                                }
+                                        });
+                                }
+                                isChanged = changed;
+                        }
+                }
+
+                /**
+                 * @brief Gauss-Seidel sweeps of slices [z0, z1) in the 8 orderings.
+                 * @return true if some voxel decreased more than tolerance.
+                 */
+                bool sweep (VolumeData< float >& result, const std::vector< char >& isSeed, const int z0, const int z1, const float tolerance) const
+                {
+                        const auto& size = result.getSize();
+                        const int64_t sx = size.x();
+                        const int64_t sxy = sx * static_cast<int64_t> (size.y());
+                        float *dist = result.data();
+                        auto value = [dist] (const int64_t i) {
+                                return dist[i];
+                        };
+
+                        bool isChanged = false;
+                        for ( int dir = 0 ; dir < 8 ; ++dir ) {
+                                const int dx = (dir & 1) ? -1 : 1;
+                                const int dy = (dir & 2) ? -1 : 1;
+                                const int dz = (dir & 4) ? -1 : 1;
+                                for ( int iz = 0 ; iz < z1 - z0 ; ++iz ) {
+                                        const int z = (dz > 0) ? z0 + iz : z1 - 1 - iz;
+                                        for ( int iy = 0 ; iy < size.y() ; ++iy ) {
+                                                const int y = (dy > 0) ? iy : size.y() - 1 - iy;
+                                                for ( int ix = 0 ; ix < size.x() ; ++ix ) {
+                                                        const int x = (dx > 0) ? ix : size.x() - 1 - ix;
+                                                        const int64_t i = z * sxy + y * sx + x;
+                                                        if ( isSeed[static_cast<size_t> (i)] || !(this->speed_.data()[i] > 0)) {
+                                                                continue;
+                                                        }
+                                                        const float t = this->update(i, size, value);
+                                                        if ( t < dist[i] ) {
+                                                                isChanged |= !(dist[i] - t <= tolerance);
+                                                                dist[i] = t;
+                                                        }
+                                                }
+                                        }
+                                }
+                        }
+                        return isChanged;
+                }
+
+                /**
+                 * @brief Upwind solution at voxel i from the neighbour values value(j).
+                 */
+                template < class Function >
+                float update (const int64_t i, const Point3i& size, const Function& value) const
+                {
+                        const float f = this->speed_.data()[i];
+                        if ( !(f > 0)) {
+                                return std::numeric_limits< float >::infinity();
+                        }
+
+                        const auto& pitch = this->speed_.getInfo().getPitch();
+                        const int64_t sx = size.x();
+                        const int64_t sxy = sx * static_cast<int64_t> (size.y());
+                        const int64_t z = i / sxy;
+                        const int64_t y = (i % sxy) / sx;
+                        const int64_t x = i % sx;
+                        const int64_t coord[3] = {x, y, z};
+                        const int64_t stride[3] = {1, sx, sxy};
+
+                        // minimum neighbour value and pitch of each axis.
+                        std::pair< double, double > a[3];
+                        for ( int k = 0 ; k < 3 ; ++k ) {
+                                double v = std::numeric_limits< double >::infinity();
+                                if ( coord[k] > 0 ) {
+                                        v = std::min(v, static_cast<double> (value(i - stride[k])));
+                                }
+                                if ( coord[k] + 1 < size[k] ) {
+                                        v = std::min(v, static_cast<double> (value(i + stride[k])));
+                                }
+                                a[k] = std::make_pair(v, pitch[k]);
+                        }
+                        std::sort(a, a + 3);
+                        return static_cast<float> (GeodesicDistance::solve(a, 1.0 / f));
+                }
+
+                /**
+                 * @brief Largest T with sum_k ((T - a_k) / h_k)^2 = r^2 over the smallest a_k that are less than T.
+                 * @param [in] a Sorted pairs of (a_k, h_k).
+                 */
+                static double solve (const std::pair< double, double > a[3], const double r)
+                {
+                        if ( std::isinf(a[0].first)) {
+                                return std::numeric_limits< double >::infinity();
+                        }
+
+                        double t = a[0].first + a[0].second * r;
+                        double s0 = 0, s1 = 0, s2 = 0; // sum of 1 / h^2, a / h^2, a^2 / h^2.
+                        for ( int k = 0 ; k < 3 ; ++k ) {
+                                if ( t <= a[k].first ) {
+                                        break;
+                                }
+                                const double w = 1.0 / (a[k].second * a[k].second);
+                                s0 += w;
+                                s1 += w * a[k].first;
+                                s2 += w * a[k].first * a[k].first;
+                                const double d = s1 * s1 - s0 * (s2 - r * r);
+                                if ( d < 0 ) {
+                                        break;
+                                }
+                                t = (s1 + std::sqrt(d)) / s0;
+                        }
+                        return t;
+                }
+        private:
+                const VolumeData< float >& speed_;
+                std::vector< std::pair< Point3i, float > > seeds_;
+        };
+}
+#endif// MI4_GEODESIC_DISTANCE_HPP
@@ -0,0 +1,234 @@
+/**
+ * @file  MappedFile.hpp
+ * @author Takashi Michikawa <michiawa@acm.org>
+ */
+#ifndef MI4_MAPPED_FILE_HPP
+#define MI4_MAPPED_FILE_HPP 1
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <iostream>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#define MI4_MAPPED_FILE_POSIX 1
+#endif
+
+namespace mi4 {
+        /**
+         * @brief Memory mapping of a (part of) file.
+         */
+        class MappedFile {
+        public:
+                enum class Mode {
+                        ReadOnly,   ///< Pages are read-only.
+                        ReadWrite,  ///< Modifications are written back to the file.
+                        CopyOnWrite ///< Modifications are private to the process.
+                };
+
+                enum class Access {
+                        Normal,
+                        Sequential,
+                        Random,
+                        WillNeed
+                };
+        private:
+                MappedFile (const MappedFile&) = delete;
+                MappedFile& operator = (const MappedFile&) = delete;
+                MappedFile (MappedFile&&) = delete;
+                MappedFile& operator = (MappedFile&&) = delete;
+        public:
+                MappedFile (void) : device_(0), inode_(0), mode_(Mode::ReadOnly), base_(nullptr), mappedSize_(0), data_(nullptr), size_(0)
+                {
+                }
+
+                ~MappedFile (void)
+                {
+                        this->close();
+                }
+
+                /**
+                 * @brief Map length bytes from offset of the file. length = 0 maps the rest of the file.
+                 */
+                bool open (const std::string& filename, const size_t offset = 0, const size_t length = 0, const Mode mode = Mode::ReadOnly)
+                {
+                        this->close();
+#if defined(MI4_MAPPED_FILE_POSIX)
+                        const int fd = ::open(filename.c_str(), (mode == Mode::ReadWrite) ? O_RDWR : O_RDONLY);
+                        if ( fd < 0 ) {
+                                std::cerr << " error : " << filename << " cannot be open." << std::endl;
+                                return false;
+                        }
+
+                        struct stat st;
+                        if ( ::fstat(fd, &st) != 0 || static_cast<size_t> (st.st_size) < offset ) {
+                                std::cerr << " error : invalid offset." << std::endl;
+                                ::close(fd);
+                                return false;
+                        }
+
+                        const size_t size = (length == 0) ? static_cast<size_t> (st.st_size) - offset : length;
+                        if ( static_cast<size_t> (st.st_size) < offset + size ) {
+                                std::cerr << " error : file is too short (" << st.st_size << " < " << offset + size << ")." << std::endl;
+                                ::close(fd);
+                                return false;
+                        }
+                        if ( size == 0 ) {
+                                ::close(fd);
+                                std::cerr << " error : nothing to map." << std::endl;
+                                return false;
+                        }
+
+                        // mmap requires page-aligned offset.
+                        const auto page = static_cast<size_t> (::sysconf(_SC_PAGESIZE));
+                        const size_t head = offset % page;
+                        const int prot = (mode == Mode::ReadOnly) ? PROT_READ : (PROT_READ | PROT_WRITE);
+                        const int flags = (mode == Mode::ReadWrite) ? MAP_SHARED : MAP_PRIVATE;
+                        void *base = ::mmap(nullptr, size + head, prot, flags, fd, static_cast<off_t> (offset - head));
+                        ::close(fd);
+
+                        if ( base == MAP_FAILED ) {
+                                std::cerr << " error : mmap failed." << std::endl;
+                                return false;
+                        }
+
+                        this->filename_ = filename;
+                        this->device_ = static_cast<uint64_t> (st.st_dev);
+                        this->inode_ = static_cast<uint64_t> (st.st_ino);
+                        this->mode_ = mode;
+                        this->base_ = base;
+                        this->mappedSize_ = size + head;
+                        this->data_ = static_cast<char *> (base) + head;
+                        this->size_ = size;
+                        return true;
+#else
+                        std::cerr << " error : memory mapping is not supported on this platform." << std::endl;
+                        return false;
+#endif
+                }
+
+                void close (void)
+                {
+#if defined(MI4_MAPPED_FILE_POSIX)
+                        if ( this->base_ != nullptr ) {
+                                ::munmap(this->base_, this->mappedSize_);
+                        }
+#endif
+                        this->filename_.clear();
+                        this->device_ = 0;
+                        this->inode_ = 0;
+                        this->base_ = nullptr;
+                        this->mappedSize_ = 0;
+                        this->data_ = nullptr;
+                        this->size_ = 0;
+                }
+
+                /**
+                 * @brief Flush modified pages to the file (ReadWrite mode only).
+                 */
+                bool sync (const bool async = false)
+                {
+#if defined(MI4_MAPPED_FILE_POSIX)
+                        if ( this->isOpen() && this->mode_ == Mode::ReadWrite ) {
+                                return ::msync(this->base_, this->mappedSize_, async ? MS_ASYNC : MS_SYNC) == 0;
+                        }
+#else
+                        (void) async;
+#endif
+                        return false;
+                }
+
+                /**
+                 * @brief Give the kernel a hint of the access pattern.
+                 */
+                bool advise (const Access access)
+                {
+#if defined(MI4_MAPPED_FILE_POSIX)
+                        if ( !this->isOpen()) {
+                                return false;
+                        }
+                        int advice = MADV_NORMAL;
+                        switch ( access ) {
+                                case Access::Sequential:
+                                        advice = MADV_SEQUENTIAL;
+                                        break;
+                                case Access::Random:
+                                        advice = MADV_RANDOM;
+                                        break;
+                                case Access::WillNeed:
+                                        advice = MADV_WILLNEED;
+                                        break;
+                                case Access::Normal:
+                                default:
+                                        advice = MADV_NORMAL;
+                                        break;
+                        }
+                        return ::madvise(this->base_, this->mappedSize_, advice) == 0;
+#else
+                        (void) access;
+                        return false;
+#endif
+                }
+
+                bool isOpen (void) const
+                {
+                        return this->data_ != nullptr;
+                }
+
+                bool isWritable (void) const
+                {
+                        return this->isOpen() && this->mode_ != Mode::ReadOnly;
+                }
+
+                Mode getMode (void) const
+                {
+                        return this->mode_;
+                }
+
+                const std::string& getFileName (void) const
+                {
+                        return this->filename_;
+                }
+
+                /**
+                 * @brief Whether filename refers to the mapped file. Compared by device and inode, not by name.
+                 */
+                bool isSameFile (const std::string& filename) const
+                {
+#if defined(MI4_MAPPED_FILE_POSIX)
+                        struct stat st;
+                        if ( !this->isOpen() || ::stat(filename.c_str(), &st) != 0 ) {
+                                return false;
+                        }
+                        return static_cast<uint64_t> (st.st_dev) == this->device_ && static_cast<uint64_t> (st.st_ino) == this->inode_;
+#else
+                        return this->isOpen() && filename == this->filename_;
+#endif
+                }
+
+                void* data (void) const
+                {
+                        return this->data_;
+                }
+
+                size_t size (void) const
+                {
+                        return this->size_;
+                }
+        private:
+                std::string filename_;
+                uint64_t device_;
+                uint64_t inode_;
+                Mode mode_;
+                void *base_; ///< Page-aligned head of the mapping.
+                size_t mappedSize_;
+                void *data_; ///< Head of the requested region.
+                size_t size_;
+        };
+}
+#endif// MI4_MAPPED_FILE_HPP
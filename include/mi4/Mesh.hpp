@@ -51,6 +51,30 @@ namespace mi4
                         return this->_index.size() / 3 ; // ID
                 }
 
+                size_t addFace ( const size_t v0, const size_t v1, const size_t v2 )
+                {
+                        this->_index.push_back ( v0 );
+                        this->_index.push_back ( v1 );
+                        this->_index.push_back ( v2 );
+                        return this->_index.size() / 3 ; // ID
+                }
+
+                /**
+                 * @brief Append vertices and faces of the mesh. Vertex ids of its faces are shifted.
+                 */
+                Mesh& append ( const Mesh& mesh )
+                {
+                        const size_t offset = this->_vertex.size();
+                        this->_vertex.insert ( this->_vertex.end(), mesh._vertex.begin(), mesh._vertex.end() );
+                        this->_index.reserve ( this->_index.size() + mesh._index.size() );
+
+                        for ( const auto idx : mesh._index ) {
+                                this->_index.push_back ( idx + offset );
+                        }
+
+                        return *this;
+                }
+
                 void addName ( const std::string name = std::string ( "mesh" ) )
                 {
                         this->_name = name;
@@ -0,0 +1,191 @@
+/**
+ * @file MinMaxPyramid.hpp
+ * @author Takashi Michikawa <michikawa@acm.org>
+ */
+#ifndef MI4_MIN_MAX_PYRAMID_HPP
+#define MI4_MIN_MAX_PYRAMID_HPP 1
+#include <vector>
+#include <algorithm>
+#include "VolumeData.hpp"
+#include "ParallelFor.hpp"
+
+namespace mi4 {
+        /**
+         * @brief Min / max values of cells in blocks for empty-space skipping.
+         *
+         * Block b of level 0 holds cells [b * blockSize, (b + 1) * blockSize), i.e. voxels
+         * [b * blockSize, (b + 1) * blockSize] including the ones shared with the next block.
+         * A block of level k + 1 holds 2 x 2 x 2 blocks of level k. The top level has one block.
+         */
+        template < typename T >
+        class MinMaxPyramid {
+        public:
+                explicit MinMaxPyramid (const VolumeData< T >& data, const int blockSize = 8)
+                {
+                        this->build(data, blockSize);
+                }
+
+                /**
+                 * @brief Rebuild from the volume, e.g. after it is modified.
+                 */
+                MinMaxPyramid& build (const VolumeData< T >& data, const int blockSize = 8)
+                {
+                        this->blockSize_ = std::max(blockSize, 1);
+                        this->levels_.clear();
+
+                        const Point3i numCells = (data.getSize() - Point3i(1, 1, 1)).cwiseMax(Point3i(1, 1, 1));
+                        Level base;
+                        base.numBlocks = (numCells - Point3i(1, 1, 1)) / this->blockSize_ + Point3i(1, 1, 1);
+                        base.min.resize(static_cast<size_t> (base.numBlocks.prod()));
+                        base.max.resize(base.min.size());
+                        this->levels_.push_back(base);
+                        this->build_base(data);
+
+                        while ( this->levels_.back().numBlocks != Point3i(1, 1, 1)) {
+                                this->build_level();
+                        }
+                        return *this;
+                }
+
+                int getBlockSize (void) const
+                {
+                        return this->blockSize_;
+                }
+
+                int getNumLevels (void) const
+                {
+                        return static_cast<int> (this->levels_.size());
+                }
+
+                Point3i getNumBlocks (const int level = 0) const
+                {
+                        return this->levels_[level].numBlocks;
+                }
+
+                T getMin (const int level, const Point3i& b) const
+                {
+                        return this->levels_[level].min[this->index(level, b)];
+                }
+
+                T getMax (const int level, const Point3i& b) const
+                {
+                        return this->levels_[level].max[this->index(level, b)];
+                }
+
+                /**
+                 * @brief Flags of blocks of level 0 where isActive(level, b) holds for the block and all its ancestors.
+                 * @param [in] isActive bool isActive(int level, const Point3i& b).
+                 */
+                template < class Predicate >
+                std::vector< char > getActiveBlocks (const Predicate& isActive) const
+                {
+                        std::vector< char > parent(1, 1);
+                        for ( int level = this->getNumLevels() - 1 ; level >= 0 ; --level ) {
+                                const Point3i& n = this->levels_[level].numBlocks;
+                                const bool isTop = (level + 1 == this->getNumLevels());
+                                std::vector< char > active(static_cast<size_t> (n.prod()), 0);
+                                size_t i = 0;
+                                for ( const auto& b : Range(Point3i(0, 0, 0), n - Point3i(1, 1, 1)) ) {
+                                        active[i] = (isTop || parent[this->index(level + 1, Point3i(b / 2))]) && isActive(level, b);
+                                        ++i;
+                                }
+                                parent.swap(active);
+                        }
+                        return parent;
+                }
+
+                /**
+                 * @brief Flags of blocks of level 0 whose [min, max] intersects [lower, upper].
+                 */
+                std::vector< char > getActiveBlocks (const double lower, const double upper) const
+                {
+                        return this->getActiveBlocks([this, lower, upper] (const int level, const Point3i& b) {
+                                return !(static_cast<double> (this->getMax(level, b)) < lower || upper < static_cast<double> (this->getMin(level, b)));
+                        });
+                }
+
+                /**
+                 * @brief Flags of blocks of level 0 whose [min, max] intersects [min - eps, max + eps] of the same block of iso.
+                 */
+                template < typename S >
+                std::vector< char > getActiveBlocks (const MinMaxPyramid< S >& iso, const double eps) const
+                {
+                        return this->getActiveBlocks([this, &iso, eps] (const int level, const Point3i& b) {
+                                return !(static_cast<double> (this->getMax(level, b)) < static_cast<double> (iso.getMin(level, b)) - eps ||
+                                         static_cast<double> (iso.getMax(level, b)) + eps < static_cast<double> (this->getMin(level, b)));
+                        });
+                }
+        private:
+                struct Level {
+                        Point3i numBlocks;
+                        std::vector< T > min;
+                        std::vector< T > max;
+                };
+
+                size_t index (const int level, const Point3i& b) const
+                {
+                        const Point3i& n = this->levels_[level].numBlocks;
+                        return static_cast<size_t> ((static_cast<int64_t> (b.z()) * n.y() + b.y()) * n.x() + b.x());
+                }
+
+                void build_base (const VolumeData< T >& data)
+                {
+                        auto& base = this->levels_.front();
+                        const Point3i size = data.getSize();
+                        const Point3i n = base.numBlocks;
+                        const int bs = this->blockSize_;
+                        mi4::parallel_for(0, static_cast<size_t> (n.z()), [&] (const size_t b, const size_t e) {
+                                for ( int bz = static_cast<int> (b) ; bz < static_cast<int> (e) ; ++bz ) {
+                                        for ( int by = 0 ; by < n.y() ; ++by ) {
+                                                for ( int bx = 0 ; bx < n.x() ; ++bx ) {
+                                                        const Point3i bmin = Point3i(bx, by, bz) * bs;
+                                                        const Point3i bmax = (bmin + Point3i::Constant(bs)).cwiseMin(size - Point3i(1, 1, 1));
+                                                        T vmin = data.get(bmin);
+                                                        T vmax = vmin;
+                                                        for ( int z = bmin.z() ; z <= bmax.z() ; ++z ) {
+                                                                for ( int y = bmin.y() ; y <= bmax.y() ; ++y ) {
+                                                                        const T *row = data.data(y, z);
+                                                                        for ( int x = bmin.x() ; x <= bmax.x() ; ++x ) {
+                                                                                vmin = std::min(vmin, row[x]);
+                                                                                vmax = std::max(vmax, row[x]);
+                                                                        }
+                                                                }
+                                                        }
+                                                        const size_t i = this->index(0, Point3i(bx, by, bz));
+                                                        base.min[i] = vmin;
+                                                        base.max[i] = vmax;
+                                                }
+                                        }
+                                }
+                        });
+                }
+
+                void build_level (void)
+                {
+                        const int level = this->getNumLevels() - 1;
+                        Level upper;
+                        upper.numBlocks = (this->levels_[level].numBlocks + Point3i(1, 1, 1)) / 2;
+                        upper.min.resize(static_cast<size_t> (upper.numBlocks.prod()));
+                        upper.max.resize(upper.min.size());
+
+                        const Point3i n = this->levels_[level].numBlocks;
+                        size_t i = 0;
+                        for ( const auto& b : Range(Point3i(0, 0, 0), upper.numBlocks - Point3i(1, 1, 1)) ) {
+                                const Point3i c0 = b * 2;
+                                const Point3i c1 = (c0 + Point3i(1, 1, 1)).cwiseMin(n - Point3i(1, 1, 1));
+                                upper.min[i] = this->getMin(level, c0);
+                                upper.max[i] = this->getMax(level, c0);
+                                for ( const auto& c : Range(c0, c1) ) {
+                                        upper.min[i] = std::min(upper.min[i], this->getMin(level, c));
+                                        upper.max[i] = std::max(upper.max[i], this->getMax(level, c));
+                                }
+                                ++i;
+                        }
+                        this->levels_.push_back(upper);
+                }
+        private:
+                int blockSize_;
+                std::vector< Level > levels_;
+        };
+}
+#endif// MI4_MIN_MAX_PYRAMID_HPP
@@ -0,0 +1,235 @@
+/**
+ * @file NarrowBandDistanceField.hpp
+ * @author Takashi Michikawa <michikawa@acm.org>
+ */
+#ifndef MI4_NARROW_BAND_DISTANCE_FIELD_HPP
+#define MI4_NARROW_BAND_DISTANCE_FIELD_HPP 1
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "VolumeData.hpp"
+#include "VolumeDataUtility.hpp"
+#include "VolumeDataPolygonizer.hpp"
+#include "Mesh.hpp"
+#include "ParallelFor.hpp"
+
+namespace mi4 {
+        /**
+         * @brief Sparse signed distance field storing only bricks near the surface.
+         *
+         * The volume is divided into bricks of brick_size^3 voxels. A brick is stored if it has a voxel with |d| < band
+         * or voxels of both signs. Voxels of the other bricks read as +band or -band.
+         * The band should be larger than the diagonal of a voxel so that every cell crossing the surface is stored.
+         */
+        class NarrowBandDistanceField {
+        public:
+                static constexpr int brick_size = 8;
+                static constexpr int brick_voxels = brick_size * brick_size * brick_size;
+
+                explicit NarrowBandDistanceField (const VolumeInfo& info = VolumeInfo(), const float band = 1)
+                {
+                        this->init(info, band);
+                }
+
+                /**
+                 * @brief Signed distance field of a mask keeping only bricks where |d| < band (see VolumeDataUtility::signedDistanceField()).
+                 * Besides the mask and the stored bricks, each running task holds only a brick layer and the slices within band of it,
+                 * so no dense intermediate of the volume is allocated.
+                 */
+                static NarrowBandDistanceField fromMask (const VolumeData< char >& mask, const float band, const char bg = 0)
+                {
+                        NarrowBandDistanceField result(mask.getInfo(), band);
+                        VolumeDataUtility::signed_edt(mask, bg, brick_size, band, [&result] (const int z0, const int, const float *values) {
+                                result.setBrickLayer(z0 / brick_size, values);
+                        });
+                        return result;
+                }
+
+                NarrowBandDistanceField& init (const VolumeInfo& info, const float band)
+                {
+                        this->info_ = info;
+                        this->band_ = band;
+                        const auto& size = info.getSize();
+                        this->numBricks_ = Point3i((size.x() + brick_size - 1) / brick_size, (size.y() + brick_size - 1) / brick_size, (size.z() + brick_size - 1) / brick_size);
+                        const auto n = static_cast<size_t> (this->numBricks_.x()) * static_cast<size_t> (this->numBricks_.y()) * static_cast<size_t> (this->numBricks_.z());
+                        this->bricks_.assign(n, std::vector< float >());
+                        this->signs_.assign(n, 1);
+                        return *this;
+                }
+
+                const VolumeInfo& getInfo (void) const
+                {
+                        return this->info_;
+                }
+
+                float getBand (void) const
+                {
+                        return this->band_;
+                }
+
+                Point3i getNumBricks (void) const
+                {
+                        return this->numBricks_;
+                }
+
+                size_t getNumActiveBricks (void) const
+                {
+                        return static_cast<size_t> (std::count_if(this->bricks_.begin(), this->bricks_.end(), [] (const std::vector< float >& b) {
+                                return !b.empty();
+                        }));
+                }
+
+                bool isActive (const Point3i& brick) const
+                {
+                        return !this->bricks_[this->get_brick_id(brick)].empty();
+                }
+
+                float get (const Point3i& p) const
+                {
+                        const int bs = brick_size; // not to odr-use brick_size.
+                        const Point3i b(p.x() / bs, p.y() / bs, p.z() / bs);
+                        const auto id = this->get_brick_id(b);
+                        const auto& brick = this->bricks_[id];
+                        if ( brick.empty()) {
+                                return this->signs_[id] * this->band_;
+                        }
+                        return brick[NarrowBandDistanceField::get_local_id(p - b * bs)];
+                }
+
+                /**
+                 * @brief Set bricks of layer bz from slices [bz * brick_size, min((bz + 1) * brick_size, size.z())) of a dense field.
+                 * Different layers may be set concurrently.
+                 */
+                void setBrickLayer (const int bz, const float *values)
+                {
+                        const auto& size = this->info_.getSize();
+                        const int bs = brick_size;
+                        const int z0 = bz * bs;
+                        const int nz = std::min(bs, size.z() - z0);
+                        const auto sx = static_cast<size_t> (size.x());
+                        const auto sliceVoxels = sx * static_cast<size_t> (size.y());
+
+                        for ( int by = 0 ; by < this->numBricks_.y() ; ++by ) {
+                                for ( int bx = 0 ; bx < this->numBricks_.x() ; ++bx ) {
+                                        const int x0 = bx * bs;
+                                        const int y0 = by * bs;
+                                        const int nx = std::min(bs, size.x() - x0);
+                                        const int ny = std::min(bs, size.y() - y0);
+                                        auto value = [&] (const int x, const int y, const int z) {
+                                                return values[sliceVoxels * static_cast<size_t> (z) + sx * static_cast<size_t> (y0 + y) + static_cast<size_t> (x0 + x)];
+                                        };
+
+                                        bool isNear = false;
+                                        bool hasInside = false;
+                                        bool hasOutside = false;
+                                        for ( int z = 0 ; z < nz ; ++z ) {
+                                                for ( int y = 0 ; y < ny ; ++y ) {
+                                                        for ( int x = 0 ; x < nx ; ++x ) {
+                                                                const float v = value(x, y, z);
+                                                                isNear |= (std::fabs(v) < this->band_);
+                                                                hasInside |= (v < 0);
+                                                                hasOutside |= (v >= 0);
+                                                        }
+                                                }
+                                        }
+
+                                        const auto id = this->get_brick_id(Point3i(bx, by, bz));
+                                        this->signs_[id] = hasInside ? -1 : 1;
+                                        if ( !isNear && !(hasInside && hasOutside)) {
+                                                this->bricks_[id].clear();
+                                                continue;
+                                        }
+
+                                        auto& brick = this->bricks_[id];
+                                        brick.assign(brick_voxels, this->signs_[id] * this->band_);
+                                        for ( int z = 0 ; z < nz ; ++z ) {
+                                                for ( int y = 0 ; y < ny ; ++y ) {
+                                                        for ( int x = 0 ; x < nx ; ++x ) {
+                                                                brick[NarrowBandDistanceField::get_local_id(Point3i(x, y, z))] = value(x, y, z);
+                                                        }
+                                                }
+                                        }
+                                }
+                        }
+                }
+
+                VolumeData< float > toVolumeData (void) const
+                {
+                        VolumeData< float > result(this->info_);
+                        mi4::parallel_for(Range(this->info_), [this, &result] (const Range& slab) {
+                                for ( const auto& p : slab ) {
+                                        result.set(p, this->get(p));
+                                }
+                        });
+                        return result;
+                }
+
+                /**
+                 * @brief Iso-surface of the stored bricks by marching cubes.
+                 */
+                Mesh polygonize (const float isovalue = 0) const
+                {
+                        if ( this->bricks_.empty()) {
+                                return Mesh();
+                        }
+
+                        const int bs = brick_size;
+                        std::vector< Point3i > active;
+                        for ( const auto& b : Range(Point3i(0, 0, 0), this->numBricks_ - Point3i(1, 1, 1))) {
+                                if ( this->isActive(b)) {
+                                        active.push_back(b);
+                                }
+                        }
+
+                        std::vector< Mesh > meshes(active.size());
+                        mi4::parallel_for(0, active.size(), [&] (const size_t b, const size_t e) {
+                                for ( auto i = b ; i < e ; ++i ) {
+                                        // cells whose first corner is in the brick.
+                                        const Point3i bmin = active[i] * bs;
+                                        const Point3i bmax = (bmin + Point3i::Constant(bs)).cwiseMin(this->info_.getMax());
+                                        if ( (bmax - bmin).minCoeff() < 1 ) {
+                                                continue;
+                                        }
+                                        VolumeData< float > cells(VolumeInfo(bmax - bmin + Point3i(1, 1, 1), this->info_.getPitch(), this->info_.getPointInSpace(bmin)));
+                                        for ( const auto& p : Range(cells.getInfo())) {
+                                                cells.set(p, this->get(bmin + p));
+                                        }
+                                        meshes[i] = VolumeDataPolygonizer< float >(cells).polygonize(isovalue);
+                                }
+                        });
+
+                        Mesh result;
+                        for ( const auto& mesh : meshes ) {
+                                const size_t offset = result.getNumVertices();
+                                for ( size_t v = 0 ; v < mesh.getNumVertices() ; ++v ) {
+                                        result.addPoint(mesh.getPosition(v));
+                                }
+                                for ( size_t f = 0 ; f < mesh.getNumFaces() ; ++f ) {
+                                        auto idx = mesh.getFaceIndices(f);
+                                        for ( auto& id : idx ) {
+                                                id += offset;
+                                        }
+                                        result.addFace(idx);
+                                }
+                        }
+                        return result;
+                }
+        private:
+                size_t get_brick_id (const Point3i& b) const
+                {
+                        return static_cast<size_t> (b.x()) + static_cast<size_t> (this->numBricks_.x()) * (static_cast<size_t> (b.y()) + static_cast<size_t> (this->numBricks_.y()) * static_cast<size_t> (b.z()));
+                }
+
+                static size_t get_local_id (const Point3i& p)
+                {
+                        return static_cast<size_t> (p.x() + brick_size * (p.y() + brick_size * p.z()));
+                }
+        private:
+                VolumeInfo info_;
+                float band_;
+                Point3i numBricks_;
+                std::vector< std::vector< float > > bricks_;
+                std::vector< signed char > signs_;
+        };
+}
+#endif// MI4_NARROW_BAND_DISTANCE_FIELD_HPP
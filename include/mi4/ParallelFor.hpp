@@ -7,33 +7,140 @@
 
 #include <vector>
 #include <algorithm>
+#include <iterator>
 #include <thread>
 #include <iostream>
+#include "ThreadPool.hpp"
 
 namespace mi4 {
-        template < class Iterator, class Function >
-        void parallel_for_each_by_grain_size (const Iterator begin, const Iterator end, const Function fn, const size_t grainSize = 1000)
+        /**
+         * @brief Call fn(b, e) for sub-ranges of [begin, end) on the process-wide thread pool.
+         */
+        template < class Function >
+        void parallel_for (const size_t begin, const size_t end, const Function& fn, const size_t grainSize = 1)
+        {
+                mi4::ThreadPool::getInstance().parallel_for(begin, end, grainSize, fn);
+        }
+
+        namespace detail {
+                /**
+                 * @brief Partial result padded to a cache line.
+                 * Unlike std::vector<bool>, neighbouring partials can be written by different threads.
+                 */
+                template < typename T >
+                struct padded_value {
+                        T value;
+                        char padding[64];
+                };
+        }
+
+        /**
+         * @brief Reduce [begin, end) in parallel.
+         * @param [in] identity Identity of combine.
+         * @param [in] fn T fn(size_t b, size_t e, T init) accumulates [b, e) onto init.
+         * @param [in] combine T combine(const T& a, const T& b) merges two partial results.
+         * @param [in] grainSize Number of elements per partial result. 0 : chosen by the number of threads.
+         * @return Reduced value.
+         */
+        template < typename T, class Function, class Combine >
+        T parallel_reduce (const size_t begin, const size_t end, const T& identity, const Function& fn, const Combine& combine, const size_t grainSize = 0)
+        {
+                if ( end <= begin ) {
+                        return identity;
+                }
+
+                const size_t length = end - begin;
+                const size_t grain = (grainSize == 0) ? (length - 1) / (4 * mi4::ThreadPool::getInstance().getNumThreads()) + 1 : grainSize;
+                const size_t numChunks = (length - 1) / grain + 1;
+
+                // one partial result per chunk, so no locking is needed.
+                std::vector< detail::padded_value< T > > partials(numChunks, detail::padded_value< T > {identity, {}});
+                mi4::parallel_for(0, numChunks, [&] (const size_t b, const size_t e) {
+                        for ( size_t i = b ; i < e ; ++i ) {
+                                const size_t b0 = begin + i * grain;
+                                partials[i].value = fn(b0, std::min(b0 + grain, end), partials[i].value);
+                        }
+                });
+
+                // pairwise tree combine.
+                for ( size_t step = 1 ; step < numChunks ; step *= 2 ) {
+                        mi4::parallel_for(0, (numChunks - 1) / (2 * step) + 1, [&] (const size_t b, const size_t e) {
+                                for ( size_t i = b ; i < e ; ++i ) {
+                                        const size_t dst = i * 2 * step;
+                                        if ( dst + step < numChunks ) {
+                                                partials[dst].value = combine(partials[dst].value, partials[dst + step].value);
+                                        }
+                                }
+                        });
+                }
+
+                return partials[0].value;
+        }
+
+        /**
+         * @brief Reduce transform(i) for i in [begin, end) in parallel.
+         */
+        template < typename T, class Transform, class Combine >
+        T parallel_transform_reduce (const size_t begin, const size_t end, const T& identity, const Transform& transform, const Combine& combine, const size_t grainSize = 0)
         {
-                std::vector< std::thread > threads;
-                auto start = begin;
-                auto iter = begin;
-
-                while ( start != end ) {
-                        for ( size_t i = 0; (i < grainSize && iter != end); ++i ) ++iter;
-                        threads.push_back(std::thread([] (const Iterator begin, const Iterator end, Function fn) { std::for_each(begin, end, fn); }, start, iter, fn));
-                        start = iter;
+                return mi4::parallel_reduce(begin, end, identity, [&transform, &combine] (const size_t b, const size_t e, T value) {
+                        for ( size_t i = b ; i < e ; ++i ) {
+                                value = combine(value, transform(i));
+                        }
+                        return value;
+                }, combine, grainSize);
+        }
+
+        namespace detail {
+                template < class Iterator >
+                std::vector< Iterator > split_by_grain_size (const Iterator begin, const Iterator end, const size_t grainSize, std::input_iterator_tag)
+                {
+                        std::vector< Iterator > starts;
+                        auto iter = begin;
+
+                        while ( iter != end ) {
+                                starts.push_back(iter);
+                                for ( size_t i = 0; (i < grainSize && iter != end); ++i ) ++iter;
+                        }
+                        starts.push_back(end);
+                        return starts;
                 }
 
-                for ( auto& t : threads ) {
-                        t.join();
+                template < class Iterator >
+                std::vector< Iterator > split_by_grain_size (const Iterator begin, const Iterator end, const size_t grainSize, std::random_access_iterator_tag)
+                {
+                        std::vector< Iterator > starts;
+                        const auto length = static_cast<size_t> (end - begin);
+
+                        for ( size_t i = 0 ; i < length ; i += grainSize ) {
+                                starts.push_back(begin + static_cast<typename std::iterator_traits< Iterator >::difference_type> (i));
+                        }
+                        starts.push_back(end);
+                        return starts;
                 }
         }
 
+        template < class Iterator, class Function >
+        void parallel_for_each_by_grain_size (const Iterator begin, const Iterator end, const Function fn, const size_t grainSize = 1000)
+        {
+                const auto starts = detail::split_by_grain_size(begin, end, std::max< size_t >(grainSize, 1), typename std::iterator_traits< Iterator >::iterator_category());
+
+                // each chunk works on its own copy of fn.
+                mi4::parallel_for(0, starts.size() - 1, [&starts, &fn] (const size_t b, const size_t e) {
+                        for ( size_t i = b ; i < e ; ++i ) {
+                                std::for_each(starts[i], starts[i + 1], Function(fn));
+                        }
+                });
+        }
+
         template < class Iterator, class Function >
         void parallel_for_each (const Iterator begin, const Iterator end, const Function fn, const size_t num_threads = std::thread::hardware_concurrency())
         {
-                mi4::parallel_for_each_by_grain_size(begin, end, fn, static_cast<size_t>((std::distance(begin, end) - 1) / num_threads) + 1);
+                const auto length = std::distance(begin, end);
+                if ( length <= 0 ) {
+                        return;
+                }
+                mi4::parallel_for_each_by_grain_size(begin, end, fn, static_cast<size_t>(length - 1) / std::max< size_t >(num_threads, 1) + 1);
         }
 };
 #endif
-
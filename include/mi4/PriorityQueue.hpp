@@ -1,9 +1,17 @@
 #ifndef MI4_PRIORITY_QUEUE_HPP
 #define MI4_PRIORITY_QUEUE_HPP 1
 
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
 #include <tuple>
-#include <deque>
 #include <queue>
+#include <array>
+#include <limits>
+#include <type_traits>
+#include <algorithm>
+#include <vector>
+#include <iostream>
 
 namespace mi4
 {
@@ -26,7 +34,7 @@ namespace mi4
                 };
 
         private:
-                typename std::priority_queue< queue_t, typename std::deque< queue_t >, PriorityQueue::greater > _pq;
+                typename std::priority_queue< queue_t, typename std::vector< queue_t >, PriorityQueue::greater > _pq;
         public:
                 /**
                  * @brief push key and cost to the queue.
@@ -69,5 +77,359 @@ namespace mi4
                         return this->_pq.size();
                 }
         };
+
+        /**
+         * @class BucketQueue PriorityQueue.hpp "mi/PriorityQueue.hpp"
+         * @brief Finding minimum integer cost in [0, numBuckets) with a bucket per cost.
+         * Push and pop are O(1) amortized when costs pushed are not less than the top cost (monotone).
+         */
+        template <typename T>
+        class BucketQueue
+        {
+        private:
+                std::vector< std::vector<T> > _buckets;
+                size_t _top;
+                size_t _size;
+        public:
+                explicit BucketQueue ( const size_t numBuckets = 0 ) : _buckets ( numBuckets ), _top ( numBuckets ), _size ( 0 )
+                {
+                        return;
+                }
+                /**
+                 * @brief push key and cost to the queue.
+                 * @param [in] idx Index.
+                 * @param [in] cost Cost (< numBuckets).
+                 */
+                void push ( const T& idx, const size_t cost )
+                {
+                        this->_buckets[cost].push_back ( idx );
+                        this->_top = std::min ( this->_top, cost );
+                        ++this->_size;
+                        return;
+                }
+                /**
+                 * @brief Get top index (the last pushed one of the minimum cost).
+                 * @return Index.
+                 */
+                T getTopIndex ( void ) const
+                {
+                        return this->_buckets[this->_top].back();
+                }
+                /**
+                 * @brief Get top (minimum) cost.
+                 * @return Cost.
+                 */
+                size_t getTopCost ( void ) const
+                {
+                        return this->_top;
+                }
+
+                bool empty ( void ) const
+                {
+                        return this->_size == 0;
+                }
+
+                void pop ( void )
+                {
+                        this->_buckets[this->_top].pop_back();
+                        --this->_size;
+                        while ( this->_top < this->_buckets.size() && this->_buckets[this->_top].empty() ) {
+                                ++this->_top;
+                        }
+                }
+
+                size_t size ( void ) const
+                {
+                        return this->_size;
+                }
+        };
+
+        /**
+         * @class IndexedPriorityQueue PriorityQueue.hpp "mi/PriorityQueue.hpp"
+         * @brief D-ary heap of int64_t indices (e.g. VolumeInfo::toIndex()) supporting decrease-key.
+         * Each index is in the queue at most once, so algorithms need not skip stale entries.
+         */
+        template <typename Cost = float, int D = 4>
+        class IndexedPriorityQueue
+        {
+                static_assert ( D >= 2, "D must be >= 2." );
+        private:
+                struct Node {
+                        Cost cost;
+                        int64_t index;
+                };
+                std::vector<Node> _heap;
+                std::vector<int64_t> _position; // position in _heap, -1 if not in the queue.
+        public:
+                /**
+                 * @param [in] numKeys Number of indices (e.g. number of voxels). Indices beyond it extend the table.
+                 */
+                explicit IndexedPriorityQueue ( const int64_t numKeys = 0 )
+                {
+                        this->reserve ( numKeys );
+                        return;
+                }
+                /**
+                 * @brief Prepare the table for indices in [0, numKeys) and heap capacity of numNodes.
+                 */
+                void reserve ( const int64_t numKeys, const size_t numNodes = 0 )
+                {
+                        if ( static_cast<int64_t> ( this->_position.size() ) < numKeys ) {
+                                this->_position.resize ( static_cast<size_t> ( numKeys ), -1 );
+                        }
+                        this->_heap.reserve ( numNodes );
+                        return;
+                }
+                /**
+                 * @brief push index and cost to the queue. If the index is already in the queue, its cost is decreased (never increased).
+                 * @param [in] idx Index (>= 0). Negative indices are rejected.
+                 * @param [in] cost Cost.
+                 */
+                void push ( const int64_t idx, const Cost cost )
+                {
+                        if ( idx < 0 ) {
+                                std::cerr << " error : negative index " << idx << " is not allowed." << std::endl;
+                                return;
+                        }
+                        if ( this->contains ( idx ) ) {
+                                this->decrease ( idx, cost );
+                                return;
+                        }
+
+                        if ( static_cast<int64_t> ( this->_position.size() ) <= idx ) {
+                                this->_position.resize ( std::max ( static_cast<size_t> ( idx ) + 1, this->_position.size() * 2 ), -1 );
+                        }
+                        this->_heap.push_back ( Node { cost, idx } );
+                        this->sift_up ( this->_heap.size() - 1 );
+                        return;
+                }
+                /**
+                 * @brief Decrease the cost of the index in the queue.
+                 * @return false if the index is not in the queue or cost is not less than the current one.
+                 */
+                bool decrease ( const int64_t idx, const Cost cost )
+                {
+                        if ( !this->contains ( idx ) ) {
+                                return false;
+                        }
+                        const auto pos = static_cast<size_t> ( this->_position[static_cast<size_t> ( idx )] );
+                        if ( ! ( cost < this->_heap[pos].cost ) ) {
+                                return false;
+                        }
+                        this->_heap[pos].cost = cost;
+                        this->sift_up ( pos );
+                        return true;
+                }
+
+                bool contains ( const int64_t idx ) const
+                {
+                        return 0 <= idx && idx < static_cast<int64_t> ( this->_position.size() ) && this->_position[static_cast<size_t> ( idx )] >= 0;
+                }
+                /**
+                 * @brief Cost of the index in the queue.
+                 */
+                Cost getCost ( const int64_t idx ) const
+                {
+                        assert ( this->contains ( idx ) );
+                        return this->_heap[static_cast<size_t> ( this->_position[static_cast<size_t> ( idx )] )].cost;
+                }
+                /**
+                 * @brief Get top index.
+                 * @return Index.
+                 */
+                int64_t getTopIndex ( void ) const
+                {
+                        return this->_heap.front().index;
+                }
+                /**
+                 * @brief Get top (minimum) cost.
+                 * @return Cost.
+                 */
+                Cost getTopCost ( void ) const
+                {
+                        return this->_heap.front().cost;
+                }
+
+                bool empty ( void ) const
+                {
+                        return this->_heap.empty();
+                }
+
+                void pop ( void )
+                {
+                        this->_position[static_cast<size_t> ( this->_heap.front().index )] = -1;
+                        if ( this->_heap.size() > 1 ) {
+                                this->_heap.front() = this->_heap.back();
+                                this->_heap.pop_back();
+                                this->sift_down ( 0 );
+                        } else {
+                                this->_heap.pop_back();
+                        }
+                }
+
+                size_t size ( void ) const
+                {
+                        return this->_heap.size();
+                }
+
+                void clear ( void )
+                {
+                        for ( const auto& node : this->_heap ) {
+                                this->_position[static_cast<size_t> ( node.index )] = -1;
+                        }
+                        this->_heap.clear();
+                }
+        private:
+                void sift_up ( size_t pos )
+                {
+                        const Node node = this->_heap[pos];
+                        while ( pos > 0 ) {
+                                const auto parent = ( pos - 1 ) / D;
+                                if ( ! ( node.cost < this->_heap[parent].cost ) ) {
+                                        break;
+                                }
+                                this->place ( pos, this->_heap[parent] );
+                                pos = parent;
+                        }
+                        this->place ( pos, node );
+                }
+
+                void sift_down ( size_t pos )
+                {
+                        const Node node = this->_heap[pos];
+                        const auto n = this->_heap.size();
+                        while ( true ) {
+                                const auto first = pos * D + 1;
+                                if ( first >= n ) {
+                                        break;
+                                }
+                                // the smallest of the children.
+                                auto best = first;
+                                const auto last = std::min ( first + D, n );
+                                for ( auto c = first + 1 ; c < last ; ++c ) {
+                                        if ( this->_heap[c].cost < this->_heap[best].cost ) {
+                                                best = c;
+                                        }
+                                }
+                                if ( ! ( this->_heap[best].cost < node.cost ) ) {
+                                        break;
+                                }
+                                this->place ( pos, this->_heap[best] );
+                                pos = best;
+                        }
+                        this->place ( pos, node );
+                }
+
+                void place ( const size_t pos, const Node& node )
+                {
+                        this->_heap[pos] = node;
+                        this->_position[static_cast<size_t> ( node.index )] = static_cast<int64_t> ( pos );
+                }
+        };
+
+        /**
+         * @class RadixHeap PriorityQueue.hpp "mi/PriorityQueue.hpp"
+         * @brief Priority queue of unsigned integer costs that never go below the last popped cost (e.g. Dijkstra on integer weights).
+         * Each element is moved at most once per bit of the key, so pop is O(log C) amortized.
+         */
+        template <typename T, typename Key = uint32_t>
+        class RadixHeap
+        {
+                static_assert ( std::is_unsigned<Key>::value, "Key must be unsigned." );
+        private:
+                static constexpr int num_bits = std::numeric_limits<Key>::digits;
+                using item_t = std::pair<Key, T>;
+                mutable std::array< std::vector<item_t>, num_bits + 1 > _buckets;
+                mutable Key _last;
+                size_t _size;
+        public:
+                RadixHeap ( void ) : _last ( 0 ), _size ( 0 )
+                {
+                        return;
+                }
+                /**
+                 * @brief push index and cost to the queue.
+                 * @param [in] idx Index.
+                 * @param [in] cost Cost (>= the last popped cost).
+                 */
+                void push ( const T& idx, const Key cost )
+                {
+                        assert ( this->_last <= cost );
+                        this->_buckets[RadixHeap::get_bucket ( cost, this->_last )].emplace_back ( cost, idx );
+                        ++this->_size;
+                        return;
+                }
+                /**
+                 * @brief Get top index.
+                 * @return Index.
+                 */
+                T getTopIndex ( void ) const
+                {
+                        this->pull();
+                        return this->_buckets[0].back().second;
+                }
+                /**
+                 * @brief Get top (minimum) cost.
+                 * @return Cost.
+                 */
+                Key getTopCost ( void ) const
+                {
+                        this->pull();
+                        return this->_last;
+                }
+
+                bool empty ( void ) const
+                {
+                        return this->_size == 0;
+                }
+
+                void pop ( void )
+                {
+                        this->pull();
+                        this->_buckets[0].pop_back();
+                        --this->_size;
+                }
+
+                size_t size ( void ) const
+                {
+                        return this->_size;
+                }
+        private:
+                /**
+                 * @brief Move the minimum elements to bucket 0 by redistributing the first non-empty bucket.
+                 */
+                void pull ( void ) const
+                {
+                        if ( !this->_buckets[0].empty() ) {
+                                return;
+                        }
+                        int i = 1;
+                        while ( this->_buckets[i].empty() ) {
+                                ++i;
+                        }
+                        auto& bucket = this->_buckets[i];
+                        this->_last = std::min_element ( bucket.begin(), bucket.end(), [] ( const item_t & a, const item_t & b ) {
+                                return a.first < b.first;
+                        } )->first;
+                        for ( auto& item : bucket ) {
+                                this->_buckets[RadixHeap::get_bucket ( item.first, this->_last )].push_back ( std::move ( item ) );
+                        }
+                        bucket.clear();
+                }
+
+                /**
+                 * @brief 0 if cost == last, otherwise the position (1-) of the highest bit differing from last.
+                 */
+                static int get_bucket ( const Key cost, const Key last )
+                {
+                        auto x = static_cast<uint64_t> ( cost ^ last );
+                        int n = 0;
+                        while ( x != 0 ) {
+                                x >>= 1;
+                                ++n;
+                        }
+                        return n;
+                }
+        };
 };
 #endif //PRIORITY_QUEUE_HPP
@@ -0,0 +1,660 @@
+/**
+ * @file Simd.hpp
+ * @author Takashi Michikawa <michikawa@acm.org>
+ * @brief Vectorized kernels over contiguous arrays with runtime CPU dispatch.
+ */
+#ifndef MI4_SIMD_HPP
+#define MI4_SIMD_HPP 1
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MI4_SIMD_X86 1
+#include <immintrin.h>
+#define MI4_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define MI4_TARGET_SSE2  __attribute__((target("sse2")))
+#define MI4_TARGET_AVX2  __attribute__((target("avx2")))
+#endif
+
+namespace mi4 {
+        namespace simd {
+                enum class InstructionSet {
+                        Scalar,
+                        SSE2,
+                        SSSE3,
+                        AVX2
+                };
+
+                /**
+                 * @brief Instruction set detected on this CPU.
+                 */
+                inline InstructionSet detectInstructionSet (void)
+                {
+#if defined(MI4_SIMD_X86)
+                        __builtin_cpu_init();
+                        if ( __builtin_cpu_supports("avx2")) {
+                                return InstructionSet::AVX2;
+                        } else if ( __builtin_cpu_supports("ssse3")) {
+                                return InstructionSet::SSSE3;
+                        } else if ( __builtin_cpu_supports("sse2")) {
+                                return InstructionSet::SSE2;
+                        }
+#endif
+                        return InstructionSet::Scalar;
+                }
+
+                /**
+                 * @brief Instruction set used by kernels. It can be lowered (e.g. for testing) but not raised above the detected one.
+                 */
+                inline InstructionSet& getInstructionSet (void)
+                {
+                        static InstructionSet isa = detectInstructionSet();
+                        return isa;
+                }
+
+                inline void setInstructionSet (const InstructionSet isa)
+                {
+                        static const InstructionSet detected = getInstructionSet();
+                        getInstructionSet() = std::min(isa, detected);
+                }
+
+                namespace detail {
+                        template < typename T >
+                        inline T byteswap_scalar (const T v)
+                        {
+                                T result;
+                                const auto *src = reinterpret_cast<const unsigned char *> (&v);
+                                auto *dst = reinterpret_cast<unsigned char *> (&result);
+                                for ( size_t i = 0 ; i < sizeof(T) ; ++i ) {
+                                        dst[i] = src[sizeof(T) - 1 - i];
+                                }
+                                return result;
+                        }
+
+                        /**
+                         * @brief pshufb mask reversing each element of the given size in 16 bytes.
+                         */
+                        inline void byteswap_mask (const size_t size, unsigned char mask[16])
+                        {
+                                for ( size_t i = 0 ; i < 16 ; ++i ) {
+                                        mask[i] = static_cast<unsigned char> ((i / size) * size + (size - 1 - i % size));
+                                }
+                        }
+
+#if defined(MI4_SIMD_X86)
+                        MI4_TARGET_AVX2 inline size_t byteswap_avx2 (unsigned char *p, const size_t nbytes, const size_t size)
+                        {
+                                unsigned char m[16];
+                                byteswap_mask(size, m);
+                                const __m128i m128 = _mm_loadu_si128(reinterpret_cast<const __m128i *> (m));
+                                const __m256i mask = _mm256_broadcastsi128_si256(m128);
+                                size_t i = 0;
+                                for ( ; i + 32 <= nbytes ; i += 32 ) {
+                                        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (p + i));
+                                        _mm256_storeu_si256(reinterpret_cast<__m256i *> (p + i), _mm256_shuffle_epi8(v, mask));
+                                }
+                                return i;
+                        }
+
+                        MI4_TARGET_SSSE3 inline size_t byteswap_ssse3 (unsigned char *p, const size_t nbytes, const size_t size)
+                        {
+                                unsigned char m[16];
+                                byteswap_mask(size, m);
+                                const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i *> (m));
+                                size_t i = 0;
+                                for ( ; i + 16 <= nbytes ; i += 16 ) {
+                                        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p + i));
+                                        _mm_storeu_si128(reinterpret_cast<__m128i *> (p + i), _mm_shuffle_epi8(v, mask));
+                                }
+                                return i;
+                        }
+
+                        /**
+                         * Threshold kernels : out[i] = (in[i] < th) ? 0 : fg for 1-byte outputs.
+                         * Each returns the number of elements processed; the caller finishes the tail.
+                         */
+                        template < typename T >
+                        struct threshold_kernel {
+                                static size_t avx2 (const T *, unsigned char *, const size_t, const T, const unsigned char)
+                                {
+                                        return 0;
+                                }
+                                MI4_TARGET_SSE2 static size_t sse2 (const T *, unsigned char *, const size_t, const T, const unsigned char)
+                                {
+                                        return 0;
+                                }
+                        };
+
+                        template <>
+                        struct threshold_kernel< uint8_t > {
+                                MI4_TARGET_AVX2 static size_t avx2 (const uint8_t *in, unsigned char *out, const size_t n, const uint8_t th, const unsigned char fg)
+                                {
+                                        const __m256i t = _mm256_set1_epi8(static_cast<char> (th));
+                                        const __m256i f = _mm256_set1_epi8(static_cast<char> (fg));
+                                        size_t i = 0;
+                                        for ( ; i + 32 <= n ; i += 32 ) {
+                                                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (in + i));
+                                                const __m256i ge = _mm256_cmpeq_epi8(_mm256_max_epu8(v, t), v);
+                                                _mm256_storeu_si256(reinterpret_cast<__m256i *> (out + i), _mm256_and_si256(ge, f));
+                                        }
+                                        return i;
+                                }
+                                MI4_TARGET_SSE2 static size_t sse2 (const uint8_t *in, unsigned char *out, const size_t n, const uint8_t th, const unsigned char fg)
+                                {
+                                        const __m128i t = _mm_set1_epi8(static_cast<char> (th));
+                                        const __m128i f = _mm_set1_epi8(static_cast<char> (fg));
+                                        size_t i = 0;
+                                        for ( ; i + 16 <= n ; i += 16 ) {
+                                                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *> (in + i));
+                                                const __m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(v, t), v);
+                                                _mm_storeu_si128(reinterpret_cast<__m128i *> (out + i), _mm_and_si128(ge, f));
+                                        }
+                                        return i;
+                                }
+                        };
+
+                        template < typename T8 >
+                        struct threshold_kernel_s8 {
+                                MI4_TARGET_AVX2 static size_t avx2 (const T8 *in, unsigned char *out, const size_t n, const T8 th, const unsigned char fg)
+                                {
+                                        const __m256i t = _mm256_set1_epi8(static_cast<char> (th));
+                                        const __m256i f = _mm256_set1_epi8(static_cast<char> (fg));
+                                        size_t i = 0;
+                                        for ( ; i + 32 <= n ; i += 32 ) {
+                                                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (in + i));
+                                                const __m256i lt = _mm256_cmpgt_epi8(t, v);
+                                                _mm256_storeu_si256(reinterpret_cast<__m256i *> (out + i), _mm256_andnot_si256(lt, f));
+                                        }
+                                        return i;
+                                }
+                                MI4_TARGET_SSE2 static size_t sse2 (const T8 *in, unsigned char *out, const size_t n, const T8 th, const unsigned char fg)
+                                {
+                                        const __m128i t = _mm_set1_epi8(static_cast<char> (th));
+                                        const __m128i f = _mm_set1_epi8(static_cast<char> (fg));
+                                        size_t i = 0;
+                                        for ( ; i + 16 <= n ; i += 16 ) {
+                                                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *> (in + i));
+                                                const __m128i lt = _mm_cmpgt_epi8(t, v);
+                                                _mm_storeu_si128(reinterpret_cast<__m128i *> (out + i), _mm_andnot_si128(lt, f));
+                                        }
+                                        return i;
+                                }
+                        };
+
+                        template <>
+                        struct threshold_kernel< int8_t > : public threshold_kernel_s8< int8_t > {
+                        };
+
+                        template <>
+                        struct threshold_kernel< char > : public threshold_kernel_s8< char > {
+                        };
+
+                        /**
+                         * 16-bit inputs. Unsigned values are compared as signed after flipping the sign bit.
+                         */
+                        template < typename T16, int Flip >
+                        struct threshold_kernel_16 {
+                                MI4_TARGET_AVX2 static size_t avx2 (const T16 *in, unsigned char *out, const size_t n, const T16 th, const unsigned char fg)
+                                {
+                                        const __m256i flip = _mm256_set1_epi16(static_cast<short> (Flip));
+                                        const __m256i t = _mm256_xor_si256(_mm256_set1_epi16(static_cast<short> (th)), flip);
+                                        const __m256i f = _mm256_set1_epi8(static_cast<char> (fg));
+                                        size_t i = 0;
+                                        for ( ; i + 32 <= n ; i += 32 ) {
+                                                const __m256i v0 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *> (in + i)), flip);
+                                                const __m256i v1 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *> (in + i + 16)), flip);
+                                                const __m256i lt = _mm256_permute4x64_epi64(_mm256_packs_epi16(_mm256_cmpgt_epi16(t, v0), _mm256_cmpgt_epi16(t, v1)), 0xD8);
+                                                _mm256_storeu_si256(reinterpret_cast<__m256i *> (out + i), _mm256_andnot_si256(lt, f));
+                                        }
+                                        return i;
+                                }
+                                MI4_TARGET_SSE2 static size_t sse2 (const T16 *in, unsigned char *out, const size_t n, const T16 th, const unsigned char fg)
+                                {
+                                        const __m128i flip = _mm_set1_epi16(static_cast<short> (Flip));
+                                        const __m128i t = _mm_xor_si128(_mm_set1_epi16(static_cast<short> (th)), flip);
+                                        const __m128i f = _mm_set1_epi8(static_cast<char> (fg));
+                                        size_t i = 0;
+                                        for ( ; i + 16 <= n ; i += 16 ) {
+                                                const __m128i v0 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *> (in + i)), flip);
+                                                const __m128i v1 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *> (in + i + 8)), flip);
+                                                const __m128i lt = _mm_packs_epi16(_mm_cmpgt_epi16(t, v0), _mm_cmpgt_epi16(t, v1));
+                                                _mm_storeu_si128(reinterpret_cast<__m128i *> (out + i), _mm_andnot_si128(lt, f));
+                                        }
+                                        return i;
+                                }
+                        };
+
+                        template <>
+                        struct threshold_kernel< int16_t > : public threshold_kernel_16< int16_t, 0 > {
+                        };
+
+                        template <>
+                        struct threshold_kernel< uint16_t > : public threshold_kernel_16< uint16_t, -32768 > {
+                        };
+
+                        template <>
+                        struct threshold_kernel< float > {
+                                MI4_TARGET_AVX2 static size_t avx2 (const float *in, unsigned char *out, const size_t n, const float th, const unsigned char fg)
+                                {
+                                        const __m256 t = _mm256_set1_ps(th);
+                                        const __m256i f = _mm256_set1_epi8(static_cast<char> (fg));
+                                        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+                                        size_t i = 0;
+                                        for ( ; i + 32 <= n ; i += 32 ) {
+                                                // not (v < th), so that NaN gives fg as the scalar code does.
+                                                const __m256i m0 = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(in + i), t, _CMP_NLT_UQ));
+                                                const __m256i m1 = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(in + i + 8), t, _CMP_NLT_UQ));
+                                                const __m256i m2 = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(in + i + 16), t, _CMP_NLT_UQ));
+                                                const __m256i m3 = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(in + i + 24), t, _CMP_NLT_UQ));
+                                                const __m256i m = _mm256_packs_epi16(_mm256_packs_epi32(m0, m1), _mm256_packs_epi32(m2, m3));
+                                                _mm256_storeu_si256(reinterpret_cast<__m256i *> (out + i), _mm256_and_si256(_mm256_permutevar8x32_epi32(m, order), f));
+                                        }
+                                        return i;
+                                }
+                                MI4_TARGET_SSE2 static size_t sse2 (const float *in, unsigned char *out, const size_t n, const float th, const unsigned char fg)
+                                {
+                                        const __m128 t = _mm_set1_ps(th);
+                                        const __m128i f = _mm_set1_epi8(static_cast<char> (fg));
+                                        size_t i = 0;
+                                        for ( ; i + 16 <= n ; i += 16 ) {
+                                                const __m128i m0 = _mm_castps_si128(_mm_cmpnlt_ps(_mm_loadu_ps(in + i), t));
+                                                const __m128i m1 = _mm_castps_si128(_mm_cmpnlt_ps(_mm_loadu_ps(in + i + 4), t));
+                                                const __m128i m2 = _mm_castps_si128(_mm_cmpnlt_ps(_mm_loadu_ps(in + i + 8), t));
+                                                const __m128i m3 = _mm_castps_si128(_mm_cmpnlt_ps(_mm_loadu_ps(in + i + 12), t));
+                                                const __m128i m = _mm_packs_epi16(_mm_packs_epi32(m0, m1), _mm_packs_epi32(m2, m3));
+                                                _mm_storeu_si128(reinterpret_cast<__m128i *> (out + i), _mm_and_si128(m, f));
+                                        }
+                                        return i;
+                                }
+                        };
+
+                        /**
+                         * 32-bit integer inputs. Unsigned values are compared as signed after flipping the sign bit.
+                         */
+                        template < typename T32, int Flip >
+                        struct threshold_kernel_32 {
+                                MI4_TARGET_AVX2 static size_t avx2 (const T32 *in, unsigned char *out, const size_t n, const T32 th, const unsigned char fg)
+                                {
+                                        const __m256i flip = _mm256_set1_epi32(Flip);
+                                        const __m256i t = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int> (th)), flip);
+                                        const __m256i f = _mm256_set1_epi8(static_cast<char> (fg));
+                                        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+                                        size_t i = 0;
+                                        for ( ; i + 32 <= n ; i += 32 ) {
+                                                const __m256i m0 = _mm256_cmpgt_epi32(t, _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *> (in + i)), flip));
+                                                const __m256i m1 = _mm256_cmpgt_epi32(t, _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *> (in + i + 8)), flip));
+                                                const __m256i m2 = _mm256_cmpgt_epi32(t, _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *> (in + i + 16)), flip));
+                                                const __m256i m3 = _mm256_cmpgt_epi32(t, _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *> (in + i + 24)), flip));
+                                                const __m256i lt = _mm256_packs_epi16(_mm256_packs_epi32(m0, m1), _mm256_packs_epi32(m2, m3));
+                                                _mm256_storeu_si256(reinterpret_cast<__m256i *> (out + i), _mm256_andnot_si256(_mm256_permutevar8x32_epi32(lt, order), f));
+                                        }
+                                        return i;
+                                }
+                                MI4_TARGET_SSE2 static size_t sse2 (const T32 *in, unsigned char *out, const size_t n, const T32 th, const unsigned char fg)
+                                {
+                                        const __m128i flip = _mm_set1_epi32(Flip);
+                                        const __m128i t = _mm_xor_si128(_mm_set1_epi32(static_cast<int> (th)), flip);
+                                        const __m128i f = _mm_set1_epi8(static_cast<char> (fg));
+                                        size_t i = 0;
+                                        for ( ; i + 16 <= n ; i += 16 ) {
+                                                const __m128i m0 = _mm_cmpgt_epi32(t, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *> (in + i)), flip));
+                                                const __m128i m1 = _mm_cmpgt_epi32(t, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *> (in + i + 4)), flip));
+                                                const __m128i m2 = _mm_cmpgt_epi32(t, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *> (in + i + 8)), flip));
+                                                const __m128i m3 = _mm_cmpgt_epi32(t, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *> (in + i + 12)), flip));
+                                                const __m128i lt = _mm_packs_epi16(_mm_packs_epi32(m0, m1), _mm_packs_epi32(m2, m3));
+                                                _mm_storeu_si128(reinterpret_cast<__m128i *> (out + i), _mm_andnot_si128(lt, f));
+                                        }
+                                        return i;
+                                }
+                        };
+
+                        template <>
+                        struct threshold_kernel< int32_t > : public threshold_kernel_32< int32_t, 0 > {
+                        };
+
+                        template <>
+                        struct threshold_kernel< uint32_t > : public threshold_kernel_32< uint32_t, std::numeric_limits< int32_t >::min() > {
+                        };
+
+                        template <>
+                        struct threshold_kernel< double > {
+                                /**
+                                 * @brief 32-bit masks of not (v < th) for in[0, 8).
+                                 */
+                                MI4_TARGET_AVX2 static __m256i not_less_avx2 (const double *in, const __m256d t)
+                                {
+                                        const __m256 m0 = _mm256_castpd_ps(_mm256_cmp_pd(_mm256_loadu_pd(in), t, _CMP_NLT_UQ));
+                                        const __m256 m1 = _mm256_castpd_ps(_mm256_cmp_pd(_mm256_loadu_pd(in + 4), t, _CMP_NLT_UQ));
+                                        return _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(m0, m1, 0x88)), 0xD8);
+                                }
+                                MI4_TARGET_AVX2 static size_t avx2 (const double *in, unsigned char *out, const size_t n, const double th, const unsigned char fg)
+                                {
+                                        const __m256d t = _mm256_set1_pd(th);
+                                        const __m256i f = _mm256_set1_epi8(static_cast<char> (fg));
+                                        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+                                        size_t i = 0;
+                                        for ( ; i + 32 <= n ; i += 32 ) {
+                                                const __m256i m0 = not_less_avx2(in + i, t);
+                                                const __m256i m1 = not_less_avx2(in + i + 8, t);
+                                                const __m256i m2 = not_less_avx2(in + i + 16, t);
+                                                const __m256i m3 = not_less_avx2(in + i + 24, t);
+                                                const __m256i m = _mm256_packs_epi16(_mm256_packs_epi32(m0, m1), _mm256_packs_epi32(m2, m3));
+                                                _mm256_storeu_si256(reinterpret_cast<__m256i *> (out + i), _mm256_and_si256(_mm256_permutevar8x32_epi32(m, order), f));
+                                        }
+                                        return i;
+                                }
+                                /**
+                                 * @brief 32-bit masks of not (v < th) for in[0, 4).
+                                 */
+                                MI4_TARGET_SSE2 static __m128i not_less_sse2 (const double *in, const __m128d t)
+                                {
+                                        const __m128 m0 = _mm_castpd_ps(_mm_cmpnlt_pd(_mm_loadu_pd(in), t));
+                                        const __m128 m1 = _mm_castpd_ps(_mm_cmpnlt_pd(_mm_loadu_pd(in + 2), t));
+                                        return _mm_castps_si128(_mm_shuffle_ps(m0, m1, 0x88));
+                                }
+                                MI4_TARGET_SSE2 static size_t sse2 (const double *in, unsigned char *out, const size_t n, const double th, const unsigned char fg)
+                                {
+                                        const __m128d t = _mm_set1_pd(th);
+                                        const __m128i f = _mm_set1_epi8(static_cast<char> (fg));
+                                        size_t i = 0;
+                                        for ( ; i + 16 <= n ; i += 16 ) {
+                                                const __m128i m0 = not_less_sse2(in + i, t);
+                                                const __m128i m1 = not_less_sse2(in + i + 4, t);
+                                                const __m128i m2 = not_less_sse2(in + i + 8, t);
+                                                const __m128i m3 = not_less_sse2(in + i + 12, t);
+                                                const __m128i m = _mm_packs_epi16(_mm_packs_epi32(m0, m1), _mm_packs_epi32(m2, m3));
+                                                _mm_storeu_si128(reinterpret_cast<__m128i *> (out + i), _mm_and_si128(m, f));
+                                        }
+                                        return i;
+                                }
+                        };
+
+                        /**
+                         * Conversion kernels : out[i] = static_cast<S>(in[i]). Each returns the number of elements processed; the caller finishes the tail.
+                         * Other pairs use a loop compiled for AVX2.
+                         */
+                        template < typename T, typename S >
+                        struct convert_kernel {
+                                MI4_TARGET_AVX2 static size_t avx2 (const T *in, S *out, const size_t n)
+                                {
+                                        for ( size_t i = 0 ; i < n ; ++i ) {
+                                                out[i] = static_cast<S> (in[i]);
+                                        }
+                                        return n;
+                                }
+                                static size_t sse2 (const T *, S *, const size_t)
+                                {
+                                        return 0;
+                                }
+                        };
+
+                        template < typename T8, bool IsSigned >
+                        struct convert_kernel_8_to_float {
+                                MI4_TARGET_AVX2 static size_t avx2 (const T8 *in, float *out, const size_t n)
+                                {
+                                        size_t i = 0;
+                                        for ( ; i + 16 <= n ; i += 16 ) {
+                                                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *> (in + i));
+                                                const __m256i v0 = IsSigned ? _mm256_cvtepi8_epi32(v) : _mm256_cvtepu8_epi32(v);
+                                                const __m256i v1 = IsSigned ? _mm256_cvtepi8_epi32(_mm_srli_si128(v, 8)) : _mm256_cvtepu8_epi32(_mm_srli_si128(v, 8));
+                                                _mm256_storeu_ps(out + i, _mm256_cvtepi32_ps(v0));
+                                                _mm256_storeu_ps(out + i + 8, _mm256_cvtepi32_ps(v1));
+                                        }
+                                        return i;
+                                }
+                                MI4_TARGET_SSE2 static size_t sse2 (const T8 *in, float *out, const size_t n)
+                                {
+                                        const __m128i zero = _mm_setzero_si128();
+                                        size_t i = 0;
+                                        for ( ; i + 16 <= n ; i += 16 ) {
+                                                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *> (in + i));
+                                                // widen by unpacking with zero, or with itself and shifting back arithmetically.
+                                                const __m128i w0 = IsSigned ? _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8) : _mm_unpacklo_epi8(v, zero);
+                                                const __m128i w1 = IsSigned ? _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8) : _mm_unpackhi_epi8(v, zero);
+                                                const __m128i d0 = IsSigned ? _mm_srai_epi32(_mm_unpacklo_epi16(w0, w0), 16) : _mm_unpacklo_epi16(w0, zero);
+                                                const __m128i d1 = IsSigned ? _mm_srai_epi32(_mm_unpackhi_epi16(w0, w0), 16) : _mm_unpackhi_epi16(w0, zero);
+                                                const __m128i d2 = IsSigned ? _mm_srai_epi32(_mm_unpacklo_epi16(w1, w1), 16) : _mm_unpacklo_epi16(w1, zero);
+                                                const __m128i d3 = IsSigned ? _mm_srai_epi32(_mm_unpackhi_epi16(w1, w1), 16) : _mm_unpackhi_epi16(w1, zero);
+                                                _mm_storeu_ps(out + i, _mm_cvtepi32_ps(d0));
+                                                _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(d1));
+                                                _mm_storeu_ps(out + i + 8, _mm_cvtepi32_ps(d2));
+                                                _mm_storeu_ps(out + i + 12, _mm_cvtepi32_ps(d3));
+                                        }
+                                        return i;
+                                }
+                        };
+
+                        template < typename T16, bool IsSigned >
+                        struct convert_kernel_16_to_float {
+                                MI4_TARGET_AVX2 static size_t avx2 (const T16 *in, float *out, const size_t n)
+                                {
+                                        size_t i = 0;
+                                        for ( ; i + 16 <= n ; i += 16 ) {
+                                                const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *> (in + i));
+                                                const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *> (in + i + 8));
+                                                _mm256_storeu_ps(out + i, _mm256_cvtepi32_ps(IsSigned ? _mm256_cvtepi16_epi32(v0) : _mm256_cvtepu16_epi32(v0)));
+                                                _mm256_storeu_ps(out + i + 8, _mm256_cvtepi32_ps(IsSigned ? _mm256_cvtepi16_epi32(v1) : _mm256_cvtepu16_epi32(v1)));
+                                        }
+                                        return i;
+                                }
+                                MI4_TARGET_SSE2 static size_t sse2 (const T16 *in, float *out, const size_t n)
+                                {
+                                        const __m128i zero = _mm_setzero_si128();
+                                        size_t i = 0;
+                                        for ( ; i + 8 <= n ; i += 8 ) {
+                                                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *> (in + i));
+                                                const __m128i d0 = IsSigned ? _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16) : _mm_unpacklo_epi16(v, zero);
+                                                const __m128i d1 = IsSigned ? _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16) : _mm_unpackhi_epi16(v, zero);
+                                                _mm_storeu_ps(out + i, _mm_cvtepi32_ps(d0));
+                                                _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(d1));
+                                        }
+                                        return i;
+                                }
+                        };
+
+                        /**
+                         * Float to 8-bit integers. Values are truncated, and saturated where static_cast is undefined.
+                         */
+                        template < typename T8, bool IsSigned >
+                        struct convert_kernel_float_to_8 {
+                                MI4_TARGET_AVX2 static size_t avx2 (const float *in, T8 *out, const size_t n)
+                                {
+                                        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+                                        size_t i = 0;
+                                        for ( ; i + 32 <= n ; i += 32 ) {
+                                                const __m256i p0 = _mm256_packs_epi32(_mm256_cvttps_epi32(_mm256_loadu_ps(in + i)), _mm256_cvttps_epi32(_mm256_loadu_ps(in + i + 8)));
+                                                const __m256i p1 = _mm256_packs_epi32(_mm256_cvttps_epi32(_mm256_loadu_ps(in + i + 16)), _mm256_cvttps_epi32(_mm256_loadu_ps(in + i + 24)));
+                                                const __m256i v = IsSigned ? _mm256_packs_epi16(p0, p1) : _mm256_packus_epi16(p0, p1);
+                                                _mm256_storeu_si256(reinterpret_cast<__m256i *> (out + i), _mm256_permutevar8x32_epi32(v, order));
+                                        }
+                                        return i;
+                                }
+                                MI4_TARGET_SSE2 static size_t sse2 (const float *in, T8 *out, const size_t n)
+                                {
+                                        size_t i = 0;
+                                        for ( ; i + 16 <= n ; i += 16 ) {
+                                                const __m128i p0 = _mm_packs_epi32(_mm_cvttps_epi32(_mm_loadu_ps(in + i)), _mm_cvttps_epi32(_mm_loadu_ps(in + i + 4)));
+                                                const __m128i p1 = _mm_packs_epi32(_mm_cvttps_epi32(_mm_loadu_ps(in + i + 8)), _mm_cvttps_epi32(_mm_loadu_ps(in + i + 12)));
+                                                const __m128i v = IsSigned ? _mm_packs_epi16(p0, p1) : _mm_packus_epi16(p0, p1);
+                                                _mm_storeu_si128(reinterpret_cast<__m128i *> (out + i), v);
+                                        }
+                                        return i;
+                                }
+                        };
+
+                        /**
+                         * Float to 16-bit integers. Values are truncated, and saturated where static_cast is undefined.
+                         */
+                        template < typename T16, bool IsSigned >
+                        struct convert_kernel_float_to_16 {
+                                MI4_TARGET_AVX2 static size_t avx2 (const float *in, T16 *out, const size_t n)
+                                {
+                                        size_t i = 0;
+                                        for ( ; i + 16 <= n ; i += 16 ) {
+                                                const __m256i v0 = _mm256_cvttps_epi32(_mm256_loadu_ps(in + i));
+                                                const __m256i v1 = _mm256_cvttps_epi32(_mm256_loadu_ps(in + i + 8));
+                                                const __m256i v = IsSigned ? _mm256_packs_epi32(v0, v1) : _mm256_packus_epi32(v0, v1);
+                                                _mm256_storeu_si256(reinterpret_cast<__m256i *> (out + i), _mm256_permute4x64_epi64(v, 0xD8));
+                                        }
+                                        return i;
+                                }
+                                MI4_TARGET_SSE2 static size_t sse2 (const float *in, T16 *out, const size_t n)
+                                {
+                                        // SSE2 has no unsigned pack : shift into the signed range and flip the sign bit back.
+                                        const __m128i bias = _mm_set1_epi32(IsSigned ? 0 : 32768);
+                                        const __m128i flip = _mm_set1_epi16(static_cast<short> (IsSigned ? 0 : -32768));
+                                        size_t i = 0;
+                                        for ( ; i + 8 <= n ; i += 8 ) {
+                                                const __m128i v0 = _mm_sub_epi32(_mm_cvttps_epi32(_mm_loadu_ps(in + i)), bias);
+                                                const __m128i v1 = _mm_sub_epi32(_mm_cvttps_epi32(_mm_loadu_ps(in + i + 4)), bias);
+                                                _mm_storeu_si128(reinterpret_cast<__m128i *> (out + i), _mm_xor_si128(_mm_packs_epi32(v0, v1), flip));
+                                        }
+                                        return i;
+                                }
+                        };
+
+                        template <>
+                        struct convert_kernel< uint8_t, float > : public convert_kernel_8_to_float< uint8_t, false > {
+                        };
+
+                        template <>
+                        struct convert_kernel< int8_t, float > : public convert_kernel_8_to_float< int8_t, true > {
+                        };
+
+                        template <>
+                        struct convert_kernel< char, float > : public convert_kernel_8_to_float< char, std::is_signed< char >::value > {
+                        };
+
+                        template <>
+                        struct convert_kernel< uint16_t, float > : public convert_kernel_16_to_float< uint16_t, false > {
+                        };
+
+                        template <>
+                        struct convert_kernel< int16_t, float > : public convert_kernel_16_to_float< int16_t, true > {
+                        };
+
+                        template <>
+                        struct convert_kernel< float, uint8_t > : public convert_kernel_float_to_8< uint8_t, false > {
+                        };
+
+                        template <>
+                        struct convert_kernel< float, int8_t > : public convert_kernel_float_to_8< int8_t, true > {
+                        };
+
+                        template <>
+                        struct convert_kernel< float, char > : public convert_kernel_float_to_8< char, std::is_signed< char >::value > {
+                        };
+
+                        template <>
+                        struct convert_kernel< float, uint16_t > : public convert_kernel_float_to_16< uint16_t, false > {
+                        };
+
+                        template <>
+                        struct convert_kernel< float, int16_t > : public convert_kernel_float_to_16< int16_t, true > {
+                        };
+
+                        template < typename T, typename S, class Function >
+                        MI4_TARGET_AVX2 void transform_avx2 (const T *in, S *out, const size_t n, const Function& fn)
+                        {
+                                for ( size_t i = 0 ; i < n ; ++i ) {
+                                        out[i] = fn(in[i]);
+                                }
+                        }
+#endif
+                }
+
+                /**
+                 * @brief Reverse the byte order of each element in place.
+                 */
+                template < typename T >
+                void byteswap (T *data, const size_t n)
+                {
+                        if ( sizeof(T) == 1 ) {
+                                return;
+                        }
+
+                        size_t done = 0;
+#if defined(MI4_SIMD_X86)
+                        if ( std::is_arithmetic< T >::value && (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)) {
+                                auto *bytes = reinterpret_cast<unsigned char *> (data);
+                                const auto isa = getInstructionSet();
+                                if ( isa == InstructionSet::AVX2 ) {
+                                        done = detail::byteswap_avx2(bytes, n * sizeof(T), sizeof(T)) / sizeof(T);
+                                } else if ( isa == InstructionSet::SSSE3 ) {
+                                        done = detail::byteswap_ssse3(bytes, n * sizeof(T), sizeof(T)) / sizeof(T);
+                                }
+                        }
+#endif
+                        for ( size_t i = done ; i < n ; ++i ) {
+                                data[i] = detail::byteswap_scalar(data[i]);
+                        }
+                }
+
+                /**
+                 * @brief out[i] = (in[i] < threshold) ? 0 : fg.
+                 */
+                template < typename T, typename S >
+                void threshold (const T *in, S *out, const size_t n, const T threshold, const S fg)
+                {
+                        size_t done = 0;
+#if defined(MI4_SIMD_X86)
+                        if ( sizeof(S) == 1 && std::is_integral< S >::value ) {
+                                auto *o = reinterpret_cast<unsigned char *> (out);
+                                const auto f = static_cast<unsigned char> (fg);
+                                const auto isa = getInstructionSet();
+                                if ( isa == InstructionSet::AVX2 ) {
+                                        done = detail::threshold_kernel< T >::avx2(in, o, n, threshold, f);
+                                } else if ( isa != InstructionSet::Scalar ) {
+                                        done = detail::threshold_kernel< T >::sse2(in, o, n, threshold, f);
+                                }
+                        }
+#endif
+                        for ( size_t i = done ; i < n ; ++i ) {
+                                out[i] = (in[i] < threshold) ? S(0) : fg;
+                        }
+                }
+
+                /**
+                 * @brief out[i] = static_cast<S>(in[i]).
+                 */
+                template < typename T, typename S >
+                void convert (const T *in, S *out, const size_t n)
+                {
+                        size_t done = 0;
+#if defined(MI4_SIMD_X86)
+                        const auto isa = getInstructionSet();
+                        if ( isa == InstructionSet::AVX2 ) {
+                                done = detail::convert_kernel< T, S >::avx2(in, out, n);
+                        } else if ( isa != InstructionSet::Scalar ) {
+                                done = detail::convert_kernel< T, S >::sse2(in, out, n);
+                        }
+#endif
+                        for ( size_t i = done ; i < n ; ++i ) {
+                                out[i] = static_cast<S> (in[i]);
+                        }
+                }
+
+                /**
+                 * @brief out[i] = fn(in[i]). The loop is compiled for AVX2 as well and chosen at runtime.
+                 */
+                template < typename T, typename S, class Function >
+                void transform (const T *in, S *out, const size_t n, const Function& fn)
+                {
+#if defined(MI4_SIMD_X86)
+                        if ( getInstructionSet() == InstructionSet::AVX2 ) {
+                                detail::transform_avx2(in, out, n, fn);
+                                return;
+                        }
+#endif
+                        for ( size_t i = 0 ; i < n ; ++i ) {
+                                out[i] = fn(in[i]);
+                        }
+                }
+        }
+}
+#endif// MI4_SIMD_HPP
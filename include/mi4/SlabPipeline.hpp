@@ -0,0 +1,496 @@
+/**
+ * @file SlabPipeline.hpp
+ * @author Takashi Michikawa <michikawa@acm.org>
+ * @brief Streaming z-slab pipeline : source -> stages -> sink.
+ */
+#ifndef MI4_SLAB_PIPELINE_HPP
+#define MI4_SLAB_PIPELINE_HPP 1
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "VolumeData.hpp"
+#include "VolumeDataUtility.hpp"
+
+namespace mi4 {
+        /**
+         * @brief Slices [z, z + data.getSize().z()) of a volume.
+         */
+        template < typename T >
+        struct Slab {
+                int z = 0;
+                VolumeData< T > data;
+
+                int getNumSlices (void) const
+                {
+                        return this->data.getSize().z();
+                }
+        };
+
+        /**
+         * @brief Bounded queue of slabs between two threads of the pipeline.
+         */
+        template < typename T >
+        class SlabQueue {
+        public:
+                explicit SlabQueue (const size_t capacity) : capacity_(std::max< size_t >(capacity, 1)), closed_(false), canceled_(false)
+                {
+                }
+
+                /**
+                 * @brief Block while the queue is full. Returns false if the consumer gave up.
+                 */
+                bool push (Slab< T >&& slab)
+                {
+                        std::unique_lock< std::mutex > lock(this->mutex_);
+                        this->notFull_.wait(lock, [this] (void) { return this->canceled_ || this->slabs_.size() < this->capacity_; });
+                        if ( this->canceled_ ) {
+                                return false;
+                        }
+                        this->slabs_.push_back(std::move(slab));
+                        this->notEmpty_.notify_one();
+                        return true;
+                }
+
+                /**
+                 * @brief Block while the queue is empty. Returns false when the producer has finished.
+                 */
+                bool pop (Slab< T >& slab)
+                {
+                        std::unique_lock< std::mutex > lock(this->mutex_);
+                        this->notEmpty_.wait(lock, [this] (void) { return this->closed_ || !this->slabs_.empty(); });
+                        if ( this->slabs_.empty()) {
+                                return false;
+                        }
+                        slab = std::move(this->slabs_.front());
+                        this->slabs_.pop_front();
+                        this->notFull_.notify_one();
+                        return true;
+                }
+
+                /**
+                 * @brief Called by the producer : no more slabs.
+                 */
+                void close (void)
+                {
+                        std::lock_guard< std::mutex > lock(this->mutex_);
+                        this->closed_ = true;
+                        this->notEmpty_.notify_all();
+                }
+
+                /**
+                 * @brief Called by the consumer : discard queued slabs and reject new ones.
+                 */
+                void cancel (void)
+                {
+                        std::lock_guard< std::mutex > lock(this->mutex_);
+                        this->canceled_ = true;
+                        this->slabs_.clear();
+                        this->notFull_.notify_all();
+                }
+        private:
+                const size_t capacity_;
+                bool closed_;
+                bool canceled_;
+                std::deque< Slab< T > > slabs_;
+                std::mutex mutex_;
+                std::condition_variable notFull_;
+                std::condition_variable notEmpty_;
+        };
+
+        namespace detail {
+                /**
+                 * @brief Volume information of slices [z, z + n) of info.
+                 */
+                inline VolumeInfo get_slab_info (const VolumeInfo& info, const int z, const int n)
+                {
+                        const auto& size = info.getSize();
+                        const Point3d origin = info.getOrigin() + Point3d(0, 0, info.getPitch().z() * z);
+                        return VolumeInfo(Point3i(size.x(), size.y(), n), info.getPitch(), origin);
+                }
+        }
+
+        /****
+         * Sources : output_type, getInfo() and read(z, n, slab).
+         */
+
+        /**
+         * @brief Reads slabs of a raw file (header followed by voxels in x-y-z order).
+         */
+        template < typename T >
+        class SlabReader {
+        public:
+                using output_type = T;
+
+                SlabReader (const std::string& filename, const VolumeInfo& info, const size_t headerSize = 0) : filename_(filename), info_(info), headerSize_(headerSize)
+                {
+                }
+
+                const VolumeInfo& getInfo (void) const
+                {
+                        return this->info_;
+                }
+
+                bool read (const int z, const int n, Slab< T >& slab)
+                {
+                        if ( !this->fin_.is_open()) {
+                                this->fin_.open(this->filename_.c_str(), std::ios::binary);
+                                if ( !this->fin_ ) {
+                                        std::cerr << " error : " << this->filename_ << " cannot be opened." << std::endl;
+                                        return false;
+                                }
+                        }
+                        const auto& size = this->info_.getSize();
+                        const auto sliceBytes = static_cast<size_t> (size.x()) * static_cast<size_t> (size.y()) * sizeof(T);
+                        slab.z = z;
+                        slab.data.init(detail::get_slab_info(this->info_, z, n));
+                        this->fin_.seekg(static_cast<std::streamoff> (this->headerSize_ + sliceBytes * static_cast<size_t> (z)), std::ios::beg);
+                        if ( !this->fin_.read(reinterpret_cast<char *> (slab.data.data()), static_cast<std::streamsize> (sliceBytes * static_cast<size_t> (n)))) {
+                                std::cerr << " error : reading slices " << z << "-" << z + n - 1 << " of " << this->filename_ << " failed." << std::endl;
+                                return false;
+                        }
+                        return true;
+                }
+        private:
+                std::string filename_;
+                VolumeInfo info_;
+                size_t headerSize_;
+                std::ifstream fin_;
+        };
+
+        /**
+         * @brief Slabs of a volume in memory.
+         */
+        template < typename T >
+        class VolumeDataSource {
+        public:
+                using output_type = T;
+
+                explicit VolumeDataSource (const VolumeData< T >& data) : data_(data)
+                {
+                }
+
+                const VolumeInfo& getInfo (void) const
+                {
+                        return this->data_.getInfo();
+                }
+
+                bool read (const int z, const int n, Slab< T >& slab)
+                {
+                        slab.z = z;
+                        slab.data.init(detail::get_slab_info(this->getInfo(), z, n));
+                        const T *src = this->data_.data(0, z);
+                        std::copy(src, src + slab.data.getNumVoxels(), slab.data.data());
+                        return true;
+                }
+        private:
+                const VolumeData< T >& data_;
+        };
+
+        /****
+         * Sinks : input_type, write(slab) called in z order.
+         */
+
+        /**
+         * @brief Writes slabs to a raw file.
+         */
+        template < typename T >
+        class SlabWriter {
+        public:
+                using input_type = T;
+
+                explicit SlabWriter (const std::string& filename) : filename_(filename)
+                {
+                }
+
+                bool write (const Slab< T >& slab)
+                {
+                        if ( !this->fout_.is_open()) {
+                                this->fout_.open(this->filename_.c_str(), std::ios::binary);
+                                if ( !this->fout_ ) {
+                                        std::cerr << " error : " << this->filename_ << " cannot be opened." << std::endl;
+                                        return false;
+                                }
+                        }
+                        // flushed per slab so that the file is complete when the pipeline returns.
+                        if ( !this->fout_.write(reinterpret_cast<const char *> (slab.data.data()), static_cast<std::streamsize> (sizeof(T) * slab.data.getNumVoxels())).flush()) {
+                                std::cerr << " error : writing " << this->filename_ << " failed." << std::endl;
+                                return false;
+                        }
+                        return true;
+                }
+        private:
+                std::string filename_;
+                std::ofstream fout_;
+        };
+
+        /**
+         * @brief Collects slabs into a volume (e.g. for stages that need the whole volume).
+         */
+        template < typename T >
+        class VolumeDataSink {
+        public:
+                using input_type = T;
+
+                VolumeDataSink (VolumeData< T >& data, const VolumeInfo& info) : data_(data)
+                {
+                        this->data_.init(info);
+                }
+
+                bool write (const Slab< T >& slab)
+                {
+                        std::copy(slab.data.data(), slab.data.data() + slab.data.getNumVoxels(), this->data_.data(0, slab.z));
+                        return true;
+                }
+        private:
+                VolumeData< T >& data_;
+        };
+
+        /****
+         * Stages : input_type, output_type, getHalo(info) and process(window).
+         * process() receives slices [z0 - halo, z1 + halo) (clipped by the volume) and its result is used for [z0, z1) only.
+         */
+
+        template < typename T, typename S = char >
+        class BinarizeStage {
+        public:
+                using input_type = T;
+                using output_type = S;
+
+                explicit BinarizeStage (const T threshold, const S fgValue = 1) : threshold_(threshold), fgValue_(fgValue)
+                {
+                }
+
+                int getHalo (const VolumeInfo&) const
+                {
+                        return 0;
+                }
+
+                VolumeData< S > process (const VolumeData< T >& window) const
+                {
+                        return VolumeDataUtility::binarize(window, this->threshold_, this->fgValue_);
+                }
+        private:
+                T threshold_;
+                S fgValue_;
+        };
+
+        /**
+         * @brief Erosion / dilation of a 0/1 mask by a sphere of radius r (in space).
+         */
+        template < typename T = char >
+        class MorphologyStage {
+        public:
+                using input_type = T;
+                using output_type = T;
+
+                enum class Operation {
+                        Erode,
+                        Dilate
+                };
+
+                MorphologyStage (const Operation operation, const double radius) : operation_(operation), radius_(radius)
+                {
+                }
+
+                int getHalo (const VolumeInfo& info) const
+                {
+                        // only voxels within the radius affect the result.
+                        return static_cast<int> (std::ceil(this->radius_ / info.getPitch().z()));
+                }
+
+                VolumeData< T > process (const VolumeData< T >& window) const
+                {
+                        return (this->operation_ == Operation::Erode) ? VolumeDataUtility::erode(window, this->radius_) : VolumeDataUtility::dilate(window, this->radius_);
+                }
+        private:
+                Operation operation_;
+                double radius_;
+        };
+
+        class BoundaryStage {
+        public:
+                using input_type = char;
+                using output_type = char;
+
+                explicit BoundaryStage (const char bg = 0) : bg_(bg)
+                {
+                }
+
+                int getHalo (const VolumeInfo&) const
+                {
+                        return 1;
+                }
+
+                VolumeData< char > process (const VolumeData< char >& window) const
+                {
+                        return VolumeDataUtility::extractBoundaryVoxels(window, this->bg_);
+                }
+        private:
+                char bg_;
+        };
+
+        /**
+         * @brief Streams a volume through stages slab by slab.
+         *
+         * The source, every stage and the sink run in their own threads connected by bounded queues,
+         * so at most O(slab size + halo) slices per stage are in memory.
+         * @code
+         * mi4::SlabReader< short > reader("ct.raw", info);
+         * mi4::BinarizeStage< short > binarize(300);
+         * mi4::MorphologyStage<> erode(mi4::MorphologyStage<>::Operation::Erode, 2.0);
+         * mi4::SlabWriter< char > writer("mask.raw");
+         * mi4::SlabPipeline().run(reader, binarize, erode, writer);
+         * @endcode
+         */
+        class SlabPipeline {
+        public:
+                /**
+                 * @param [in] slabSize Number of slices read at once.
+                 * @param [in] queueCapacity Number of slabs buffered between two stages.
+                 */
+                explicit SlabPipeline (const int slabSize = 16, const size_t queueCapacity = 2) : slabSize_(std::max(slabSize, 1)), queueCapacity_(queueCapacity)
+                {
+                }
+
+                /**
+                 * @brief Run source -> stages... -> sink. The last argument is the sink.
+                 * @return false if reading, processing or writing failed.
+                 */
+                template < class Source, class... Stages >
+                bool run (Source& source, Stages& ... stages)
+                {
+                        using T = typename Source::output_type;
+                        const auto info = source.getInfo();
+                        const int numSlices = info.getSize().z();
+                        std::atomic< bool > failed(false);
+                        std::vector< std::thread > threads;
+
+                        auto queue = std::make_shared< SlabQueue< T > >(this->queueCapacity_);
+                        this->launch(threads, failed, info, queue, stages...);
+
+                        for ( int z = 0 ; z < numSlices ; z += this->slabSize_ ) {
+                                Slab< T > slab;
+                                if ( !source.read(z, std::min(this->slabSize_, numSlices - z), slab)) {
+                                        failed = true;
+                                        break;
+                                }
+                                if ( !queue->push(std::move(slab))) {
+                                        break;
+                                }
+                        }
+                        queue->close();
+
+                        for ( auto& th : threads ) {
+                                th.join();
+                        }
+                        return !failed;
+                }
+        private:
+                template < typename T, class Sink >
+                void launch (std::vector< std::thread >& threads, std::atomic< bool >& failed, const VolumeInfo&, std::shared_ptr< SlabQueue< T > > in, Sink& sink)
+                {
+                        threads.emplace_back([in, &sink, &failed] (void) {
+                                Slab< T > slab;
+                                while ( in->pop(slab)) {
+                                        if ( !sink.write(slab)) {
+                                                failed = true;
+                                                in->cancel();
+                                                break;
+                                        }
+                                }
+                        });
+                }
+
+                template < typename T, class Stage, class... Rest >
+                void launch (std::vector< std::thread >& threads, std::atomic< bool >& failed, const VolumeInfo& info, std::shared_ptr< SlabQueue< T > > in, Stage& stage, Rest& ... rest)
+                {
+                        using S = typename Stage::output_type;
+                        auto out = std::make_shared< SlabQueue< S > >(this->queueCapacity_);
+                        threads.emplace_back([in, out, &stage, &failed, info] (void) {
+                                if ( !SlabPipeline::run_stage(stage, info, *in, *out)) {
+                                        failed = true;
+                                        in->cancel();
+                                }
+                                out->close();
+                        });
+                        this->launch(threads, failed, info, out, rest...);
+                }
+
+                /**
+                 * @brief Buffer input slabs until [z0 - halo, z1 + halo) is available and emit [z0, z1).
+                 */
+                template < class Stage, typename T, typename S >
+                static bool run_stage (const Stage& stage, const VolumeInfo& info, SlabQueue< T >& in, SlabQueue< S >& out)
+                {
+                        const int numSlices = info.getSize().z();
+                        const int halo = stage.getHalo(info);
+                        std::deque< Slab< T > > buffered;
+                        int available = 0; // end of slices received.
+                        int next = 0; // first slice not emitted yet.
+
+                        Slab< T > slab;
+                        while ( next < numSlices ) {
+                                if ( in.pop(slab)) {
+                                        available = slab.z + slab.getNumSlices();
+                                        buffered.push_back(std::move(slab));
+                                } else if ( available < numSlices ) {
+                                        return true; // upstream stopped.
+                                }
+
+                                const int last = (available == numSlices) ? numSlices : available - halo;
+                                if ( last <= next ) {
+                                        continue;
+                                }
+
+                                const int w0 = std::max(next - halo, 0);
+                                const int w1 = std::min(last + halo, numSlices);
+                                const auto result = stage.process(SlabPipeline::get_window(buffered, info, w0, w1));
+
+                                Slab< S > emitted;
+                                emitted.z = next;
+                                emitted.data.init(detail::get_slab_info(info, next, last - next));
+                                const S *src = result.data(0, next - w0);
+                                std::copy(src, src + emitted.data.getNumVoxels(), emitted.data.data());
+                                if ( !out.push(std::move(emitted))) {
+                                        return false;
+                                }
+                                next = last;
+
+                                // slices below next - halo are not needed anymore.
+                                while ( !buffered.empty() && buffered.front().z + buffered.front().getNumSlices() <= next - halo ) {
+                                        buffered.pop_front();
+                                }
+                        }
+                        return true;
+                }
+
+                template < typename T >
+                static VolumeData< T > get_window (const std::deque< Slab< T > >& buffered, const VolumeInfo& info, const int z0, const int z1)
+                {
+                        VolumeData< T > window(detail::get_slab_info(info, z0, z1 - z0));
+                        for ( const auto& slab : buffered ) {
+                                const int b = std::max(slab.z, z0);
+                                const int e = std::min(slab.z + slab.getNumSlices(), z1);
+                                if ( b < e ) {
+                                        const T *src = slab.data.data(0, b - slab.z);
+                                        const T *end = slab.data.data(0, e - 1 - slab.z) + static_cast<size_t> (info.getSize().x()) * static_cast<size_t> (info.getSize().y());
+                                        std::copy(src, end, window.data(0, b - z0));
+                                }
+                        }
+                        return window;
+                }
+        private:
+                int slabSize_;
+                size_t queueCapacity_;
+        };
+}
+#endif// MI4_SLAB_PIPELINE_HPP
@@ -0,0 +1,260 @@
+/**
+ * @file ThreadPool.hpp
+ * @author Takashi Michikawa <michikawa@acm.org>
+ */
+#ifndef MI4_THREAD_POOL_HPP
+#define MI4_THREAD_POOL_HPP 1
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace mi4 {
+        /**
+         * @brief Persistent thread pool with work stealing.
+         *
+         * Each worker owns a deque. A worker pops tasks from the back of its own deque and steals from the front of others.
+         * Threads waiting for a parallel_for run pending tasks instead of blocking, so parallel_for can be nested.
+         */
+        class ThreadPool {
+        private:
+                using task_type = std::function< void (void) >;
+
+                struct TaskQueue {
+                        std::mutex mutex;
+                        std::deque< task_type > tasks;
+                };
+
+                ThreadPool (const ThreadPool&) = delete;
+                ThreadPool& operator = (const ThreadPool&) = delete;
+                ThreadPool (ThreadPool&&) = delete;
+                ThreadPool& operator = (ThreadPool&&) = delete;
+        public:
+                /**
+                 * @param [in] numThreads Number of threads including the caller. 0 : hardware concurrency.
+                 */
+                explicit ThreadPool (const size_t numThreads = 0) : pending_(0), stop_(false)
+                {
+                        this->start(numThreads);
+                }
+
+                ~ThreadPool (void)
+                {
+                        this->stop();
+                }
+
+                /**
+                 * @brief Process-wide pool.
+                 */
+                static ThreadPool& getInstance (void)
+                {
+                        static ThreadPool instance;
+                        return instance;
+                }
+
+                /**
+                 * @brief Change the number of threads (including the caller). Must not be called while tasks are running.
+                 */
+                void resize (const size_t numThreads)
+                {
+                        this->stop();
+                        this->start(numThreads);
+                }
+
+                /**
+                 * @brief Number of threads taking part in parallel_for (workers and the caller).
+                 */
+                size_t getNumThreads (void) const
+                {
+                        return this->workers_.size() + 1;
+                }
+
+                /**
+                 * @brief Call fn(b, e) for sub-ranges [b, e) of [begin, end) of at most grainSize elements, and wait for them.
+                 */
+                template < class Function >
+                void parallel_for (const size_t begin, const size_t end, const size_t grainSize, const Function& fn)
+                {
+                        if ( end <= begin ) {
+                                return;
+                        }
+
+                        const size_t grain = std::max< size_t >(grainSize, 1);
+                        const size_t numChunks = (end - begin - 1) / grain + 1;
+
+                        if ( numChunks == 1 || this->workers_.empty()) {
+                                for ( size_t b = begin ; b < end ; b += grain ) {
+                                        fn(b, std::min(b + grain, end));
+                                }
+                                return;
+                        }
+
+                        auto remaining = std::make_shared< std::atomic< size_t > >(numChunks);
+                        auto error = std::make_shared< std::exception_ptr >();
+                        auto errorMutex = std::make_shared< std::mutex >();
+
+                        // chunk 0 is run by the caller.
+                        for ( size_t i = numChunks - 1 ; i > 0 ; --i ) {
+                                const size_t b = begin + i * grain;
+                                const size_t e = std::min(b + grain, end);
+                                this->push([&fn, b, e, remaining, error, errorMutex] (void) {
+                                        ThreadPool::run_chunk(fn, b, e, *error, *errorMutex);
+                                        remaining->fetch_sub(1);
+                                });
+                        }
+
+                        ThreadPool::run_chunk(fn, begin, std::min(begin + grain, end), *error, *errorMutex);
+                        remaining->fetch_sub(1);
+
+                        while ( remaining->load() > 0 ) {
+                                if ( !this->run_pending_task()) {
+                                        std::this_thread::yield();
+                                }
+                        }
+
+                        if ( *error ) {
+                                std::rethrow_exception(*error);
+                        }
+                }
+        private:
+                template < class Function >
+                static void run_chunk (const Function& fn, const size_t b, const size_t e, std::exception_ptr& error, std::mutex& errorMutex)
+                {
+                        try {
+                                fn(b, e);
+                        } catch (...) {
+                                std::lock_guard< std::mutex > lock(errorMutex);
+                                if ( !error ) {
+                                        error = std::current_exception();
+                                }
+                        }
+                }
+
+                void start (const size_t numThreads)
+                {
+                        const size_t hw = std::max< size_t >(std::thread::hardware_concurrency(), 1);
+                        const size_t n = ((numThreads == 0) ? hw : numThreads) - 1;
+                        this->stop_ = false;
+                        this->pending_ = 0;
+                        this->queues_.clear();
+
+                        // the last queue is shared by threads outside the pool.
+                        for ( size_t i = 0 ; i < n + 1 ; ++i ) {
+                                this->queues_.emplace_back(new TaskQueue());
+                        }
+                        for ( size_t i = 0 ; i < n ; ++i ) {
+                                this->workers_.emplace_back(&ThreadPool::worker_loop, this, i);
+                        }
+                }
+
+                void stop (void)
+                {
+                        {
+                                std::lock_guard< std::mutex > lock(this->sleepMutex_);
+                                this->stop_ = true;
+                        }
+                        this->wakeup_.notify_all();
+
+                        for ( auto& th : this->workers_ ) {
+                                th.join();
+                        }
+                        this->workers_.clear();
+                }
+
+                /**
+                 * @brief Index of the queue owned by the current thread.
+                 */
+                size_t get_queue_index (void) const
+                {
+                        const auto& current = ThreadPool::current();
+                        return (current.first == this) ? current.second : this->queues_.size() - 1;
+                }
+
+                static std::pair< const ThreadPool *, size_t >& current (void)
+                {
+                        static thread_local std::pair< const ThreadPool *, size_t > current(nullptr, 0);
+                        return current;
+                }
+
+                void push (task_type&& task)
+                {
+                        auto& queue = *this->queues_[this->get_queue_index()];
+                        {
+                                std::lock_guard< std::mutex > lock(queue.mutex);
+                                queue.tasks.push_back(std::move(task));
+                        }
+                        this->pending_.fetch_add(1);
+                        {
+                                // synchronize with workers going to sleep.
+                                std::lock_guard< std::mutex > lock(this->sleepMutex_);
+                        }
+                        this->wakeup_.notify_one();
+                }
+
+                bool run_pending_task (void)
+                {
+                        const size_t self = this->get_queue_index();
+                        const size_t n = this->queues_.size();
+                        task_type task;
+
+                        {
+                                auto& queue = *this->queues_[self];
+                                std::lock_guard< std::mutex > lock(queue.mutex);
+                                if ( !queue.tasks.empty()) {
+                                        task = std::move(queue.tasks.back());
+                                        queue.tasks.pop_back();
+                                }
+                        }
+
+                        for ( size_t i = 1 ; i < n && !task ; ++i ) {
+                                auto& queue = *this->queues_[(self + i) % n];
+                                std::lock_guard< std::mutex > lock(queue.mutex);
+                                if ( !queue.tasks.empty()) {
+                                        task = std::move(queue.tasks.front());
+                                        queue.tasks.pop_front();
+                                }
+                        }
+
+                        if ( !task ) {
+                                return false;
+                        }
+
+                        this->pending_.fetch_sub(1);
+                        task();
+                        return true;
+                }
+
+                void worker_loop (const size_t index)
+                {
+                        ThreadPool::current() = std::make_pair(this, index);
+
+                        while ( true ) {
+                                if ( this->run_pending_task()) {
+                                        continue;
+                                }
+
+                                std::unique_lock< std::mutex > lock(this->sleepMutex_);
+                                this->wakeup_.wait(lock, [this] (void) { return this->stop_ || this->pending_.load() > 0; });
+
+                                if ( this->stop_ ) {
+                                        break;
+                                }
+                        }
+                }
+        private:
+                std::vector< std::unique_ptr< TaskQueue > > queues_;
+                std::vector< std::thread > workers_;
+                std::atomic< size_t > pending_; ///< Number of queued tasks.
+                bool stop_;
+                std::mutex sleepMutex_;
+                std::condition_variable wakeup_;
+        };
+}
+#endif// MI4_THREAD_POOL_HPP
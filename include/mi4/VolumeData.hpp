@@ -5,16 +5,27 @@
 #ifndef MI4_VOLUME_DATA_HPP
 #define MI4_VOLUME_DATA_HPP 1
 #include <cstdlib>
+#include <cstdio>
 #include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <new>
+#include <limits>
+#include <algorithm>
+#include <iterator>
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <sstream>
 #include <iomanip>
+#include <memory>
 
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
 
+#include "MappedFile.hpp"
+#include "ParallelFor.hpp"
+
 namespace mi4 {
         using Vector3d = Eigen::Vector3d;
         using Vector3i = Eigen::Vector3i;
@@ -22,6 +33,59 @@ namespace mi4 {
         using Point3d = Eigen::Vector3d;
         using Point3i = Eigen::Vector3i;
 
+        /**
+         * @brief Allocator returning memory aligned to the given boundary (cache line by default).
+         */
+        template < typename T, size_t Alignment = 64 >
+        class AlignedAllocator {
+        public:
+                using value_type = T;
+                template < typename U >
+                struct rebind {
+                        using other = AlignedAllocator< U, Alignment >;
+                };
+
+                AlignedAllocator (void) = default;
+                template < typename U >
+                AlignedAllocator (const AlignedAllocator< U, Alignment >&)
+                {
+                }
+
+                T* allocate (const size_t n)
+                {
+                        if ( n > (std::numeric_limits< size_t >::max() - Alignment - sizeof(void *)) / sizeof(T)) {
+                                throw std::bad_alloc();
+                        }
+                        void *raw = std::malloc(n * sizeof(T) + Alignment + sizeof(void *));
+                        if ( raw == nullptr ) {
+                                throw std::bad_alloc();
+                        }
+                        // keep the original pointer just before the aligned block.
+                        const auto addr = (reinterpret_cast<uintptr_t> (raw) + sizeof(void *) + Alignment - 1) & ~static_cast<uintptr_t> (Alignment - 1);
+                        reinterpret_cast<void **> (addr)[-1] = raw;
+                        return reinterpret_cast<T *> (addr);
+                }
+
+                void deallocate (T *p, const size_t)
+                {
+                        if ( p != nullptr ) {
+                                std::free(reinterpret_cast<void **> (p)[-1]);
+                        }
+                }
+
+                template < typename U >
+                bool operator == (const AlignedAllocator< U, Alignment >&) const
+                {
+                        return true;
+                }
+
+                template < typename U >
+                bool operator != (const AlignedAllocator< U, Alignment >&) const
+                {
+                        return false;
+                }
+        };
+
         class VolumeInfo {
         private:
                 Point3i size_; ///< Global bounding box.
@@ -175,7 +239,7 @@ namespace mi4 {
 
                 VolumeInfo clip (const Point3d& bmin, const Point3d& bmax) const
                 {
-                        const auto size = this->getPointInVoxelCeil(bmax) - this->getPointInVoxelFloor(bmin) + Point3i(1, 1, 1);
+                        const Point3i size = this->getPointInVoxelCeil(bmax) - this->getPointInVoxelFloor(bmin) + Point3i(1, 1, 1);
                         return VolumeInfo(size, this->getPitch(), bmin);
                 }
 
@@ -195,11 +259,26 @@ namespace mi4 {
 
         class Range {
         public:
+                /**
+                 * @brief Random-access iterator visiting voxels in x-y-z order.
+                 */
                 class iterator {
                 public:
-                        explicit iterator (const Range& range, const bool isBegin = true) : range_(range), pos_(range.getMin())
+                        using iterator_category = std::random_access_iterator_tag;
+                        using value_type = Point3i;
+                        using difference_type = std::ptrdiff_t;
+                        using pointer = const Point3i*;
+                        using reference = Point3i;
+
+                        explicit iterator (const Range& range, const bool isBegin = true) : bmin_(range.getMin()), size_(range.getSize()), pos_(range.getMin()), index_(0)
+                        {
+                                if ( !isBegin ) {
+                                        this->index_ = range.getNumVoxels();
+                                        this->pos_.z() = range.getMax().z() + 1;
+                                }
+                        }
+                        iterator (void) : bmin_(0, 0, 0), size_(0, 0, 0), pos_(0, 0, 0), index_(0)
                         {
-                                this->pos_.z() = isBegin ? this->pos_.z() : range.getMax().z() + 1;
                         }
                         iterator (const iterator& that) = default;
                         iterator (iterator&& that) = default;
@@ -213,9 +292,54 @@ namespace mi4 {
                                 return *this;
                         }
 
+                        iterator operator ++ (int)
+                        {
+                                iterator tmp(*this);
+                                this->step_forward();
+                                return tmp;
+                        }
+
+                        iterator& operator -- (void)
+                        {
+                                this->step_backward();
+                                return *this;
+                        }
+
+                        iterator operator -- (int)
+                        {
+                                iterator tmp(*this);
+                                this->step_backward();
+                                return tmp;
+                        }
+
+                        bool operator == (const iterator& rhs) const
+                        {
+                                return this->index_ == rhs.index_;
+                        }
+
                         bool operator != (const iterator& rhs) const
                         {
-                                return this->pos_ != rhs.pos_;
+                                return this->index_ != rhs.index_;
+                        }
+
+                        bool operator < (const iterator& rhs) const
+                        {
+                                return this->index_ < rhs.index_;
+                        }
+
+                        bool operator > (const iterator& rhs) const
+                        {
+                                return this->index_ > rhs.index_;
+                        }
+
+                        bool operator <= (const iterator& rhs) const
+                        {
+                                return this->index_ <= rhs.index_;
+                        }
+
+                        bool operator >= (const iterator& rhs) const
+                        {
+                                return this->index_ >= rhs.index_;
                         }
 
                         Point3i operator * (void) const
@@ -223,38 +347,99 @@ namespace mi4 {
                                 return this->pos_;
                         }
 
-                        iterator& operator += (const size_t n)
+                        pointer operator -> (void) const
                         {
-                                for ( size_t i = 0; i < n; ++i ) {
-                                        ++(*this);
-                                }
+                                return &this->pos_;
+                        }
 
+                        Point3i operator [] (const difference_type n) const
+                        {
+                                return *(iterator(*this) += n);
+                        }
+
+                        iterator& operator += (const difference_type n)
+                        {
+                                this->index_ += n;
+                                this->update_position();
                                 return *this;
                         }
+
+                        iterator& operator -= (const difference_type n)
+                        {
+                                return *this += (-n);
+                        }
+
+                        iterator operator + (const difference_type n) const
+                        {
+                                return iterator(*this) += n;
+                        }
+
+                        iterator operator - (const difference_type n) const
+                        {
+                                return iterator(*this) -= n;
+                        }
+
+                        difference_type operator - (const iterator& rhs) const
+                        {
+                                return static_cast<difference_type> (this->index_ - rhs.index_);
+                        }
+
+                        friend iterator operator + (const difference_type n, const iterator& iter)
+                        {
+                                return iter + n;
+                        }
+
+                        /**
+                         * @brief Linear index in the range.
+                         */
+                        int64_t getIndex (void) const
+                        {
+                                return this->index_;
+                        }
                 private:
                         void step_forward (void)
                         {
-                                const auto& bmin = this->range_.getMin();
-                                const auto& bmax = this->range_.getMax();
                                 auto& pos = this->pos_;
+                                ++this->index_;
+                                pos.x() += 1;
+
+                                if ( pos.x() - this->bmin_.x() == this->size_.x()) {
+                                        pos.x() = this->bmin_.x();
+                                        pos.y() += 1;
+
+                                        if ( pos.y() - this->bmin_.y() == this->size_.y()) {
+                                                pos.y() = this->bmin_.y();
+                                                pos.z() += 1;
+                                        }
+                                }
+                        }
 
-                                if ( pos.z() <= bmax.z()) {
-                                        pos.x() += 1;
+                        void step_backward (void)
+                        {
+                                auto& pos = this->pos_;
+                                --this->index_;
+                                pos.x() -= 1;
 
-                                        if ( bmax.x() < pos.x()) {
-                                                pos.x() = bmin.x();
-                                                pos.y() += 1;
+                                if ( pos.x() < this->bmin_.x()) {
+                                        pos.x() = this->bmin_.x() + this->size_.x() - 1;
+                                        pos.y() -= 1;
 
-                                                if ( bmax.y() < pos.y()) {
-                                                        pos.y() = bmin.y();
-                                                        pos.z() += 1;
-                                                }
+                                        if ( pos.y() < this->bmin_.y()) {
+                                                pos.y() = this->bmin_.y() + this->size_.y() - 1;
+                                                pos.z() -= 1;
                                         }
                                 }
                         }
+
+                        void update_position (void)
+                        {
+                                this->pos_ = this->bmin_ + VolumeInfo(this->size_).fromIndex(this->index_);
+                        }
                 private:
-                        const Range& range_; // Pointer to the range.
+                        Point3i bmin_; // Minimum corner of the range.
+                        Point3i size_; // Size of the range.
                         Point3i pos_; // Current position.
+                        int64_t index_; // Linear index of the current position.
                 };
 
         public:
@@ -282,12 +467,23 @@ namespace mi4 {
                         return this->bbox_.max();
                 }
 
-                Range::iterator begin (void)
+                Point3i getSize (void) const
+                {
+                        return (this->getMax() - this->getMin() + Point3i::Ones()).cwiseMax(0);
+                }
+
+                int64_t getNumVoxels (void) const
+                {
+                        const Point3i size = this->getSize();
+                        return static_cast<int64_t> (size.x()) * size.y() * size.z();
+                }
+
+                Range::iterator begin (void) const
                 {
                         return Range::iterator(*this, true);
                 }
 
-                Range::iterator end (void)
+                Range::iterator end (void) const
                 {
                         return Range::iterator(*this, false);
                 }
@@ -296,28 +492,91 @@ namespace mi4 {
                 Eigen::AlignedBox3i bbox_;
         };
 
+        /**
+         * @brief Split the range into blocks and call fn(const Range& block) in parallel.
+         * @param [in] range Range.
+         * @param [in] fn Functor.
+         * @param [in] blockSize Block size. 0 spans the whole range along the axis (default : one z-slice per block).
+         */
+        template < class Function >
+        void parallel_for (const Range& range, const Function& fn, const Point3i& blockSize = Point3i(0, 0, 1))
+        {
+                if ( range.getNumVoxels() == 0 ) {
+                        return;
+                }
+
+                const Point3i size = range.getSize();
+                const Point3i bs = blockSize.binaryExpr(size, [] (const int b, const int s) { return (b <= 0) ? s : std::min(b, s); });
+                const VolumeInfo blocks((size + bs - Point3i::Ones()).cwiseQuotient(bs));
+                const auto numBlocks = static_cast<size_t> (blocks.getSize().prod());
+                const Point3i bmin = range.getMin();
+                const Point3i bmax = range.getMax();
+
+                mi4::parallel_for(0, numBlocks, [&] (const size_t b, const size_t e) {
+                        for ( auto i = b ; i < e ; ++i ) {
+                                const Point3i p0 = bmin + blocks.fromIndex(static_cast<int64_t> (i)).cwiseProduct(bs);
+                                const Point3i p1 = (p0 + bs - Point3i::Ones()).cwiseMin(bmax);
+                                fn(Range(p0, p1));
+                        }
+                });
+        }
+
         template < typename T >
         class VolumeData {
         public:
-                explicit VolumeData (const Point3i& size = Point3i(0, 0, 0), const bool allocateMemory = true)
+                using buffer_type = std::vector< T, AlignedAllocator< T > >;
+                using stride_type = Eigen::Matrix< int64_t, 3, 1 >;
+
+                explicit VolumeData (const Point3i& size = Point3i(0, 0, 0), const bool allocateMemory = true) : voxels_(nullptr)
                 {
                         this->init(VolumeInfo(size), allocateMemory);
                 }
-                explicit VolumeData (const VolumeInfo& info, const bool allocateMemory = true)
+                explicit VolumeData (const VolumeInfo& info, const bool allocateMemory = true) : voxels_(nullptr)
                 {
                         this->init(info, allocateMemory);
                 }
                 virtual ~VolumeData (void) = default;
 
-                VolumeData (VolumeData&& that) = default;
-                VolumeData& operator = (VolumeData&& that) = default;
-                VolumeData (const VolumeData& that) = default;
-                VolumeData& operator = (const VolumeData& that) = default;
+                VolumeData (VolumeData&& that) : voxels_(nullptr)
+                {
+                        *this = std::move(that);
+                }
+
+                VolumeData& operator = (VolumeData&& that)
+                {
+                        if ( this != &that ) {
+                                this->info_ = that.info_;
+                                this->stride_ = that.stride_;
+                                this->data_ = std::move(that.data_);
+                                this->map_ = std::move(that.map_);
+                                this->voxels_ = (this->map_) ? static_cast<T *> (this->map_->data()) : this->data_.data();
+                                that.release();
+                        }
+                        return *this;
+                }
+
+                /**
+                 * @brief Copies always own their voxels, even if the source is a mapped volume.
+                 */
+                VolumeData (const VolumeData& that) : voxels_(nullptr)
+                {
+                        this->clone(that);
+                }
+
+                VolumeData& operator = (const VolumeData& that)
+                {
+                        if ( this != &that ) {
+                                this->clone(that);
+                        }
+                        return *this;
+                }
 
                 VolumeData< T >& init (const VolumeInfo& info, const bool allocateMemory = true)
                 {
-                        this->data_.clear();
+                        this->release();
                         this->info_ = info;
+                        const auto& size = info.getSize();
+                        this->stride_ = stride_type(1, size.x(), static_cast<int64_t> (size.x()) * size.y());
 
                         if ( allocateMemory ) {
                                 this->allocate();
@@ -328,10 +587,9 @@ namespace mi4 {
 
                 VolumeData< T >& fill (const T& value = T())
                 {
-                        for ( const auto& p : Range(this->getInfo())) {
-                                this->at(p) = value;
+                        if ( this->isReadable()) {
+                                std::fill(this->voxels_, this->voxels_ + this->getNumVoxels(), value);
                         }
-
                         return *this;
                 }
 
@@ -367,30 +625,73 @@ namespace mi4 {
 
                 T at (const int x, const int y, const int z) const
                 {
-                        return this->data_.at(z).at(y).at(x);
+                        return this->voxels_[this->offset(x, y, z)];
                 }
 
                 T& at (const int x, const int y, const int z)
                 {
-                        return this->data_.at(z).at(y).at(x);
+                        return this->voxels_[this->offset(x, y, z)];
                 }
 
-                bool clone (const VolumeData< T >& that)
+                /**
+                 * @brief Pointer to the first voxel. Voxels are stored contiguously in x-y-z order.
+                 */
+                T* data (void)
                 {
-                        this->init(that.getInfo(), true);
+                        return this->voxels_;
+                }
 
-                        for ( const auto& p : Range(that.getInfo())) {
-                                this->at(p) = that.at(p);
-                        }
+                const T* data (void) const
+                {
+                        return this->voxels_;
+                }
 
-                        return true;
+                /**
+                 * @brief Pointer to the scanline (0, y, z).
+                 */
+                T* data (const int y, const int z)
+                {
+                        return this->voxels_ + this->offset(0, y, z);
+                }
+
+                const T* data (const int y, const int z) const
+                {
+                        return this->voxels_ + this->offset(0, y, z);
+                }
+
+                /**
+                 * @brief Element strides along x, y and z.
+                 */
+                const stride_type& stride (void) const
+                {
+                        return this->stride_;
+                }
+
+                size_t getNumVoxels (void) const
+                {
+                        const auto& size = this->info_.getSize();
+                        return static_cast<size_t> (size.x()) * static_cast<size_t> (size.y()) * static_cast<size_t> (size.z());
+                }
+
+                bool clone (const VolumeData< T >& that)
+                {
+                        this->init(that.getInfo(), false);
+                        if ( that.isReadable()) {
+                                this->data_.assign(that.data(), that.data() + that.getNumVoxels());
+                                this->voxels_ = this->data_.data();
+                        }
+                        return this->isReadable();
                 }
 
                 bool allocate (void)
                 {
                         if ( !this->isReadable()) {
-                                const auto& size = this->getInfo().getSize();
-                                this->data_.assign(size.z(), std::vector< std::vector< T > >(size.y(), std::vector< T >(size.x(), T())));
+                                try {
+                                        this->data_.assign(this->getNumVoxels(), T());
+                                        this->voxels_ = this->data_.data();
+                                } catch (const std::bad_alloc&) {
+                                        this->release();
+                                }
                                 if ( !this->isReadable()) {
                                         this->release();
                                         std::cerr << " error : allocation failed" << std::endl;
@@ -403,30 +704,106 @@ namespace mi4 {
 
                 void release (void)
                 {
-                        this->data_.erase(this->data_.begin(), this->data_.end());
+                        buffer_type().swap(this->data_);
+                        this->map_.reset();
+                        this->voxels_ = nullptr;
                 }
 
                 bool isReadable (void) const
                 {
-                        const auto& size = this->info_.getSize();
-                        if ( this->data_.size() != static_cast<size_t> ( size.z())) return false;
-                        for ( const auto& dataxy : this->data_ ) {
-                                if ( dataxy.size() != static_cast<size_t> ( size.y())) return false;
-                                for ( const auto& datax : dataxy ) {
-                                        if ( datax.size() != static_cast<size_t> ( size.x())) return false;
-                                }
+                        if ( this->isMapped()) {
+                                return this->map_->size() >= this->getNumVoxels() * sizeof(T);
+                        }
+                        return this->data_.size() == this->getNumVoxels();
+                }
+
+                /**
+                 * @brief Map a raw file instead of loading it. Voxels are read from (and written to) the page cache directly.
+                 * @param [in] filename File name.
+                 * @param [in] offset Header size in bytes.
+                 * @param [in] mode ReadOnly, ReadWrite (in-place edit of the file) or CopyOnWrite (private edit).
+                 * @note Writing voxels of a ReadOnly mapping is not allowed.
+                 */
+                bool map (const std::string& filename, const size_t offset, const MappedFile::Mode mode)
+                {
+                        if ( this->getNumVoxels() == 0 ) {
+                                std::cerr << " error : volume size is not set." << std::endl;
+                                return false;
+                        }
+
+                        // the current voxels are kept if the file cannot be mapped.
+                        auto file = std::make_shared< MappedFile >();
+                        if ( !file->open(filename, offset, this->getNumVoxels() * sizeof(T), mode)) {
+                                return false;
                         }
+                        if ( reinterpret_cast<uintptr_t> (file->data()) % alignof(T) != 0 ) {
+                                std::cerr << " error : offset is not aligned to the voxel type." << std::endl;
+                                return false;
+                        }
+                        const VolumeInfo info = this->info_;
+                        this->init(info, false);
+                        this->map_ = file;
+                        this->voxels_ = static_cast<T *> (file->data());
                         return true;
                 }
 
+                bool map (const std::string& filename, const size_t offset = 0, const bool readOnly = true)
+                {
+                        return this->map(filename, offset, readOnly ? MappedFile::Mode::ReadOnly : MappedFile::Mode::ReadWrite);
+                }
+
+                bool isMapped (void) const
+                {
+                        return static_cast<bool> (this->map_);
+                }
+
+                /**
+                 * @brief Hint of the access pattern of the mapped voxels.
+                 */
+                bool advise (const MappedFile::Access access)
+                {
+                        return this->isMapped() && this->map_->advise(access);
+                }
+
+                /**
+                 * @brief Flush in-place modifications of a writable mapping to the file.
+                 */
+                bool sync (void)
+                {
+                        return this->isMapped() && this->map_->sync();
+                }
+
                 bool open (const std::string& filename, const size_t offset = 0)
                 {
                         std::ifstream fin(filename.c_str(), std::ios::binary);
                         return this->read(fin, offset);
                 }
 
+                /**
+                 * @brief Save voxels to the file.
+                 * @note If the file is the mapped one, a ReadWrite mapping is flushed in place.
+                 * Otherwise voxels are written to a temporary file which then replaces it,
+                 * since truncating the file would invalidate the mapped pages.
+                 */
                 bool save (const std::string& filename)
                 {
+                        if ( this->isMapped() && this->map_->isSameFile(filename)) {
+                                if ( this->map_->getMode() == MappedFile::Mode::ReadWrite ) {
+                                        return this->sync();
+                                }
+                                const std::string tmpname = filename + ".mi4tmp";
+                                bool result = false;
+                                {
+                                        std::ofstream fout(tmpname.c_str(), std::ios::binary);
+                                        result = this->write(fout);
+                                }
+                                if ( !result || std::rename(tmpname.c_str(), filename.c_str()) != 0 ) {
+                                        std::cerr << " error : " << filename << " cannot be replaced." << std::endl;
+                                        std::remove(tmpname.c_str());
+                                        return false;
+                                }
+                                return true;
+                        }
                         std::ofstream fout(filename.c_str(), std::ios::binary);
                         return this->write(fout);
                 }
@@ -436,16 +813,18 @@ namespace mi4 {
                         if ( !fin ) {
                                 std::cerr << " error : file stream is not ready yet." << std::endl;
                                 return false;
+                        } else if ( !this->isReadable()) {
+                                std::cerr << " error : volume data is not allocated." << std::endl;
+                                return false;
+                        } else if ( this->isMapped() && !this->map_->isWritable()) {
+                                std::cerr << " error : volume data is mapped as read-only." << std::endl;
+                                return false;
                         }
 
-                        fin.seekg(offset);
+                        fin.seekg(static_cast<std::streamoff> (offset));
 
-                        for ( auto& dataz : this->data_ ) {
-                                for ( auto& datazy : dataz ) {
-                                        if ( !fin.read(reinterpret_cast<char *> (datazy.data()), datazy.size() * sizeof(T))) {
-                                                return false;
-                                        }
-                                }
+                        if ( !fin.read(reinterpret_cast<char *> (this->voxels_), static_cast<std::streamsize> (this->getNumVoxels() * sizeof(T)))) {
+                                return false;
                         }
 
                         return fin.good();
@@ -461,18 +840,42 @@ namespace mi4 {
                                 return false;
                         }
 
-                        for ( const auto& dataz : this->data_ ) {
-                                for ( const auto& datazy : dataz ) {
-                                        if ( !fout.write(reinterpret_cast<const char *>(datazy.data()), sizeof(T) * datazy.size())) {
-                                                return false;
-                                        }
-                                }
+                        if ( !fout.write(reinterpret_cast<const char *>(this->voxels_), static_cast<std::streamsize> (sizeof(T) * this->getNumVoxels()))) {
+                                return false;
                         }
                         return fout.good();
                 }
+        private:
+                int64_t offset (const int x, const int y, const int z) const
+                {
+                        assert(this->info_.isValid(Point3i(x, y, z)));
+                        return x + this->stride_.y() * y + this->stride_.z() * z;
+                }
         private:
                 VolumeInfo info_;
-                std::vector< std::vector< std::vector< T > > > data_;
+                stride_type stride_;
+                buffer_type data_;
+                std::shared_ptr< MappedFile > map_; ///< Set when voxels live in a mapped file.
+                T *voxels_; ///< Head of voxels. Points to either data_ or map_.
         };
+
+        /**
+         * @brief Call fn(T* row, const Point3i& start, const int length) for each x-row of the range in parallel.
+         * row points to the voxel at start. Rows are distributed in slabs of slabSize z-slices.
+         */
+        template < typename T, class Function >
+        void parallel_for_rows (VolumeData< T >& data, const Range& range, const Function& fn, const int slabSize = 1)
+        {
+                const int length = range.getSize().x();
+                mi4::parallel_for(range, [&data, &fn, length] (const Range& slab) {
+                        const Point3i bmin = slab.getMin();
+                        const Point3i bmax = slab.getMax();
+                        for ( int z = bmin.z() ; z <= bmax.z() ; ++z ) {
+                                for ( int y = bmin.y() ; y <= bmax.y() ; ++y ) {
+                                        fn(data.data(y, z) + bmin.x(), Point3i(bmin.x(), y, z), length);
+                                }
+                        }
+                }, Point3i(0, 0, slabSize));
+        }
 }
 #endif// MI_VOLUME_DATA_HPP
\ No newline at end of file
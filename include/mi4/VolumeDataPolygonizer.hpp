@@ -9,9 +9,14 @@
 #include <cmath>
 #include <cstdlib>
 #include <vector>
+#include <array>
+#include <algorithm>
+#include <memory>
 
 #include <mi4/VolumeData.hpp>
-#include "mc_table.hpp"
+#include <mi4/ParallelFor.hpp>
+#include <mi4/MinMaxPyramid.hpp>
+#include "marching_cubes.hpp"
 #include "Mesh.hpp"
 
 namespace mi4
@@ -59,6 +64,16 @@ namespace mi4
                                         return this->_data->get ( p );
                                 }
                         }
+
+                        bool isMonotone ( void ) const
+                        {
+                                return this->_isMonotone;
+                        }
+
+                        mi4::VolumeData<S>& getVolume ( void )
+                        {
+                                return *this->_data;
+                        }
                 };
         private:
                 VolumeDataPolygonizer ( const VolumeDataPolygonizer& that );
@@ -71,6 +86,7 @@ namespace mi4
                 explicit VolumeDataPolygonizer ( VolumeData<T>& data ) : _data ( data )
                 {
                         this->setEps();
+                        this->setSlabSize();
                         return;
                 }
                 /**
@@ -86,6 +102,25 @@ namespace mi4
                         this->_iso_eps = iso_eps;
                         return *this;
                 }
+                /**
+                * @brief Discard the min/max pyramid of the volume. Call it after the volume is modified.
+                */
+                VolumeDataPolygonizer<T>& update ( void )
+                {
+                        this->_pyramid.reset();
+                        return *this;
+                }
+
+                /**
+                * @brief Set the number of z-slices polygonized by a thread at once.
+                * @param [in] slabSize Number of slices. 0 chooses it from the number of threads.
+                */
+                VolumeDataPolygonizer<T>& setSlabSize ( const int slabSize = 0 )
+                {
+                        this->_slabSize = slabSize;
+                        return *this;
+                }
+
                 /**
                 * @brief Polygonize the volume data.
                 * @param [in] isovalue Iso value ot the volume data.
@@ -153,97 +188,100 @@ namespace mi4
 
                 Mesh polygonize ( Data<float>& isovalue, Data<char>& mask )
                 {
-                        Mesh mesh;
-                        // @todo make parallel (170619)
-                        const auto& info = this->_data.getInfo();
+                        const auto size = this->_data.getInfo().getSize();
+                        const int numSlices = size.z() - 1;
 
-                        for ( const auto& p : mi4::Range ( info.getMin(),  info.getMax() - mi4::Point3i ( 1, 1, 1 ) ) ) {
-                                std::vector<double> iso;
-                                iso.reserve ( 8 );
-                                bool isPolygonized = false;
-                                std::vector<std::pair<Point3d, double> > cell;
-                                cell.reserve ( 8 );
-
-                                for ( const auto& dp : mi4::Range ( mi4::Point3i ( 0, 0, 0 ), mi4::Point3i ( 1, 1, 1 ) ) ) {
-                                        const Point3i np = p + dp;
-                                        const Point3d pd = this->_data.getInfo().getPointInSpace ( np );
-                                        const double v = this->_data.get ( np );
-                                        cell.push_back ( std::make_pair ( pd, v ) );
-                                        iso.push_back ( static_cast<double> ( isovalue.get ( np ) ) );
-
-                                        if ( mask.get ( np ) > 0 ) {
-                                                isPolygonized = true;
-                                        }
-                                }
+                        if ( size.x() < 2 || size.y() < 2 || numSlices < 1 ) {
+                                return Mesh();
+                        }
 
-                                if ( isPolygonized ) {
-                                        this->polygonize_cell ( cell, iso, mesh );
+                        const int slab = ( this->_slabSize > 0 ) ? this->_slabSize : ( numSlices - 1 ) / static_cast<int> ( 4 * mi4::ThreadPool::getInstance().getNumThreads() ) + 1;
+                        const int numSlabs = ( numSlices + slab - 1 ) / slab;
+
+                        // blocks of cells which may intersect the isosurface.
+                        if ( !this->_pyramid ) {
+                                this->_pyramid.reset ( new MinMaxPyramid<T> ( this->_data ) );
+                        }
+                        std::vector<char> active;
+                        if ( isovalue.isMonotone() ) {
+                                const double iso = isovalue.get ( Point3i ( 0, 0, 0 ) );
+                                active = this->_pyramid->getActiveBlocks ( iso - this->_iso_eps, iso + this->_iso_eps );
+                        } else {
+                                active = this->_pyramid->getActiveBlocks ( MinMaxPyramid<float> ( isovalue.getVolume(), this->_pyramid->getBlockSize() ), this->_iso_eps );
+                        }
+
+                        std::vector<Mesh> meshes ( static_cast<size_t> ( numSlabs ) );
+                        mi4::parallel_for ( 0, meshes.size(), [&] ( const size_t b, const size_t e ) {
+                                for ( size_t i = b ; i < e ; ++i ) {
+                                        const int z0 = static_cast<int> ( i ) * slab;
+                                        this->polygonize_slab ( isovalue, mask, active, z0, std::min ( z0 + slab, numSlices ), meshes[i] );
                                 }
+                        } );
+
+                        // in the order of slabs, i.e. the same as the serial one.
+                        Mesh mesh;
+
+                        for ( const auto& m : meshes ) {
+                                mesh.append ( m );
                         }
 
                         return mesh;
                 }
         private:
-                int polygonize_cell ( std::vector< std::pair<Point3d, double> >& cell, const std::vector<double>& isovalue, Mesh& mesh )
+                /**
+                * @brief Polygonize cells of z in [z0, z1) in active blocks.
+                */
+                void polygonize_slab ( Data<float>& isovalue, Data<char>& mask, const std::vector<char>& active, const int z0, const int z1, Mesh& mesh )
                 {
-                        unsigned char tableid = 0x00;
-
-                        for ( int i = 0 ; i < 8 ; ++i ) {
-                                if ( std::fabs ( cell[i].second - isovalue[i] ) < this->_iso_eps ) {
-                                        cell[i].second = isovalue[i] + this->_iso_eps ;
-                                }
+                        const auto& info = this->_data.getInfo();
+                        const auto size = info.getSize();
+                        const int bs = this->_pyramid->getBlockSize();
+                        const Point3i numBlocks = this->_pyramid->getNumBlocks();
+                        std::array<double, 8> value;
+                        std::array<double, 8> iso;
 
-                                if ( isovalue[i] <=  cell[i].second ) {
-                                        tableid += ( 0x01 << i );
-                                }
-                        }
+                        for ( int z = z0 ; z < z1 ; ++z ) {
+                                for ( int y = 0 ; y < size.y() - 1 ; ++y ) {
+                                        const size_t row = ( static_cast<size_t> ( z / bs ) * numBlocks.y() + y / bs ) * numBlocks.x();
+                                        // rows of ( y, z ), ( y + 1, z ), ( y, z + 1 ) and ( y + 1, z + 1 ).
+                                        const T* vrow[4] = { this->_data.data ( y, z ), this->_data.data ( y + 1, z ), this->_data.data ( y, z + 1 ), this->_data.data ( y + 1, z + 1 ) };
 
-                        if ( tableid == 0x00 || tableid == 0xFF ) {
-                                return 0;
-                        }
+                                        for ( int bx = 0 ; bx < numBlocks.x() ; ++bx ) {
+                                                if ( !active[row + bx] ) {
+                                                        continue;
+                                                }
 
-                        Vector3d ep[12];
+                                                for ( int x = bx * bs ; x < std::min ( bx * bs + bs, size.x() - 1 ) ; ++x ) {
+                                                        const Point3i p ( x, y, z );
+                                                        bool isPolygonized = false;
 
-                        for ( int i = 0 ; i < 12 ; i++ ) {
-                                const int& id0 = mc_edtable[ 2 * i + 0];
-                                const int& id1 = mc_edtable[ 2 * i + 1];
+                                                        for ( int i = 0 ; i < 8 ; ++i ) {
+                                                                const Point3i np = p + Point3i ( i & 1, ( i >> 1 ) & 1, ( i >> 2 ) & 1 );
+                                                                value[i] = static_cast<double> ( vrow[i >> 1][np.x()] );
+                                                                iso[i] = static_cast<double> ( isovalue.get ( np ) );
 
-                                const double& v0 = cell[id0].second;
-                                const double& v1 = cell[id1].second;
+                                                                if ( mask.get ( np ) > 0 ) {
+                                                                        isPolygonized = true;
+                                                                }
+                                                        }
 
-                                if ( ( ( tableid >> id0 ) & 0x01 )  == ( ( tableid >> id1 ) & 0x01 ) ) {
-                                        continue;
+                                                        if ( isPolygonized ) {
+                                                                mi4::polygonize_cell ( value, iso, this->_iso_eps, [&info, &p] ( const int i ) {
+                                                                        return info.getPointInSpace ( p + Point3i ( i & 1, ( i >> 1 ) & 1, i >> 2 ) );
+                                                                }, [&mesh] ( const int, const Vector3d & ep, const double ) {
+                                                                        return mesh.addPoint ( ep );
+                                                                }, mesh );
+                                                        }
+                                                }
+                                        }
                                 }
-
-                                const double& iso0 = isovalue[id0];
-                                const double& iso1 = isovalue[id1];
-
-                                double t  = - ( v0 - iso0 )  / ( ( v1 - v0 ) - ( iso1 - iso0 ) ) ;	 ///@todo check 0 division
-
-                                const Point3d& p0 = cell[id0].first;
-                                const Point3d& p1 = cell[id1].first;
-                                // ep[i] = ( 1.0 - t ) * p0 + t * p1;
-                                ep[i].x() = ( 1.0 - t ) * p0.x () + t * p1.x();
-                                ep[i].y() = ( 1.0 - t ) * p0.y () + t * p1.y();
-                                ep[i].z() = ( 1.0 - t ) * p0.z () + t * p1.z();
-                        }
-
-                        int numTriangles = 0;
-
-                        for ( int i =  mc_colidx[tableid] ; i < mc_colidx[tableid + 1] ; i += 3 ) {
-                                ++numTriangles;
-                                std::vector<size_t> idx ( 3, 0 );
-                                // check invert
-                                idx[0] = mesh.addPoint ( ep[ mc_idxtable[i  ] ] );
-                                idx[1] = mesh.addPoint ( ep[ mc_idxtable[i + 1] ] );
-                                idx[2] = mesh.addPoint ( ep[ mc_idxtable[i + 2] ] );
-                                mesh.addFace ( idx );
                         }
-
-                        return numTriangles;
                 }
+
         private:
                 double         _iso_eps;
+                int            _slabSize;
+                std::unique_ptr<MinMaxPyramid<T> > _pyramid; ///< Min/max pyramid of the volume.
                 VolumeData<T>& _data; ///< Volume data.
         };
 };
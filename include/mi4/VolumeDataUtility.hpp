@@ -3,6 +3,8 @@
 #include "ParallelFor.hpp"
 #include "VolumeData.hpp"
 #include "PriorityQueue.hpp"
+#include "BinaryVolume.hpp"
+#include "Simd.hpp"
 #include <thread>
 #include <string>
 #include <cstring>
@@ -12,11 +14,17 @@
 #include <cstdlib>
 #include <vector>
 #include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
 
 namespace mi4
 {
         class VolumeDataUtility
         {
+        private:
+                /// Voxels per task of the element-wise kernels.
+                static constexpr size_t simd_grain_size = 1 << 16;
         public:
                 static bool& isDebugMode ( void )
                 {
@@ -40,8 +48,21 @@ namespace mi4
                                 return false;
                         }
 
-                        fin.seekg ( headerSize );
-                        return data.read(fin);
+                        return data.read ( fin, static_cast<size_t> ( headerSize ) );
+                }
+
+                /**
+                 * @brief Map a raw file without loading it. See VolumeData::map().
+                 */
+                template< typename T>
+                static bool map ( VolumeData<T>& data, const std::string& filename, const int headerSize = 0, const bool readOnly = true )
+                {
+                        if ( !data.map ( filename, static_cast<size_t> ( headerSize ), readOnly ) ) {
+                                std::cerr << "Map failed." << std::endl;
+                                return false;
+                        }
+
+                        return true;
                 }
                 template< typename T>
                 static bool save ( VolumeData<T>& data, const std::string& filename )
@@ -70,30 +91,85 @@ namespace mi4
                 template <typename T>
                 static VolumeData<T> changeEndian ( const VolumeData<T>& data )
                 {
-                        VolumeData<T> result ( data.getInfo() );
-
-                        for ( const auto& p : Range ( data.getInfo() ) ) {
-                                const T v = data.get ( p );
-                                const int size = sizeof ( T );
-
-                                if ( size > 1 ) {
-                                        unsigned char* c = new unsigned char[size];
-                                        std::memcpy ( &v, c, size );
+                        VolumeData<T> result ( data );
+                        T* voxels = result.data();
+                        mi4::parallel_for ( 0, result.getNumVoxels(), [voxels] ( const size_t b, const size_t e ) {
+                                mi4::simd::byteswap ( voxels + b, e - b );
+                        }, VolumeDataUtility::simd_grain_size );
+                        return result;
+                }
 
-                                        for ( int i = 0 ; i < size / 2 ; ++i ) {
-                                                unsigned char tmp = c[i];
-                                                c[i] = c[ size - 1 - i ];
-                                                c[ size - 1 - i ] = tmp;
-                                        }
+                /****
+                 * Statistics
+                 */
+                template <typename T>
+                static std::pair<T, T> minmax ( const VolumeData<T>& data )
+                {
+                        const T* voxels = data.data();
+                        const auto identity = std::make_pair ( std::numeric_limits<T>::max(), std::numeric_limits<T>::lowest() );
+                        return mi4::parallel_reduce ( 0, data.getNumVoxels(), identity, [voxels] ( const size_t b, const size_t e, std::pair<T, T> value ) {
+                                for ( size_t i = b ; i < e ; ++i ) {
+                                        value.first = std::min ( value.first, voxels[i] );
+                                        value.second = std::max ( value.second, voxels[i] );
+                                }
+                                return value;
+                        }, [] ( const std::pair<T, T>& a, const std::pair<T, T>& b ) {
+                                return std::make_pair ( std::min ( a.first, b.first ), std::max ( a.second, b.second ) );
+                        } );
+                }
 
-                                        std::memcpy ( c, &v, size );
-                                        delete[] c;
+                template <typename T>
+                static double sum ( const VolumeData<T>& data )
+                {
+                        const T* voxels = data.data();
+                        return mi4::parallel_reduce ( 0, data.getNumVoxels(), 0.0, [voxels] ( const size_t b, const size_t e, double value ) {
+                                for ( size_t i = b ; i < e ; ++i ) {
+                                        value += static_cast<double> ( voxels[i] );
                                 }
+                                return value;
+                        }, std::plus<double>() );
+                }
 
-                                result.set ( p, v );
+                template <typename T>
+                static double mean ( const VolumeData<T>& data )
+                {
+                        const auto n = data.getNumVoxels();
+                        return ( n == 0 ) ? 0.0 : VolumeDataUtility::sum ( data ) / static_cast<double> ( n );
+                }
+
+                /**
+                 * @brief Histogram of numBins bins over [minValue, maxValue]. Values out of the range are not counted.
+                 * @note numBins = maxValue - minValue + 1 counts each integer value (e.g. voxel counts per label).
+                 */
+                template <typename T>
+                static std::vector<size_t> histogram ( const VolumeData<T>& data, const T minValue, const T maxValue, const size_t numBins )
+                {
+                        if ( numBins == 0 || maxValue < minValue ) {
+                                return std::vector<size_t>();
                         }
 
-                        return std::move ( result );
+                        const T* voxels = data.data();
+                        const double scale = ( maxValue == minValue ) ? 0.0 : static_cast<double> ( numBins ) / ( static_cast<double> ( maxValue ) - static_cast<double> ( minValue ) );
+                        const auto n = data.getNumVoxels();
+                        const auto nthreads = mi4::ThreadPool::getInstance().getNumThreads();
+
+                        // per-thread histograms are merged at the end.
+                        return mi4::parallel_reduce ( 0, n, std::vector<size_t> ( numBins, 0 ), [voxels, minValue, maxValue, scale, numBins] ( const size_t b, const size_t e, std::vector<size_t> hist ) {
+                                for ( size_t i = b ; i < e ; ++i ) {
+                                        const T v = voxels[i];
+                                        if ( v < minValue || maxValue < v ) {
+                                                continue;
+                                        }
+                                        const auto bin = static_cast<size_t> ( ( static_cast<double> ( v ) - static_cast<double> ( minValue ) ) * scale );
+                                        hist[ std::min ( bin, numBins - 1 ) ] += 1;
+                                }
+                                return hist;
+                        }, [] ( std::vector<size_t> a, const std::vector<size_t>& b ) {
+                                for ( size_t i = 0 ; i < a.size() ; ++i ) {
+                                        a[i] += b[i];
+                                }
+                                return a;
+                        }, ( n == 0 ) ? 1 : ( n - 1 ) / nthreads + 1 );
                 }
 
                 /****
@@ -103,13 +179,12 @@ namespace mi4
                 static VolumeData<S> binarize ( const VolumeData<T>& data, const T threshold, const S fgValue = 1 )
                 {
                         VolumeData<S> result ( data.getInfo() );
-
-                        for ( const auto& p : Range ( data.getInfo() ) ) {
-                                const S value = ( data.get ( p ) <  threshold ) ? 0 : fgValue;
-                                result.set ( p, value );
-                        }
-
-                        return std::move ( result );
+                        const T* in = data.data();
+                        S* out = result.data();
+                        mi4::parallel_for ( 0, data.getNumVoxels(), [in, out, threshold, fgValue] ( const size_t b, const size_t e ) {
+                                mi4::simd::threshold ( in + b, out + b, e - b, threshold, fgValue );
+                        }, VolumeDataUtility::simd_grain_size );
+                        return result;
                 }
 
                 static VolumeData< char > extractBoundaryVoxels (const VolumeData< char >& data, const char BG_VALUE = 0)
@@ -130,6 +205,23 @@ namespace mi4
 
                         return std::move(result);
                 }
+                /**
+                 * @brief Boundary voxels of a bit-packed mask, 64 voxels per word operation.
+                 */
+                static BinaryVolume extractBoundaryVoxels ( const BinaryVolume& data )
+                {
+                        // a voxel is on the boundary if one of its 26 neighbours (in the volume) is background.
+                        auto bg = ~data;
+                        for ( int axis = 0 ; axis < 3 ; ++axis ) {
+                                Point3i d ( 0, 0, 0 );
+                                d[axis] = 1;
+                                auto grown = bg.shift ( d );
+                                grown |= bg.shift ( -d );
+                                bg |= grown;
+                        }
+                        return bg &= data;
+                }
+
                 //
                 // 型変換
                 //
@@ -137,12 +229,12 @@ namespace mi4
                 static VolumeData<S> cast ( const VolumeData<T>& data )
                 {
                         VolumeData<S> result ( data.getInfo() );
-
-                        for ( const auto& p : Range ( data.getInfo() ) ) {
-                                result.at(p) = static_cast<S> ( data.at(p));
-                        }
-
-                        return std::move ( result );
+                        const T* in = data.data();
+                        S* out = result.data();
+                        mi4::parallel_for ( 0, data.getNumVoxels(), [in, out] ( const size_t b, const size_t e ) {
+                                mi4::simd::convert ( in + b, out + b, e - b );
+                        }, VolumeDataUtility::simd_grain_size );
+                        return result;
                 }
 
                 template <typename T>
@@ -170,16 +262,28 @@ namespace mi4
                         return outData;
                 }
 
+                static BinaryVolume diff ( const BinaryVolume& srcData, const BinaryVolume& trgData )
+                {
+                        return BinaryVolume ( srcData ).andNot ( trgData );
+                }
+
+                static BinaryVolume negate_binary ( const BinaryVolume& inData )
+                {
+                        return ~inData;
+                }
+
                 template< typename T>
                 static VolumeData<T> negate_binary ( const VolumeData<T>& inData )
                 {
                         VolumeData< T > outData(inData.getInfo());
-
-                        for ( const auto& p : mi4::Range(inData.getInfo())) {
-                                outData.at(p) = 1 - inData.at(p);
-                        }
-
-                        return std::move(outData);
+                        const T* in = inData.data();
+                        T* out = outData.data();
+                        mi4::parallel_for ( 0, inData.getNumVoxels(), [in, out] ( const size_t b, const size_t e ) {
+                                mi4::simd::transform ( in + b, out + b, e - b, [] ( const T v ) {
+                                        return static_cast<T> ( 1 - v );
+                                } );
+                        }, VolumeDataUtility::simd_grain_size );
+                        return outData;
                 }
 
                 class morphology
@@ -241,28 +345,49 @@ namespace mi4
                         }
                 };
 
+                /****
+                 * Morphology with a spherical structuring element of radius r (in space).
+                 * The result equals the morphology class, but it is computed by thresholding the distance field,
+                 * so the cost does not depend on r.
+                 */
                 template<typename T>
                 static VolumeData<T> erode ( const VolumeData<T>& inData, const double r )
                 {
-                        const auto& info = inData.getInfo();
-                        VolumeData<T> result ( info );
-                        Range range ( info );
-                        const int nthreads = std::thread::hardware_concurrency();
-                        mi4::parallel_for_each ( range.begin(), range.end(), morphology ( inData, result, r, false ), nthreads );
-                        //std::for_each ( range.begin(), range.end(), morphology ( inData, result, r, false ) );
-                        return std::move ( result );
+                        return VolumeDataUtility::morphology_by_distance ( inData, r, false );
                 }
 
                 template<typename T>
                 static VolumeData<T> dilate ( const VolumeData<T>& inData, const double r )
                 {
-                        const auto& info = inData.getInfo();
-                        VolumeData<T> result ( info );
-                        Range range ( info );
-                        const int nthreads = std::thread::hardware_concurrency();
-                        mi4::parallel_for_each ( range.begin(), range.end(), morphology ( inData, result, r, true ), nthreads );
-                        //std::for_each ( range.begin(), range.end(), morphology ( inData, result, r, true ) );
-                        return std::move ( result );
+                        return VolumeDataUtility::morphology_by_distance ( inData, r, true );
+                }
+
+                template<typename T>
+                static VolumeData<T> opening ( const VolumeData<T>& inData, const double r )
+                {
+                        return VolumeDataUtility::dilate ( VolumeDataUtility::erode ( inData, r ), r );
+                }
+
+                template<typename T>
+                static VolumeData<T> closing ( const VolumeData<T>& inData, const double r )
+                {
+                        return VolumeDataUtility::erode ( VolumeDataUtility::dilate ( inData, r ), r );
+                }
+
+                /****
+                 * Morphology with a box structuring element of (2 * halfSize + 1) voxels.
+                 * Computed by van Herk/Gil-Werman max (min) filters along x, y and z.
+                 */
+                template<typename T>
+                static VolumeData<T> dilateBox ( const VolumeData<T>& inData, const Point3i& halfSize )
+                {
+                        return VolumeDataUtility::box_filter ( inData, halfSize, std::numeric_limits<T>::lowest(), std::greater<T>() );
+                }
+
+                template<typename T>
+                static VolumeData<T> erodeBox ( const VolumeData<T>& inData, const Point3i& halfSize )
+                {
+                        return VolumeDataUtility::box_filter ( inData, halfSize, std::numeric_limits<T>::max(), std::less<T>() );
                 }
 
                 // Convert vector distance field to scalar vector field
@@ -279,213 +404,610 @@ namespace mi4
                 }
 
         private:
-                static void dist_main ( const int z,  const VolumeData<char>& binary, const VolumeData<short>& tmpz, VolumeData<mi4::Vector3s>& result )
+                template<typename T>
+                static VolumeData<T> morphology_by_distance ( const VolumeData<T>& inData, const double r, const bool isDilate )
                 {
-                        const auto& info = binary.getInfo();
-                        const auto& size = info.getSize();
-
-                        for ( int y = 0 ; y < size.y() ; ++y ) {
-                                std::vector<short> cloy ( size.x(), std::numeric_limits<short>::min() ) ;
+                        const auto& info = inData.getInfo();
+                        const T fg = isDilate ? 1 : 0;
+                        const T bg = isDilate ? 0 : 1;
+                        VolumeData<T> result ( info );
 
-                                for ( int x = 0 ; x < size.x() ; ++x ) {
-                                        if ( binary.at(x, y, z) == 0 ) {
-                                                cloy[x] = y;
-                                        } else {
-                                                float mind = std::numeric_limits<float>::max();
+                        // sites (voxels of fg) are 0 in the input of distance_field.
+                        VolumeData<char> sites ( info );
+                        const T* in = inData.data();
+                        char* s = sites.data();
+                        const auto numSites = mi4::parallel_transform_reduce ( 0, inData.getNumVoxels(), size_t ( 0 ), [in, s, fg] ( const size_t i ) {
+                                s[i] = ( in[i] == fg ) ? 0 : 1;
+                                return static_cast<size_t> ( in[i] == fg );
+                        }, std::plus<size_t>() );
+
+                        if ( numSites == 0 ) {
+                                result.fill ( bg );
+                                return result;
+                        }
 
-                                                for ( int dy = 0 ; dy < size.y() ; ++dy ) {
-                                                        auto clz = tmpz.get ( mi4::Point3i ( x, dy, z ) );
+                        const auto df = VolumeDataUtility::distance_field ( sites );
+                        const auto r2 = r * r;
+                        mi4::parallel_for ( Range ( info ), [&info, &df, &result, r2, fg, bg] ( const Range& slab ) {
+                                for ( const auto& p : slab ) {
+                                        result.set ( p, ( r2 < info.getLengthSquared ( df.get ( p ).template cast<int>() ) ) ? bg : fg );
+                                }
+                        } );
+                        return result;
+                }
 
-                                                        if ( clz <  0 ) {
-                                                                continue;        // when closest site does not exist.
-                                                        }
+                template<typename T, class Compare>
+                static VolumeData<T> box_filter ( const VolumeData<T>& inData, const Point3i& halfSize, const T identity, const Compare& comp )
+                {
+                        VolumeData<T> result ( inData );
+                        const auto& size = result.getSize();
 
-                                                        Vector3s v ( 0, dy - y, clz - z ); // (0, dy, dz)
-                                                        float d = info.getLength ( v );	 //dy * dy + dz * dz
+                        for ( int axis = 0 ; axis < 3 ; ++axis ) {
+                                const int k = halfSize[axis];
+                                if ( k <= 0 ) {
+                                        continue;
+                                }
 
-                                                        if ( d < mind ) {
-                                                                mind = d;
-                                                                cloy[x] = dy;
-                                                        }
+                                // lines along axis are indexed by the other two coordinates.
+                                const int a0 = ( axis + 1 ) % 3;
+                                const int a1 = ( axis + 2 ) % 3;
+                                const int n = size[axis];
+                                const auto stride = result.stride() [axis];
+
+                                mi4::parallel_for ( 0, static_cast<size_t> ( size[a0] ) * static_cast<size_t> ( size[a1] ), [&] ( const size_t b, const size_t e ) {
+                                        std::vector<T> line ( static_cast<size_t> ( n ) ), g, h;
+                                        for ( auto i = b ; i < e ; ++i ) {
+                                                Point3i p ( 0, 0, 0 );
+                                                p[a0] = static_cast<int> ( i % static_cast<size_t> ( size[a0] ) );
+                                                p[a1] = static_cast<int> ( i / static_cast<size_t> ( size[a0] ) );
+                                                T* head = &result.at ( p );
+                                                for ( int j = 0 ; j < n ; ++j ) {
+                                                        line[static_cast<size_t> ( j )] = head[j * stride];
+                                                }
+                                                VolumeDataUtility::van_herk_line ( line, k, identity, comp, g, h );
+                                                for ( int j = 0 ; j < n ; ++j ) {
+                                                        head[j * stride] = line[static_cast<size_t> ( j )];
                                                 }
                                         }
-                                }
+                                } );
+                        }
 
-                                for ( int x = 0 ; x < size.x() ; ++x ) {
-                                        short clox = std::numeric_limits<short>::min();
+                        return result;
+                }
 
-                                        if ( binary.at(x, y, z) == 0 ) {
-                                                clox = x;
-                                        } else {
-                                                float mind = std::numeric_limits<float>::max();
+                /**
+                 * @brief 1D max (or min) filter of window 2k+1 in O(n) regardless of k (van Herk/Gil-Werman).
+                 */
+                template<typename T, class Compare>
+                static void van_herk_line ( std::vector<T>& line, const int k, const T identity, const Compare& comp, std::vector<T>& g, std::vector<T>& h )
+                {
+                        const auto n = static_cast<int> ( line.size() );
+                        const int w = 2 * k + 1;
+                        const int m = ( n + 2 * k + w - 1 ) / w * w;
+                        auto value = [&line, n, k, identity] ( const int j ) {
+                                return ( k <= j && j < k + n ) ? line[static_cast<size_t> ( j - k )] : identity;
+                        };
+                        auto best = [&comp] ( const T& a, const T& b ) {
+                                return comp ( a, b ) ? a : b;
+                        };
+
+                        g.resize ( static_cast<size_t> ( m ) );
+                        h.resize ( static_cast<size_t> ( m ) );
+
+                        for ( int j = 0 ; j < m ; ++j ) {
+                                g[static_cast<size_t> ( j )] = ( j % w == 0 ) ? value ( j ) : best ( g[static_cast<size_t> ( j - 1 )], value ( j ) );
+                        }
+                        for ( int j = m - 1 ; j >= 0 ; --j ) {
+                                h[static_cast<size_t> ( j )] = ( j % w == w - 1 ) ? value ( j ) : best ( h[static_cast<size_t> ( j + 1 )], value ( j ) );
+                        }
+                        for ( int i = 0 ; i < n ; ++i ) {
+                                line[static_cast<size_t> ( i )] = best ( h[static_cast<size_t> ( i )], g[static_cast<size_t> ( i + w - 1 )] );
+                        }
+                }
 
-                                                for ( int dx = 0 ; dx < size.x() ; ++dx ) {
-                                                        if ( cloy[dx] < 0 ) {
-                                                                continue;
-                                                        }
+                /**
+                 * @brief 1D squared distance transform of sampled function g (Felzenszwalb and Huttenlocher).
+                 * d[i] = min_q ( w2 * (i - q)^2 + g[q] ) and arg[i] is the minimizer q (-1 if g is infinite everywhere).
+                 * v and zb are work buffers of n and n + 1 elements.
+                 */
+                static void edt_line ( const double* g, const int n, const double w2, double* d, int* arg, int* v, double* zb )
+                {
+                        const double inf = std::numeric_limits<double>::infinity();
+                        int k = -1;
 
-                                                        Vector3s v ( dx - x, cloy[dx] - y, tmpz.get ( mi4::Point3i ( dx, cloy[dx], z ) ) - z );
-                                                        float d = info.getLength ( v );
+                        for ( int q = 0 ; q < n ; ++q ) {
+                                if ( ! ( g[q] < inf ) ) {
+                                        continue;
+                                }
 
-                                                        if ( d < mind ) {
-                                                                mind = d;
-                                                                clox = dx;
-                                                        }
-                                                }
+                                double s = -inf;
+                                while ( k >= 0 ) {
+                                        // intersection of the parabolas rooted at v[k] and q.
+                                        const int r = v[k];
+                                        s = ( ( g[q] + w2 * q * q ) - ( g[r] + w2 * r * r ) ) / ( 2.0 * w2 * ( q - r ) );
+                                        if ( s > zb[k] ) {
+                                                break;
                                         }
-
-                                        const short cx = clox;
-                                        const short cy = cloy[cx];
-                                        const short cz = tmpz.get ( mi4::Point3i ( cx, cy, z ) );
-                                        result.set ( mi4::Point3i ( x, y, z ), Vector3s ( cx - x, cy - y, cz - z ) );
+                                        --k;
+                                }
+                                if ( k < 0 ) {
+                                        s = -inf;
                                 }
+                                ++k;
+                                v[k] = q;
+                                zb[k] = s;
+                                zb[k + 1] = inf;
                         }
 
-                        return;
+                        if ( k < 0 ) {
+                                std::fill ( d, d + n, inf );
+                                std::fill ( arg, arg + n, -1 );
+                                return;
+                        }
+
+                        k = 0;
+                        for ( int i = 0 ; i < n ; ++i ) {
+                                while ( zb[k + 1] < i ) {
+                                        ++k;
+                                }
+                                const int q = v[k];
+                                d[i] = w2 * ( i - q ) * ( i - q ) + g[q];
+                                arg[i] = q;
+                        }
                 }
 
-                static void dist_init ( const int x,  const VolumeData<char>& binary, VolumeData<short>& tmpz )
+                /**
+                 * @brief Nearest site along z for every voxel of row (*, y, *) of slices [z0, z0 + nearestZ.getSize().z()). -1 if the column has no site.
+                 * Sites are voxels where ( value == siteValue ) equals isEqual, searched up to halo slices away from the slices.
+                 */
+                static void edt_columns ( const int y, const VolumeData<char>& binary, VolumeData<short>& nearestZ, const char siteValue = 0, const bool isEqual = true, const int z0 = 0, const int halo = std::numeric_limits<int>::max() )
                 {
-                        const auto& info = binary.getInfo();
-                        const auto& size = info.getSize();
-
-                        for ( int y = 0 ; y < size.y() ; ++y ) {
-                                int cz = std::numeric_limits<short>::min();
-
-                                for ( int z = 0 ; z < size.z() ; ++z ) {
-                                        const mi4::Point3i p ( x, y, z );
+                        const auto& size = binary.getSize();
+                        const int sx = size.x();
+                        const int z1 = z0 + nearestZ.getSize().z();
+                        const int h = std::min ( halo, size.z() );
+                        const int zmin = std::max ( 0, z0 - h );
+                        const int zmax = std::min ( size.z(), z1 + h );
+                        std::vector<int> last ( static_cast<size_t> ( sx ), -1 );
+
+                        for ( int z = zmin ; z < z1 ; ++z ) {
+                                const char* in = binary.data ( y, z );
+                                for ( int x = 0 ; x < sx ; ++x ) {
+                                        if ( ( in[x] == siteValue ) == isEqual ) {
+                                                last[x] = z;
+                                        }
+                                }
+                                if ( z >= z0 ) {
+                                        short* out = nearestZ.data ( y, z - z0 );
+                                        for ( int x = 0 ; x < sx ; ++x ) {
+                                                out[x] = static_cast<short> ( last[x] );
+                                        }
+                                }
+                        }
 
-                                        if ( binary.get ( p ) == 0 ) {
-                                                cz = z;
+                        std::fill ( last.begin(), last.end(), -1 );
+                        for ( int z = zmax - 1 ; z >= z0 ; --z ) {
+                                const char* in = binary.data ( y, z );
+                                for ( int x = 0 ; x < sx ; ++x ) {
+                                        if ( ( in[x] == siteValue ) == isEqual ) {
+                                                last[x] = z;
+                                        }
+                                }
+                                if ( z < z1 ) {
+                                        short* out = nearestZ.data ( y, z - z0 );
+                                        for ( int x = 0 ; x < sx ; ++x ) {
+                                                if ( last[x] >= 0 && ( out[x] < 0 || last[x] - z < z - out[x] ) ) {
+                                                        out[x] = static_cast<short> ( last[x] );
+                                                }
                                         }
+                                }
+                        }
+                }
 
-                                        tmpz.set ( p, cz );
+                /**
+                 * @brief Transform along y, then along x, in slice z. vec and dist point to the first voxel of the slice and either may be null.
+                 * nearestZ holds slices from z0.
+                 */
+                static void edt_slice ( const int z, const VolumeData<short>& nearestZ, Vector3s* vec, float* dist, const int z0 = 0 )
+                {
+                        const auto& info = nearestZ.getInfo();
+                        const auto& size = info.getSize();
+                        const auto pitch = info.getPitch();
+                        const int sx = size.x();
+                        const int sy = size.y();
+                        const int n = std::max ( sx, sy );
+                        const double inf = std::numeric_limits<double>::infinity();
+
+                        std::vector<double> g ( static_cast<size_t> ( n ) ), d ( static_cast<size_t> ( n ) ), zb ( static_cast<size_t> ( n ) + 1 );
+                        std::vector<int> arg ( static_cast<size_t> ( n ) ), v ( static_cast<size_t> ( n ) );
+                        std::vector<short> nearestY ( static_cast<size_t> ( sx ) * static_cast<size_t> ( sy ) );
+                        std::vector<double> dyz ( static_cast<size_t> ( sx ) * static_cast<size_t> ( sy ) );
+
+                        // along y : g = squared z distance.
+                        for ( int x = 0 ; x < sx ; ++x ) {
+                                for ( int y = 0 ; y < sy ; ++y ) {
+                                        const int cz = nearestZ.data ( y, z - z0 ) [x];
+                                        const double dz = pitch.z() * ( cz - z );
+                                        g[y] = ( cz < 0 ) ? inf : dz * dz;
+                                }
+                                VolumeDataUtility::edt_line ( g.data(), sy, pitch.y() * pitch.y(), d.data(), arg.data(), v.data(), zb.data() );
+                                for ( int y = 0 ; y < sy ; ++y ) {
+                                        const auto i = static_cast<size_t> ( x ) + static_cast<size_t> ( sx ) * static_cast<size_t> ( y );
+                                        nearestY[i] = static_cast<short> ( arg[y] );
+                                        dyz[i] = d[y];
                                 }
+                        }
 
-                                cz = std::numeric_limits<short>::min();
+                        // along x : g = squared yz distance.
+                        for ( int y = 0 ; y < sy ; ++y ) {
+                                const double* row = dyz.data() + static_cast<size_t> ( sx ) * static_cast<size_t> ( y );
+                                VolumeDataUtility::edt_line ( row, sx, pitch.x() * pitch.x(), d.data(), arg.data(), v.data(), zb.data() );
 
-                                for ( int z = size.z() - 1 ; z >= 0 ; --z ) {
-                                        const mi4::Point3i p ( x, y, z );
+                                if ( dist != nullptr ) {
+                                        float* out = dist + static_cast<size_t> ( sx ) * static_cast<size_t> ( y );
+                                        for ( int x = 0 ; x < sx ; ++x ) {
+                                                out[x] = static_cast<float> ( std::sqrt ( d[x] ) );
+                                        }
+                                }
 
-                                        if ( binary.get ( p ) == 0 ) {
-                                                cz = z;
-                                        } else {
-                                                if ( std::fabs ( cz - z ) > std::fabs ( z - tmpz.get ( p ) ) ) {
-                                                        cz = tmpz.get ( p );
+                                if ( vec != nullptr ) {
+                                        Vector3s* out = vec + static_cast<size_t> ( sx ) * static_cast<size_t> ( y );
+                                        for ( int x = 0 ; x < sx ; ++x ) {
+                                                const int cx = arg[x];
+                                                if ( cx < 0 ) {
+                                                        out[x] = Vector3s::Constant ( std::numeric_limits<short>::max() );
+                                                        continue;
                                                 }
+                                                const int cy = nearestY[static_cast<size_t> ( cx ) + static_cast<size_t> ( sx ) * static_cast<size_t> ( y )];
+                                                const int cz = nearestZ.data ( cy, z - z0 ) [cx];
+                                                out[x] = Vector3s ( static_cast<short> ( cx - x ), static_cast<short> ( cy - y ), static_cast<short> ( cz - z ) );
                                         }
-
-                                        tmpz.set ( p, cz );
                                 }
                         }
                 }
 
-                static std::vector<int> getRanges ( const size_t length, const int nthread )
+                static void edt ( const VolumeData<char>& binary, VolumeData<Vector3s>* vec, VolumeData<float>* dist )
                 {
-                        std::vector<int> ranges;
-                        const int npt = ( length  - 1 ) / nthread + 1;
-                        int n = 0;
+                        const auto& size = binary.getSize();
+                        VolumeData<short> nearestZ ( binary.getInfo() );
 
-                        while ( n < length ) {
-                                ranges.push_back ( n );
-                                n += npt;
-                        }
+                        mi4::parallel_for ( 0, static_cast<size_t> ( size.y() ), [&binary, &nearestZ] ( const size_t b, const size_t e ) {
+                                for ( auto y = b ; y < e ; ++y ) {
+                                        VolumeDataUtility::edt_columns ( static_cast<int> ( y ), binary, nearestZ );
+                                }
+                        } );
 
-                        ranges.push_back ( length );
-                        return ranges;
+                        // slices are independent after the z pass.
+                        mi4::parallel_for ( 0, static_cast<size_t> ( size.z() ), [&nearestZ, vec, dist] ( const size_t b, const size_t e ) {
+                                for ( auto z = b ; z < e ; ++z ) {
+                                        const auto iz = static_cast<int> ( z );
+                                        VolumeDataUtility::edt_slice ( iz, nearestZ, ( vec != nullptr ) ? vec->data ( 0, iz ) : nullptr, ( dist != nullptr ) ? dist->data ( 0, iz ) : nullptr );
+                                }
+                        } );
                 }
 
         public:
-                static VolumeData<Vector3s> distance_field ( const VolumeData<char>& binary )
+                /**
+                 * @brief Signed distance (negative inside) of slices, computed task by task.
+                 * emit(z0, z1, values) receives the slices [z0, z1) and is called concurrently for disjoint ranges.
+                 * If maxDistance is finite, distances are clamped to [-maxDistance, maxDistance] and each task looks up sites
+                 * only within maxDistance along z, so the z-nearest tables cover the slices of a task instead of the whole volume.
+                 */
+                template <class Function>
+                static void signed_edt ( const VolumeData<char>& mask, const char bg, const int slicesPerTask, const float maxDistance, const Function& emit )
                 {
-                        const int nthreads = std::thread::hardware_concurrency();
-                        const auto& info = binary.getInfo();
+                        const auto& info = mask.getInfo();
                         const auto& size = info.getSize();
-                        mi4::VolumeData<Vector3s> result ( info );
-                        mi4::VolumeData<short> tmpz ( info );
-
-                        std::vector<std::thread> threads;
-
-                        for ( int x = 0 ; x < size.x() ; ++x ) {
-                                threads.push_back ( std::thread ( &VolumeDataUtility::dist_init, x, std::ref ( binary ), std::ref ( tmpz ) ) );
+                        const auto sliceVoxels = static_cast<size_t> ( size.x() ) * static_cast<size_t> ( size.y() );
+                        const bool isBounded = maxDistance < std::numeric_limits<float>::infinity();
+                        VolumeData<short> outsideZ;
+                        VolumeData<short> insideZ;
+
+                        if ( !isBounded ) {
+                                // both sides share the sweeps over the mask.
+                                outsideZ.init ( info );
+                                insideZ.init ( info );
+                                mi4::parallel_for ( 0, static_cast<size_t> ( size.y() ), [&] ( const size_t b, const size_t e ) {
+                                        for ( auto y = b ; y < e ; ++y ) {
+                                                VolumeDataUtility::edt_columns ( static_cast<int> ( y ), mask, outsideZ, bg, false );
+                                                VolumeDataUtility::edt_columns ( static_cast<int> ( y ), mask, insideZ, bg, true );
+                                        }
+                                } );
+                        }
 
-                                if ( threads.size() == nthreads ) {
-                                        for ( auto& th : threads ) {
-                                                th.join();
+                        // a site farther than maxDistance along z is farther than maxDistance.
+                        const int halo = isBounded ? static_cast<int> ( std::ceil ( maxDistance / info.getPitch().z() ) ) : 0;
+                        const int numTasks = ( size.z() + slicesPerTask - 1 ) / slicesPerTask;
+                        mi4::parallel_for ( 0, static_cast<size_t> ( numTasks ), [&] ( const size_t b, const size_t e ) {
+                                std::vector<float> values, inside ( sliceVoxels );
+                                VolumeData<short> localOutsideZ, localInsideZ;
+                                for ( auto t = b ; t < e ; ++t ) {
+                                        const int z0 = static_cast<int> ( t ) * slicesPerTask;
+                                        const int z1 = std::min ( z0 + slicesPerTask, size.z() );
+                                        values.resize ( sliceVoxels * static_cast<size_t> ( z1 - z0 ) );
+
+                                        if ( isBounded ) {
+                                                const VolumeInfo local ( Point3i ( size.x(), size.y(), z1 - z0 ), info.getPitch() );
+                                                localOutsideZ.init ( local );
+                                                localInsideZ.init ( local );
+                                                for ( int y = 0 ; y < size.y() ; ++y ) {
+                                                        VolumeDataUtility::edt_columns ( y, mask, localOutsideZ, bg, false, z0, halo );
+                                                        VolumeDataUtility::edt_columns ( y, mask, localInsideZ, bg, true, z0, halo );
+                                                }
                                         }
 
-                                        threads.clear();
+                                        for ( int z = z0 ; z < z1 ; ++z ) {
+                                                float* out = values.data() + sliceVoxels * static_cast<size_t> ( z - z0 );
+                                                if ( isBounded ) {
+                                                        VolumeDataUtility::edt_slice ( z, localOutsideZ, nullptr, out, z0 );
+                                                        VolumeDataUtility::edt_slice ( z, localInsideZ, nullptr, inside.data(), z0 );
+                                                } else {
+                                                        VolumeDataUtility::edt_slice ( z, outsideZ, nullptr, out );
+                                                        VolumeDataUtility::edt_slice ( z, insideZ, nullptr, inside.data() );
+                                                }
+                                                const char* m = mask.data ( 0, z );
+                                                for ( size_t i = 0 ; i < sliceVoxels ; ++i ) {
+                                                        if ( m[i] != bg ) {
+                                                                out[i] = -inside[i];
+                                                        }
+                                                        if ( isBounded ) {
+                                                                out[i] = std::max ( -maxDistance, std::min ( out[i], maxDistance ) );
+                                                        }
+                                                }
+                                        }
+                                        emit ( z0, z1, values.data() );
                                 }
-                        }
+                        } );
+                }
 
-                        for ( auto& th : threads ) {
-                                th.join();
-                        }
+        private:
+                /**
+                 * @brief Flood slices [z0, z1) from the queued voxels. A voxel is updated when a neighbour offers a higher level (min of its level and the neighbour's).
+                 */
+                template <typename T>
+                static void watershed_flood ( T* label, const std::vector<uint16_t>& level, std::vector<uint16_t>& reached, const Point3i& size, const int z0, const int z1, const int levels, BucketQueue<int64_t>& pq )
+                {
+                        const int64_t sx = size.x();
+                        const int64_t sxy = sx * static_cast<int64_t> ( size.y() );
 
-                        threads.clear();
+                        while ( !pq.empty() ) {
+                                const auto u = pq.getTopIndex();
+                                const auto cost = static_cast<int> ( pq.getTopCost() );
+                                pq.pop();
 
-                        for ( int z = 0 ; z < size.z() ; ++z ) {
-                                threads.push_back ( std::thread ( &VolumeDataUtility::dist_main, z, std::ref ( binary ), std::ref ( tmpz ), std::ref ( result ) ) );
+                                const auto iu = static_cast<size_t> ( u );
+                                const int current = std::min ( reached[iu], level[iu] );
+                                if ( levels - cost != current ) {
+                                        continue; // updated after pushed.
+                                }
 
-                                if ( threads.size() == nthreads ) {
-                                        for ( auto& th : threads ) {
-                                                th.join();
+                                const auto z = u / sxy;
+                                const auto y = ( u % sxy ) / sx;
+                                const auto x = u % sx;
+                                const int64_t nbr[6] = {
+                                        ( x > 0 ) ? u - 1 : -1, ( x + 1 < sx ) ? u + 1 : -1,
+                                        ( y > 0 ) ? u - sx : -1, ( y + 1 < size.y() ) ? u + sx : -1,
+                                        ( z > z0 ) ? u - sxy : -1, ( z + 1 < z1 ) ? u + sxy : -1
+                                };
+
+                                for ( const auto v : nbr ) {
+                                        if ( v < 0 ) {
+                                                continue;
+                                        }
+                                        const auto iv = static_cast<size_t> ( v );
+                                        const auto offer = std::min<int> ( level[iv], current );
+                                        if ( offer > reached[iv] ) {
+                                                reached[iv] = static_cast<uint16_t> ( offer );
+                                                label[iv] = label[iu];
+                                                pq.push ( v, static_cast<size_t> ( levels - offer ) );
                                         }
+                                }
+                        }
+                }
 
-                                        threads.clear();
+                /**
+                 * @brief Flood the float weights in a single thread, voxels of higher weight first. A voxel takes the label of the neighbour that reaches it first.
+                 */
+                template <typename T>
+                static void watershed_exact ( T* label, const float* weight, const Point3i& size )
+                {
+                        const int64_t sx = size.x();
+                        const int64_t sxy = sx * static_cast<int64_t> ( size.y() );
+                        const int64_t n = sxy * static_cast<int64_t> ( size.z() );
+
+                        IndexedPriorityQueue<float> pq ( n );
+                        for ( int64_t i = 0 ; i < n ; ++i ) {
+                                if ( label[i] > 0 && weight[i] > 0 ) {
+                                        pq.push ( i, -weight[i] );
                                 }
                         }
 
-                        for ( auto& th : threads ) {
-                                th.join();
+                        while ( !pq.empty() ) {
+                                const auto u = pq.getTopIndex();
+                                pq.pop();
+
+                                const auto z = u / sxy;
+                                const auto y = ( u % sxy ) / sx;
+                                const auto x = u % sx;
+                                const int64_t nbr[6] = {
+                                        ( x + 1 < sx ) ? u + 1 : -1, ( x > 0 ) ? u - 1 : -1,
+                                        ( y + 1 < size.y() ) ? u + sx : -1, ( y > 0 ) ? u - sx : -1,
+                                        ( z + 1 < size.z() ) ? u + sxy : -1, ( z > 0 ) ? u - sxy : -1
+                                };
+
+                                for ( const auto v : nbr ) {
+                                        if ( v < 0 || label[v] != 0 || weight[v] <= 0 ) {
+                                                continue;
+                                        }
+                                        label[v] = label[u];
+                                        pq.push ( v, -weight[v] );
+                                }
                         }
+                }
 
+        public:
+                /**
+                 * @brief Exact Euclidean distance field in linear time. Sites are voxels of value 0.
+                 * @return Vector from each voxel to its nearest site. Components are std::numeric_limits<short>::max() if there is no site.
+                 */
+                static VolumeData<Vector3s> distance_field ( const VolumeData<char>& binary )
+                {
+                        VolumeData<Vector3s> result ( binary.getInfo() );
+                        VolumeDataUtility::edt ( binary, &result, nullptr );
                         return result;
                 }
 
-                /********
-                 * Watershed.
-                 * valid label: >0
-                 * weight : distance
-                 ********/
-                template <typename T>
-                static
-                void watershed ( mi4::VolumeData<T>& label,  const mi4::VolumeData<float>& weight )
+                /**
+                 * @brief Distance from each voxel to its nearest site (voxels of value 0), without the vector field.
+                 * The distance is infinity if there is no site.
+                 */
+                static VolumeData<float> distance_map ( const VolumeData<char>& binary )
                 {
-                        const auto& info = label.getInfo();
+                        VolumeData<float> result ( binary.getInfo() );
+                        VolumeDataUtility::edt ( binary, nullptr, &result );
+                        return result;
+                }
 
-                        PriorityQueue <Point3i> pq;
+                /**
+                 * @brief Signed distance field of a mask : distance to the nearest voxel of the other side, negative inside (voxels != bg).
+                 * Both sides are computed in one parallel pass.
+                 */
+                static VolumeData<float> signedDistanceField ( const VolumeData<char>& mask, const char bg = 0 )
+                {
+                        VolumeData<float> result ( mask.getInfo() );
+                        const auto sliceVoxels = static_cast<size_t> ( mask.getSize().x() ) * static_cast<size_t> ( mask.getSize().y() );
+                        VolumeDataUtility::signed_edt ( mask, bg, 1, std::numeric_limits<float>::infinity(), [&result, sliceVoxels] ( const int z0, const int z1, const float* values ) {
+                                std::copy ( values, values + sliceVoxels * static_cast<size_t> ( z1 - z0 ), result.data ( 0, z0 ) );
+                        } );
+                        return result;
+                }
 
-                        // initialization. set pixels to the queue
-                        for ( const auto& p : mi4::Range ( info ) ) {
-                                if ( label.get ( p ) > 0 && weight.get ( p ) > 0 ) {
-                                        pq.push ( p, -weight.get ( p ) ) ;
-                                }
+                /**
+                 * @brief Priority-flood watershed. Labels (> 0) of voxels of positive weight spread to unlabelled voxels of positive weight,
+                 * voxels of higher weight first.
+                 *
+                 * Weights are quantised into numLevels levels and flooded with a bucket queue over linear voxel indices.
+                 * The volume is split into z-slabs flooded in parallel, and the slabs then exchange improvements across their borders until nothing changes.
+                 * Each voxel ends at the level of its best (maximin) path from a seed regardless of the slabs. Where several labels reach a voxel
+                 * at the same level, which one wins may depend on the slabs.
+                 * @param [in] numLevels Number of levels (1 - 65535, 4096 by default). 0 or less floods the float weights without quantisation
+                 * in a single thread (slabSize is ignored).
+                 * @param [in] slabSize Number of slices per slab. 0 chooses it from the number of threads.
+                 */
+                template <typename T>
+                static
+                void watershed ( mi4::VolumeData<T>& label,  const mi4::VolumeData<float>& weight, const int numLevels = 4096, const int slabSize = 0 )
+                {
+                        const auto& size = label.getSize();
+                        const auto n = label.getNumVoxels();
+                        if ( n == 0 ) {
+                                return;
                         }
 
-                        std::vector<Point3i> nbr = { Point3i ( 1, 0, 0 ), Point3i ( -1, 0, 0 ), Point3i ( 0, 1,  0 ), Point3i ( 0, -1, 0 ), Point3i ( 0, 0, 1 ), Point3i ( 0, 0, -1 ) };
-
-                        while ( !pq.empty() ) {
-                                const auto p = pq.getTopIndex();
-                                pq.pop();
-                                const int labelId = label.get ( p ); // Label ID to be propagated.
-
-                                for ( const auto& d : nbr ) {
-                                        const Point3i np = d + p;
+                        if ( numLevels <= 0 ) {
+                                VolumeDataUtility::watershed_exact ( label.data(), weight.data(), size );
+                                return;
+                        }
 
-                                        if ( ! info.isValid ( np ) ) {
-                                                continue;
+                        const int levels = std::min ( numLevels, 65535 );
+                        const float* w = weight.data();
+                        const T* lab = label.data();
+                        const float maxWeight = mi4::parallel_transform_reduce ( 0, n, 0.0f, [w] ( const size_t i ) {
+                                return w[i];
+                        }, [] ( const float a, const float b ) {
+                                return std::max ( a, b );
+                        } );
+
+                        // level 0 is not flooded. labelled voxels are never updated (reached is the maximum), and only seeds (label > 0) spread.
+                        const double scale = ( maxWeight > 0 ) ? static_cast<double> ( levels ) / static_cast<double> ( maxWeight ) : 0.0;
+                        std::vector<uint16_t> level ( n ), reached ( n );
+                        mi4::parallel_for ( 0, n, [&] ( const size_t b, const size_t e ) {
+                                for ( auto i = b ; i < e ; ++i ) {
+                                        const auto q = ( w[i] > 0 ) ? std::max ( 1, std::min ( levels, static_cast<int> ( std::ceil ( w[i] * scale ) ) ) ) : 0;
+                                        level[i] = ( lab[i] < 0 ) ? 0 : static_cast<uint16_t> ( q );
+                                        reached[i] = ( lab[i] != 0 ) ? std::numeric_limits<uint16_t>::max() : 0;
+                                }
+                        }, 1 << 16 );
+
+                        const int numSlices = size.z();
+                        const int slab = ( slabSize > 0 ) ? slabSize : ( numSlices - 1 ) / static_cast<int> ( mi4::ThreadPool::getInstance().getNumThreads() ) + 1;
+                        const int numSlabs = ( numSlices + slab - 1 ) / slab;
+                        const auto sliceVoxels = static_cast<int64_t> ( size.x() ) * static_cast<int64_t> ( size.y() );
+                        T* data = label.data();
+
+                        // flood each slab from its seeds.
+                        mi4::parallel_for ( 0, static_cast<size_t> ( numSlabs ), [&] ( const size_t b, const size_t e ) {
+                                for ( auto s = static_cast<int> ( b ) ; s < static_cast<int> ( e ) ; ++s ) {
+                                        const int z0 = s * slab;
+                                        const int z1 = std::min ( z0 + slab, numSlices );
+                                        BucketQueue<int64_t> pq ( static_cast<size_t> ( levels ) + 1 );
+                                        for ( auto i = z0 * sliceVoxels ; i < z1 * sliceVoxels ; ++i ) {
+                                                if ( data[i] > 0 && level[static_cast<size_t> ( i )] > 0 ) {
+                                                        pq.push ( i, static_cast<size_t> ( levels - level[static_cast<size_t> ( i )] ) );
+                                                }
                                         }
-
-                                        if ( label.get ( np ) != 0 ) {
-                                                continue;
+                                        VolumeDataUtility::watershed_flood ( data, level, reached, size, z0, z1, levels, pq );
+                                }
+                        } );
+
+                        // exchange improvements across slab borders. collecting them only reads, so it does not race with flooding.
+                        struct Update {
+                                int64_t index;
+                                uint16_t level;
+                                T label;
+                        };
+                        std::vector< std::vector<Update> > updates ( static_cast<size_t> ( numSlabs ) );
+                        while ( numSlabs > 1 ) {
+                                mi4::parallel_for ( 0, static_cast<size_t> ( numSlabs ), [&] ( const size_t b, const size_t e ) {
+                                        for ( auto s = static_cast<int> ( b ) ; s < static_cast<int> ( e ) ; ++s ) {
+                                                const int z0 = s * slab;
+                                                const int z1 = std::min ( z0 + slab, numSlices );
+                                                auto& list = updates[static_cast<size_t> ( s )];
+                                                list.clear();
+                                                for ( const auto& face : {std::make_pair ( z0, z0 - 1 ), std::make_pair ( z1 - 1, z1 ) } ) {
+                                                        if ( face.second < 0 || numSlices <= face.second ) {
+                                                                continue;
+                                                        }
+                                                        for ( int64_t i = 0 ; i < sliceVoxels ; ++i ) {
+                                                                const auto v = static_cast<size_t> ( face.first * sliceVoxels + i );
+                                                                const auto u = static_cast<size_t> ( face.second * sliceVoxels + i );
+                                                                const auto offer = std::min ( level[v], std::min ( reached[u], level[u] ) );
+                                                                if ( offer > reached[v] ) {
+                                                                        list.push_back ( Update { static_cast<int64_t> ( v ), offer, data[u] } );
+                                                                }
+                                                        }
+                                                }
                                         }
+                                }, 1 );
 
-                                        if ( weight.get ( np ) > 0 ) {
-                                                label.set ( np, labelId );
-                                                pq.push ( np, -weight.get ( np ) );
-                                        }
+                                size_t numUpdates = 0;
+                                for ( const auto& list : updates ) {
+                                        numUpdates += list.size();
+                                }
+                                if ( numUpdates == 0 ) {
+                                        break;
                                 }
+
+                                mi4::parallel_for ( 0, static_cast<size_t> ( numSlabs ), [&] ( const size_t b, const size_t e ) {
+                                        for ( auto s = static_cast<int> ( b ) ; s < static_cast<int> ( e ) ; ++s ) {
+                                                const auto& list = updates[static_cast<size_t> ( s )];
+                                                if ( list.empty() ) {
+                                                        continue;
+                                                }
+                                                const int z0 = s * slab;
+                                                const int z1 = std::min ( z0 + slab, numSlices );
+                                                BucketQueue<int64_t> pq ( static_cast<size_t> ( levels ) + 1 );
+                                                for ( const auto& update : list ) {
+                                                        const auto v = static_cast<size_t> ( update.index );
+                                                        if ( update.level > reached[v] ) {
+                                                                reached[v] = update.level;
+                                                                data[v] = update.label;
+                                                                pq.push ( update.index, static_cast<size_t> ( levels - update.level ) );
+                                                        }
+                                                }
+                                                VolumeDataUtility::watershed_flood ( data, level, reached, size, z0, z1, levels, pq );
+                                        }
+                                }, 1 );
                         }
 
                         return;
@@ -1,300 +1,631 @@
 #ifndef MI_CCL_HPP
 #define MI_CCL_HPP 1
 #include <vector>
+#include <atomic>
+#include <algorithm>
+#include <utility>
+#include <limits>
+#include <iostream>
+#include <iterator>
+#include <cstddef>
+#include <type_traits>
 #include <cstdlib>
 #include <mi4/VolumeData.hpp>
+#include <mi4/ParallelFor.hpp>
+#include <mi4/ComponentStats.hpp>
+#include <mi4/BinaryVolume.hpp>
+#include <mi4/Octree.hpp>
 namespace mi4
 {
-        class ccl
+        /**
+         * @brief Connected component labelling on run-length codes.
+         *
+         * Runs are extracted and joined slab by slab in parallel. Components are merged with a lock-free union-find
+         * (CAS linking of the larger root under the smaller one, path halving), so the root of a component is its first run
+         * and labels are numbered in z-y-x scan order of the first voxel. Statistics of each component (ComponentStats) are
+         * accumulated from the runs while labels are assigned.
+         *
+         * @tparam Connectivity 6, 18 or 26.
+         * @tparam Coord Type of x and length of runs. The width of the volume must not exceed its maximum.
+         * @tparam Index Type of run ids and labels. The number of runs must not exceed its maximum.
+         * e.g. basic_ccl<26, int, long long> for volumes wider than 32767 voxels or with more than 2^31 runs.
+         * @tparam Value Type of voxel values, e.g. basic_ccl<26, short, int, short> for a label volume of more than 255 classes.
+         */
+        template <int Connectivity = 26, typename Coord = short, typename Index = int, typename Value = char>
+        class basic_ccl
         {
+                static_assert ( Connectivity == 6 || Connectivity == 18 || Connectivity == 26, "connectivity must be 6, 18 or 26." );
+                static_assert ( std::is_integral<Coord>::value && std::is_integral<Index>::value, "Coord and Index must be integral." );
+        public:
+                typedef ComponentStats<Value> stats_type;
         private:
-                typedef int id_t;
-                class RunLengthCodeBinary
+                typedef Index id_t;
+
+                /**
+                 * @brief Runs in structure-of-arrays layout.
+                 * The row (y, z) of a run is implied by the row index, so a run costs 2 * sizeof(Coord) + sizeof(T) bytes.
+                 */
+                template <typename T>
+                class RunLengthObject
                 {
                 private:
-                        mi4::Vector3s _start;
-                        short int _length;
-                        id_t _parent; // -1 : root, others: id
+                        std::vector<Coord> _x;
+                        std::vector<Coord> _length;
+                        std::vector<T> _values;
+                        std::vector<Index> _idx; // y * z + 1
+                        bool _isValid;
                 public:
-                        explicit RunLengthCodeBinary ( const mi4::Vector3s& start, const short int length ): _start ( start ), _length ( length ), _parent ( -1 )
+                        RunLengthObject ( const VolumeData<T>& data ) : _isValid ( true )
                         {
+                                const auto& size = data.getSize();
+                                const auto numRows = static_cast<size_t> ( size.y() ) * static_cast<size_t> ( size.z() );
+                                this->_idx.assign ( numRows + 1, 0 );
+
+                                if ( static_cast<unsigned long long> ( size.x() ) > static_cast<unsigned long long> ( std::numeric_limits<Coord>::max() ) ) {
+                                        std::cerr << " error : width " << size.x() << " exceeds the coordinate type of runs." << std::endl;
+                                        this->_isValid = false;
+                                        return;
+                                }
+
+                                struct Slice {
+                                        std::vector<Coord> x;
+                                        std::vector<Coord> length;
+                                        std::vector<T> values;
+                                };
+                                std::vector<Slice> slices ( static_cast<size_t> ( size.z() ) );
+                                std::vector<size_t> rowCount ( numRows, 0 );
+
+                                // encode each slice independently.
+                                mi4::parallel_for ( 0, static_cast<size_t> ( size.z() ), [&] ( const size_t b, const size_t e ) {
+                                        for ( auto z = b ; z < e ; ++z ) {
+                                                auto& slice = slices[z];
+                                                for ( auto y = 0 ; y < size.y() ; ++y ) {
+                                                        const auto before = slice.x.size();
+                                                        RunLengthObject::encode_row ( data.data ( y, static_cast<int> ( z ) ), size.x(), slice );
+                                                        rowCount[z * static_cast<size_t> ( size.y() ) + static_cast<size_t> ( y )] = slice.x.size() - before;
+                                                }
+                                        }
+                                } );
+
+                                size_t numCodes = 0;
+                                for ( size_t i = 0 ; i < numRows ; ++i ) {
+                                        numCodes += rowCount[i];
+                                        if ( numCodes > static_cast<size_t> ( std::numeric_limits<Index>::max() ) ) {
+                                                std::cerr << " error : the number of runs exceeds the index type." << std::endl;
+                                                this->_idx.assign ( numRows + 1, 0 );
+                                                this->_isValid = false;
+                                                return;
+                                        }
+                                        this->_idx[i + 1] = static_cast<Index> ( numCodes );
+                                }
+
+                                this->_x.resize ( numCodes );
+                                this->_length.resize ( numCodes );
+                                this->_values.resize ( numCodes );
+                                mi4::parallel_for ( 0, static_cast<size_t> ( size.z() ), [&] ( const size_t b, const size_t e ) {
+                                        for ( auto z = b ; z < e ; ++z ) {
+                                                const auto offset = static_cast<size_t> ( this->_idx[z * static_cast<size_t> ( size.y() )] );
+                                                auto& slice = slices[z];
+                                                std::copy ( slice.x.begin(), slice.x.end(), this->_x.begin() + offset );
+                                                std::copy ( slice.length.begin(), slice.length.end(), this->_length.begin() + offset );
+                                                std::copy ( slice.values.begin(), slice.values.end(), this->_values.begin() + offset );
+                                                slice = Slice();
+                                        }
+                                } );
                                 return;
                         }
 
-                        RunLengthCodeBinary ( const RunLengthCodeBinary& that ) = default;
-                        RunLengthCodeBinary ( RunLengthCodeBinary&& that ) = default;
-                        RunLengthCodeBinary& operator = ( const RunLengthCodeBinary& that ) = default;
-                        RunLengthCodeBinary& operator = ( RunLengthCodeBinary&& that ) = default;
-                        ~RunLengthCodeBinary ( void ) = default;
+                        bool isValid ( void ) const
+                        {
+                                return this->_isValid;
+                        }
 
-                        void setParent ( const id_t parent )
+                        size_t size ( void ) const
                         {
-                                this->_parent = parent;
-                                return;
+                                return this->_x.size();
                         }
-                        id_t getParent ( void ) const
+
+                        int getStart ( const size_t i ) const
                         {
-                                return this->_parent;
+                                return static_cast<int> ( this->_x[i] );
                         }
-                        bool isConnected ( const RunLengthCodeBinary& that )
+
+                        int getEnd ( const size_t i ) const
                         {
-                                return this->is_connected_26 ( that );
+                                return static_cast<int> ( this->_x[i] ) + static_cast<int> ( this->_length[i] ) - 1;
                         }
-                        short int getLength ( void ) const
+
+                        int getLength ( const size_t i ) const
                         {
-                                return this->_length;
+                                return static_cast<int> ( this->_length[i] );
                         }
-                        const mi4::Vector3s& getStart ( void ) const
+
+                        T getValue ( const size_t i ) const
                         {
-                                return this->_start;
+                                return this->_values[i];
+                        }
+
+                        const std::vector<Index>& index ( void ) const
+                        {
+                                return this->_idx;
                         }
                 private:
-                        bool is_connected_26 ( const RunLengthCodeBinary& that )
+                        template <typename Slice>
+                        static void encode_row ( const T* row, const int sx, Slice& slice )
                         {
-                                const auto& start0 = this->getStart();
-                                const auto sx0 = start0.x();
-                                const auto sy0 = start0.y();
-                                const auto sz0 = start0.z();
-
-                                const auto& start1 = that.getStart();
-                                const auto sx1 = start1.x();
-                                const auto sy1 = start1.y();
-                                const auto sz1 = start1.z();
-
-                                const auto length0 = this->getLength();
-                                const auto length1 = that.getLength();
-
-                                const auto dy = std::abs ( sy0 - sy1 );
-                                const auto dz = std::abs ( sz0 - sz1 );
-
-                                if ( dy > 1 || dz > 1 ) {
-                                        return false;
+                                int x = 0;
+                                while ( x < sx ) {
+                                        if ( row[x] == 0 ) {
+                                                ++x;
+                                                continue;
+                                        }
+                                        const int start = x;
+                                        const auto value = row[x];
+                                        while ( x < sx && row[x] == value ) {
+                                                ++x;
+                                        }
+                                        slice.x.push_back ( static_cast<Coord> ( start ) );
+                                        slice.length.push_back ( static_cast<Coord> ( x - start ) );
+                                        slice.values.push_back ( value );
                                 }
+                        }
+                };
 
-                                const auto mn0 = sx0;
-                                const auto mx0 = sx0 + length0 - 1;
-
-                                const auto mn1 = sx1;
-                                const auto mx1 = sx1 + length1 - 1;
-
-                                return  ( mn0 - 1 <= mn1 && mn1 <= mx0 + 1 ) ||
-                                        ( mn0 - 1 <= mx1 && mx1 <= mx0 + 1 ) ||
-                                        ( mn1 - 1 <= mn0 && mn0 <= mx1 + 1 ) ||
-                                        ( mn1 - 1 <= mx0 && mx0 <= mx1 + 1 ) ;
+                using parent_type = std::vector< std::atomic<id_t> >;
+        public:
+                /**
+                 * @brief Labelled run : voxels [start.x(), start.x() + length) of the row (start.y(), start.z()).
+                 */
+                struct Run {
+                        mi4::Point3i start;
+                        int length;
+                        id_t label;
+
+                        int getEnd ( void ) const
+                        {
+                                return this->start.x() + this->length - 1;
                         }
                 };
 
-                template <typename T>
-                class RunLengthObject
+                /**
+                 * @brief Forward range of labelled runs in z-y-x order.
+                 */
+                class RunRange
                 {
-                private:
-                        std::vector< RunLengthCodeBinary > _codes;
-                        std::vector<int> _idx; // y * z
                 public:
-                        RunLengthObject ( const VolumeData<T>& data )
+                        class const_iterator
                         {
-                                auto& codes = this->_codes;
-                                auto& idx   = this->_idx;
-                                const auto& size = data.getSize();
-                                idx.reserve ( size.y() * size.z() + 1 );
-
-                                for ( auto z = 0 ; z < size.z() ; ++z ) {
-                                        for ( auto y = 0 ; y < size.y() ; ++y ) {
-                                                idx.push_back ( static_cast<int> ( codes.size() ) );
-                                                auto start = 0;
-                                                auto value0 = data.at(start, y, z);
-                                                short int length = 1;
-
-                                                for ( auto x = 1 ; x < size.x() ; ++x ) {
-                                                        const auto value1 = data.at(x, y, z);
-
-                                                        if ( value0 == value1 ) {
-                                                                ++length;
-                                                        } else {
-                                                                if ( value0 != 0 ) {
-                                                                        codes.emplace_back ( RunLengthCodeBinary  ( mi4::Vector3s ( start, y, z ), length ) );
-                                                                }
-
-                                                                start = x;
-                                                                value0 = value1;
-                                                                length = 1;
-                                                        }
-                                                }
+                        public:
+                                using iterator_category = std::forward_iterator_tag;
+                                using value_type = Run;
+                                using difference_type = std::ptrdiff_t;
+                                using pointer = const Run*;
+                                using reference = Run;
+
+                                const_iterator ( const basic_ccl* owner, const size_t i, const size_t row ) : _owner ( owner ), _i ( i ), _row ( row )
+                                {
+                                        this->skip_rows();
+                                }
 
-                                                // if the run length does not stop, top
-                                                if ( value0 != 0 ) {
-                                                        codes.emplace_back ( RunLengthCodeBinary (  mi4::Vector3s ( start, y, z ), length ) );
-                                                }
+                                Run operator * ( void ) const
+                                {
+                                        const auto& rlo = this->_owner->_rlo;
+                                        const auto sy = static_cast<size_t> ( this->_owner->_size.y() );
+                                        const mi4::Point3i start ( rlo.getStart ( this->_i ), static_cast<int> ( this->_row % sy ), static_cast<int> ( this->_row / sy ) );
+                                        return Run { start, rlo.getLength ( this->_i ), this->_owner->_labels[this->_i] };
+                                }
+
+                                const_iterator& operator ++ ( void )
+                                {
+                                        ++this->_i;
+                                        this->skip_rows();
+                                        return *this;
+                                }
+
+                                const_iterator operator ++ ( int )
+                                {
+                                        const_iterator result = *this;
+                                        ++ ( *this );
+                                        return result;
+                                }
+
+                                bool operator == ( const const_iterator& that ) const
+                                {
+                                        return this->_i == that._i;
+                                }
+
+                                bool operator != ( const const_iterator& that ) const
+                                {
+                                        return this->_i != that._i;
+                                }
+                        private:
+                                void skip_rows ( void )
+                                {
+                                        const auto& idx = this->_owner->_rlo.index();
+                                        while ( this->_row + 2 < idx.size() && static_cast<size_t> ( idx[this->_row + 1] ) <= this->_i ) {
+                                                ++this->_row;
                                         }
                                 }
+                        private:
+                                const basic_ccl* _owner;
+                                size_t _i;
+                                size_t _row;
+                        };
 
-                                idx.push_back ( static_cast<int> ( codes.size() ) );
+                        RunRange ( const basic_ccl* owner, const size_t row0, const size_t row1 ) : _owner ( owner ), _row0 ( row0 ), _row1 ( row1 )
+                        {
                                 return;
                         }
 
-                        int num_label ( void ) const
+                        const_iterator begin ( void ) const
                         {
-                                return this->_idx.back();
+                                return const_iterator ( this->_owner, static_cast<size_t> ( this->_owner->_rlo.index() [this->_row0] ), this->_row0 );
                         }
 
-                        std::vector<RunLengthCodeBinary>& codes ( void )
+                        const_iterator end ( void ) const
                         {
-                                return this->_codes;
+                                return const_iterator ( this->_owner, static_cast<size_t> ( this->_owner->_rlo.index() [this->_row1] ), this->_row1 );
                         }
 
-                        std::vector<int>& index ( void )
+                        size_t size ( void ) const
                         {
-                                return this->_idx;
+                                const auto& idx = this->_owner->_rlo.index();
+                                return static_cast<size_t> ( idx[this->_row1] - idx[this->_row0] );
+                        }
+
+                        bool empty ( void ) const
+                        {
+                                return this->size() == 0;
                         }
+                private:
+                        const basic_ccl* _owner;
+                        size_t _row0;
+                        size_t _row1;
                 };
         private:
                 const mi4::Point3i _size;
-                RunLengthObject<char> _rlo;
+                RunLengthObject<Value> _rlo;
                 std::vector<id_t> _labels;
-                int _num_label;
+                std::vector<stats_type> _stats; ///< Statistics of each label. 0 is background.
+                bool _splitByValue;
         public:
-                ccl ( const mi4::VolumeData<char>& data ) : _size ( data.getSize() ), _rlo ( RunLengthObject<char> ( data ) )
+                /**
+                 * @param [in] data Input. Voxels of 0 are background.
+                 * @param [in] splitByValue Connect only voxels of the same value, so that each class of a multi-valued volume is labelled in one pass.
+                 */
+                basic_ccl ( const mi4::VolumeData<Value>& data, const bool splitByValue = false ) : _size ( data.getSize() ), _rlo ( RunLengthObject<Value> ( data ) ), _splitByValue ( splitByValue )
                 {
                         return;
                 }
-                ~ccl ( void ) = default;
-                ccl& label ( const bool isSorted = false, const bool joinXyz = true )
+                ~basic_ccl ( void ) = default;
+
+                /**
+                 * @brief Whether the runs of the volume fit in Coord and Index. Otherwise the volume is treated as empty.
+                 */
+                bool isValid ( void ) const
+                {
+                        return this->_rlo.isValid();
+                }
+
+                basic_ccl& label ( const bool isSorted = false, const bool joinXyz = true )
                 {
                         const auto& size = this->_size;
-                        auto& codes = this->_rlo.codes();
+                        const auto& rlo = this->_rlo;
+                        const auto numCodes = rlo.size();
+                        parent_type parents ( numCodes );
 
-                        // join in xy-plane
-                        for ( auto z = 0 ; z < size.z() ; ++z ) {
-                                for ( auto y = 0 ; y < size.y() - 1 ; ++y ) {
-                                        this->join_xy ( z, y );
+                        mi4::parallel_for ( 0, numCodes, [&parents] ( const size_t b, const size_t e ) {
+                                for ( auto i = b ; i < e ; ++i ) {
+                                        parents[i].store ( static_cast<id_t> ( i ), std::memory_order_relaxed );
                                 }
-                        }
+                        }, 1 << 16 );
+
+                        // join inside z-slabs, then across the slab boundaries.
+                        const int numSlices = std::max ( size.z(), 0 );
+                        const int slabSize = ( numSlices == 0 ) ? 1 : ( numSlices - 1 ) / static_cast<int> ( 4 * mi4::ThreadPool::getInstance().getNumThreads() ) + 1;
+                        const int numSlabs = ( numSlices + slabSize - 1 ) / slabSize;
+                        mi4::parallel_for ( 0, static_cast<size_t> ( numSlabs ), [this, &parents, joinXyz, slabSize, numSlices] ( const size_t b, const size_t e ) {
+                                for ( auto slab = static_cast<int> ( b ) ; slab < static_cast<int> ( e ) ; ++slab ) {
+                                        const int z0 = slab * slabSize;
+                                        const int z1 = std::min ( z0 + slabSize, numSlices );
+                                        for ( auto z = z0 ; z < z1 ; ++z ) {
+                                                for ( auto y = 0 ; y < this->_size.y() - 1 ; ++y ) {
+                                                        this->join_xy ( z, y, parents );
+                                                }
 
-                        if ( joinXyz ) {
-                                for ( auto z = 0 ; z < size.z() - 1 ; ++z ) {
-                                        this->join_xyz ( z );
+                                                if ( joinXyz && z + 1 < z1 ) {
+                                                        this->join_xyz ( z, parents );
+                                                }
+                                        }
                                 }
+                        } );
+
+                        if ( joinXyz ) {
+                                mi4::parallel_for ( 1, static_cast<size_t> ( numSlabs ), [this, &parents, slabSize] ( const size_t b, const size_t e ) {
+                                        for ( auto slab = static_cast<int> ( b ) ; slab < static_cast<int> ( e ) ; ++slab ) {
+                                                this->join_xyz ( slab * slabSize - 1, parents );
+                                        }
+                                } );
                         }
 
                         // now all connected components are recognized as "connected".
                         // reduce the number of labels.
-                        this->_labels.assign ( codes.size(), 0 );
-                        std::vector<int> voxelCount;
-                        voxelCount.push_back ( 0 ); // for background .
-                        int count = 1;
-
-                        for ( size_t i = 0 ; i < codes.size() ; ++i ) {
-                                const int parent = this->get_parent ( static_cast<int> ( i ) );
-
-                                if ( parent == static_cast<int> ( i ) ) {
-                                        this->_labels[i] = count;
-                                        voxelCount.push_back ( codes[i].getLength() );
-                                        ++count;
-                                } else {
-                                        const auto newLabel = this->_labels[ parent ];
-                                        this->_labels[i] = newLabel;
-                                        voxelCount [ newLabel ] += codes[i].getLength();
+                        this->_labels.resize ( numCodes );
+                        mi4::parallel_for ( 0, numCodes, [this, &parents] ( const size_t b, const size_t e ) {
+                                for ( auto i = b ; i < e ; ++i ) {
+                                        this->_labels[i] = basic_ccl::find_root ( parents, static_cast<id_t> ( i ) );
+                                }
+                        }, 1 << 14 );
+
+                        auto& stats = this->_stats;
+                        stats.assign ( 1, stats_type() ); // for background .
+                        id_t count = 1;
+
+                        const auto& idx = rlo.index();
+                        for ( size_t row = 0 ; row + 1 < idx.size() ; ++row ) {
+                                const auto y = static_cast<int> ( row % static_cast<size_t> ( size.y() ) );
+                                const auto z = static_cast<int> ( row / static_cast<size_t> ( size.y() ) );
+                                for ( auto i = static_cast<size_t> ( idx[row] ) ; i < static_cast<size_t> ( idx[row + 1] ) ; ++i ) {
+                                        // the root is the first run of the component, so it already has its label.
+                                        const auto root = this->_labels[i];
+
+                                        if ( root == static_cast<id_t> ( i ) ) {
+                                                this->_labels[i] = count;
+                                                stats.push_back ( stats_type() );
+                                                stats.back().setValue ( rlo.getValue ( i ) );
+                                                ++count;
+                                        } else {
+                                                this->_labels[i] = this->_labels[ static_cast<size_t> ( root ) ];
+                                        }
+                                        stats[static_cast<size_t> ( this->_labels[i] )].addRun ( rlo.getStart ( i ), y, z, rlo.getLength ( i ) );
                                 }
                         }
 
-                        // Sort labels by descend order
+                        // Sort labels by descend order of voxel count (ties by the original label).
                         if ( isSorted ) {
-                                std::vector<std::pair<int, id_t> > pairs;
-
-                                for ( size_t i = 0 ; i < voxelCount.size() ; ++i ) {
-                                        pairs.push_back ( std::make_pair ( - voxelCount[i], static_cast<id_t> ( i ) ) );
+                                std::vector<id_t> order ( stats.size() - 1 );
+                                for ( size_t i = 0 ; i < order.size() ; ++i ) {
+                                        order[i] = static_cast<id_t> ( i + 1 );
                                 }
+                                std::stable_sort ( order.begin(), order.end(), [&stats] ( const id_t a, const id_t b ) {
+                                        return stats[static_cast<size_t> ( a )].getCount() > stats[static_cast<size_t> ( b )].getCount();
+                                } );
+
+                                std::vector<id_t> newLabels ( stats.size(), 0 );
+                                std::vector<stats_type> sortedStats ( stats.size() );
+                                for ( size_t i = 0 ; i < order.size() ; ++i ) {
+                                        newLabels[static_cast<size_t> ( order[i] )] = static_cast<id_t> ( i + 1 );
+                                        sortedStats[i + 1] = stats[static_cast<size_t> ( order[i] )];
+                                }
+                                stats.swap ( sortedStats );
 
-                                std::sort ( pairs.begin() + 1, pairs.end() );
+                                mi4::parallel_for ( 0, numCodes, [this, &newLabels] ( const size_t b, const size_t e ) {
+                                        for ( auto i = b ; i < e ; ++i ) {
+                                                this->_labels[i] = newLabels[ static_cast<size_t> ( this->_labels[i] ) ];
+                                        }
+                                }, 1 << 14 );
+                        }
 
-                                for ( size_t i = 0 ; i < voxelCount.size() ; ++i ) {
-                                        pairs[i].first = pairs[i].second;
-                                        pairs[i].second = static_cast<id_t> ( i );
-                                }
+                        return *this;
 
-                                std::sort ( pairs.begin() + 1, pairs.end() );
+                }
+                /**
+                 * @brief Number of labels (components) after label().
+                 */
+                id_t getNumLabels ( void ) const
+                {
+                        return static_cast<id_t> ( this->_stats.size() ) - 1;
+                }
 
-                                for ( size_t i = 0 ; i < codes.size() ; ++i ) {
-                                        this->_labels[i] = pairs[ this->_labels[i] ].second;
-                                }
+                /**
+                 * @brief Voxel value of the component of the label (useful with splitByValue).
+                 */
+                Value getValue ( const id_t label ) const
+                {
+                        return this->_stats[static_cast<size_t> ( label )].getValue();
+                }
 
-                                voxelCount.clear();
-                                voxelCount.assign ( pairs.size(), 0 ) ;
+                /**
+                 * @brief Statistics indexed by label. The 0th element (background) is empty.
+                 */
+                const std::vector<stats_type>& getStats ( void ) const
+                {
+                        return this->_stats;
+                }
 
-                                for ( size_t i = 0 ; i < codes.size() ; ++i ) {
-                                        voxelCount [ this->_labels[i] ] += codes[i].getLength();
-                                }
+                const stats_type& getStats ( const id_t label ) const
+                {
+                        return this->_stats[static_cast<size_t> ( label )];
+                }
 
+                /**
+                 * @brief Binary volume of the components whose statistics satisfy pred (e.g. getCount() > k), written from runs.
+                 * @param [in] pred Function of const stats_type& returning bool.
+                 */
+                template <class Predicate>
+                VolumeData<char> getComponents ( const Predicate& pred )
+                {
+                        std::vector<char> isSelected ( this->_stats.size(), 0 );
+                        for ( size_t i = 1 ; i < this->_stats.size() ; ++i ) {
+                                isSelected[i] = pred ( this->_stats[i] ) ? 1 : 0;
                         }
 
-                        return *this;
+                        VolumeData<char> result ( mi4::VolumeInfo ( this->_size ) );
+                        this->for_each_code ( [this, &result, &isSelected] ( const size_t i, const int y, const int z ) {
+                                if ( isSelected[static_cast<size_t> ( this->_labels[i] )] ) {
+                                        this->set_label ( result, i, y, z, 1 );
+                                }
+                        } );
+                        return result;
+                }
 
+                /**
+                 * @brief Binary volume of the components of more than minCount voxels.
+                 */
+                VolumeData<char> getComponentsLargerThan ( const size_t minCount )
+                {
+                        return this->getComponents ( [minCount] ( const stats_type & s ) {
+                                return s.getCount() > minCount;
+                        } );
                 }
+
                 template <typename T>
                 VolumeData<T> getData ( void )
                 {
                         VolumeData<T> result ( mi4::VolumeInfo ( this->_size ) );
-                        auto& codes = this->_rlo.codes();
-
-                        for ( size_t i = 0 ; i < codes.size() ; ++i ) {
-                                this->set_label ( result, codes[i], this->_labels[i] );
-                        }
-
+                        this->for_each_code ( [this, &result] ( const size_t i, const int y, const int z ) {
+                                this->set_label ( result, i, y, z, this->_labels[i] );
+                        } );
                         return result;
                 }
 
                 VolumeData<char> getNthComponent ( const id_t n = 1 )
                 {
                         VolumeData<char> result ( mi4::VolumeInfo ( this->_size ) );
-                        auto& codes = this->_rlo.codes();
+                        this->for_each_code ( [this, &result, n] ( const size_t i, const int y, const int z ) {
+                                if ( n == this->_labels[i] ) {
+                                        this->set_label ( result, i, y, z, 1 );
+                                }
+                        } );
+                        return result;
+                }
 
-                        for ( size_t i = 0 ; i < codes.size() ; ++i ) {
+                VolumeData<char> getNotNthComponents ( const id_t n = 1 )
+                {
+                        VolumeData<char>  result ( mi4::VolumeInfo ( this->_size ) );
+                        this->for_each_code ( [this, &result, n] ( const size_t i, const int y, const int z ) {
                                 if ( n != this->_labels[i] ) {
-                                        continue;
+                                        this->set_label ( result, i, y, z, 1 );
                                 }
+                        } );
+                        return result;
+                }
 
-                                this->set_label ( result, codes[i], 1 );
-                        }
+                size_t getNumRuns ( void ) const
+                {
+                        return this->_rlo.size();
+                }
 
-                        return result;
+                /**
+                 * @brief Row index : runs of row (y, z) are [index[z * size.y() + y], index[z * size.y() + y + 1]) in getRuns().
+                 */
+                const std::vector<Index>& getRowIndex ( void ) const
+                {
+                        return this->_rlo.index();
                 }
 
-                VolumeData<char> getNotNthComponents ( const id_t n = 1 )
+                /**
+                 * @brief Labelled runs of the volume after label().
+                 */
+                RunRange getRuns ( void ) const
                 {
-                        VolumeData<char>  result ( mi4::VolumeInfo ( this->_size ) );
-                        auto& codes = this->_rlo.codes();
+                        return RunRange ( this, 0, this->get_num_rows() );
+                }
 
-                        for ( size_t i = 0 ; i < codes.size() ; ++i ) {
-                                if ( n == this->_labels[i] ) {
-                                        continue;
+                /**
+                 * @brief Labelled runs of the slice z.
+                 */
+                RunRange getRuns ( const int z ) const
+                {
+                        const auto sy = static_cast<size_t> ( this->_size.y() );
+                        return RunRange ( this, static_cast<size_t> ( z ) * sy, static_cast<size_t> ( z + 1 ) * sy );
+                }
+
+                /**
+                 * @brief Labelled runs of the row (y, z).
+                 */
+                RunRange getRuns ( const int y, const int z ) const
+                {
+                        const auto row = static_cast<size_t> ( z ) * static_cast<size_t> ( this->_size.y() ) + static_cast<size_t> ( y );
+                        return RunRange ( this, row, row + 1 );
+                }
+
+                /**
+                 * @brief Binary volume of the component of the label (all components if label is 0), written word by word from runs.
+                 */
+                BinaryVolume getBinaryVolume ( const id_t label = 0 ) const
+                {
+                        BinaryVolume result ( mi4::VolumeInfo ( this->_size ) );
+                        this->for_each_code ( [this, &result, label] ( const size_t i, const int y, const int z ) {
+                                if ( label == 0 || label == this->_labels[i] ) {
+                                        result.setRun ( this->_rlo.getStart ( i ), y, z, this->_rlo.getLength ( i ) );
                                 }
+                        } );
+                        return result;
+                }
 
-                                this->set_label ( result, codes[i], 1 );
+                /**
+                 * @brief Insert runs into the octree as labels. The octree is initialized to cover the volume.
+                 */
+                template <typename T>
+                void getOctree ( Octree<T>& octree ) const
+                {
+                        int dimension = 1;
+                        while ( dimension < this->_size.maxCoeff() ) {
+                                dimension *= 2;
                         }
+                        octree.init ( dimension, T() );
 
-                        return result;
+                        for ( const auto& run : this->getRuns() ) {
+                                const auto& p = run.start;
+                                octree.set ( p.x(), p.y(), p.z(), run.getEnd(), p.y(), p.z(), static_cast<T> ( run.label ) );
+                        }
                 }
         private:
+                size_t get_num_rows ( void ) const
+                {
+                        return this->_rlo.index().size() - 1;
+                }
+
+                /**
+                 * @brief Call fn(i, y, z) for all codes in parallel over z.
+                 */
+                template <class Function>
+                void for_each_code ( const Function& fn ) const
+                {
+                        const auto& idx = this->_rlo.index();
+                        const auto sy = static_cast<size_t> ( this->_size.y() );
+                        mi4::parallel_for ( 0, static_cast<size_t> ( this->_size.z() ), [&] ( const size_t b, const size_t e ) {
+                                for ( auto z = b ; z < e ; ++z ) {
+                                        for ( size_t y = 0 ; y < sy ; ++y ) {
+                                                const auto row = z * sy + y;
+                                                for ( auto i = static_cast<size_t> ( idx[row] ) ; i < static_cast<size_t> ( idx[row + 1] ) ; ++i ) {
+                                                        fn ( i, static_cast<int> ( y ), static_cast<int> ( z ) );
+                                                }
+                                        }
+                                }
+                        } );
+                }
+
                 template<typename T>
-                void set_label ( VolumeData<T>& labelData, RunLengthCodeBinary& code, const int label )
+                void set_label ( VolumeData<T>& labelData, const size_t i, const int y, const int z, const id_t label )
                 {
-                        const auto& start = code.getStart();
-                        const auto length = code.getLength();
+                        T* row = labelData.data ( y, z ) + this->_rlo.getStart ( i );
+                        std::fill ( row, row + this->_rlo.getLength ( i ), static_cast<T> ( label ) );
+                }
 
-                        for ( auto j = 0 ; j < length ; ++j ) {
-                                labelData.at(start.x() + j, start.y(), start.z()) = label;
-                        }
+                /**
+                 * @brief Slack of x-intervals of runs in neighbouring rows.
+                 * Runs touching diagonally (slack 1) are neighbours except in 6-connectivity and for yz-diagonal rows in 18-connectivity.
+                 */
+                static int get_slack ( const bool isDiagonal )
+                {
+                        return ( Connectivity == 26 || ( Connectivity == 18 && !isDiagonal ) ) ? 1 : 0;
                 }
 
-                void join_xyz ( const int z )
+                void join_xyz ( const int z, parent_type& parents )
                 {
-                        const auto& idx = this->_rlo.index();
                         const auto& size = this->_size;
-                        const auto id0 =  z * size.y() ;
-                        const auto id1 =  ( z + 1 ) * size.y() ;
+                        const auto id0 =  static_cast<size_t> ( z ) * static_cast<size_t> ( size.y() ) ;
+                        const auto id1 =  id0 + static_cast<size_t> ( size.y() ) ;
 
                         for ( auto i = 0 ; i < size.y() ; ++i ) {
                                 for ( auto j =  -1 ;  j <= 1 ; ++j ) {
+                                        // rows differing in both y and z are not neighbours in 6-connectivity.
+                                        if ( Connectivity == 6 && j != 0 ) {
+                                                continue;
+                                        }
+
                                         if ( i + j < 0 ) {
                                                 continue;
                                         }
@@ -303,71 +634,79 @@ namespace mi4
                                                 continue;
                                         }
 
-                                        for ( auto k = idx [ id0 + i ] ; k < idx[id0 + i + 1] ; ++k ) {
-                                                for ( auto l = idx [ id1 + i + j ] ; l < idx[id1 + i + j + 1] ; ++l ) {
-                                                        this->connect ( k, l );
-                                                }
-                                        }
+                                        this->join_rows ( id0 + static_cast<size_t> ( i ), id1 + static_cast<size_t> ( i + j ), basic_ccl::get_slack ( j != 0 ), parents );
                                 }
                         }
                 }
-                void join_xy ( const int z, const int y )
+                void join_xy ( const int z, const int y, parent_type& parents )
+                {
+                        const auto  id0 =  static_cast<size_t> ( z ) * static_cast<size_t> ( this->_size.y() ) + static_cast<size_t> ( y ) ;
+                        this->join_rows ( id0, id0 + 1, basic_ccl::get_slack ( false ), parents );
+                }
+
+                /**
+                 * @brief Connect runs of two rows. Runs are sorted by x, so the neighbours of each run are found by a sweep.
+                 */
+                void join_rows ( const size_t row0, const size_t row1, const int slack, parent_type& parents )
                 {
                         const auto& idx = this->_rlo.index();
-                        const auto& size = this->_size;
-                        const auto  id0 =  z * size.y() + y ;
+                        const auto& rlo = this->_rlo;
+                        auto first = static_cast<size_t> ( idx[row1] );
+                        const auto last = static_cast<size_t> ( idx[row1 + 1] );
+
+                        for ( auto i = static_cast<size_t> ( idx[row0] ) ; i < static_cast<size_t> ( idx[row0 + 1] ) ; ++i ) {
+                                const auto start = rlo.getStart ( i );
+                                const auto end = rlo.getEnd ( i );
+                                while ( first < last && rlo.getEnd ( first ) < start - slack ) {
+                                        ++first;
+                                }
 
-                        for ( auto i = idx[ id0 ] ; i < idx[id0 + 1] ; ++i ) {
-                                for ( auto j = idx[id0 + 1] ; j < idx[id0 + 2] ; ++j ) {
-                                        this->connect ( i, j );
+                                // [start, end] and [start1, end1] overlap (or touch diagonally if slack is 1).
+                                for ( auto j = first ; j < last && rlo.getStart ( j ) - slack <= end ; ++j ) {
+                                        if ( !this->_splitByValue || rlo.getValue ( i ) == rlo.getValue ( j ) ) {
+                                                basic_ccl::unite ( parents, static_cast<id_t> ( i ), static_cast<id_t> ( j ) );
+                                        }
                                 }
                         }
                 }
-                int get_parent ( const id_t id )
-                {
-                        const auto parent = this->_rlo.codes()[id].getParent();
-                        return ( parent == -1 ) ? id : this->get_parent ( parent );
-                }
 
-                // p: parent , c : child
-                void set_parent ( const id_t p, const id_t c )
+                static id_t find_root ( parent_type& parents, id_t id )
                 {
-                        this->_rlo.codes().at ( c ).setParent ( p );
-                        this->_num_label -= 1;
+                        while ( true ) {
+                                auto parent = parents[static_cast<size_t> ( id )].load();
+                                if ( parent == id ) {
+                                        return id;
+                                }
+                                // path halving. parents only decrease, so a failed CAS is harmless.
+                                const auto grandParent = parents[static_cast<size_t> ( parent )].load();
+                                if ( grandParent != parent ) {
+                                        parents[static_cast<size_t> ( id )].compare_exchange_weak ( parent, grandParent );
+                                }
+                                id = grandParent;
+                        }
                 }
 
-                void connect ( const id_t i, const id_t j )
+                static void unite ( parent_type& parents, id_t i, id_t j )
                 {
-                        auto& codes = this->_rlo.codes();
-
-                        if ( codes[i].isConnected ( codes[j] ) ) {
-                                const auto p0 = this->get_parent ( i );
-                                const auto p1 = this->get_parent ( j );
-
-                                // both parent
-                                if ( p0 == -1 && p1 == -1 ) {
-                                        if ( i < j ) {
-                                                this->set_parent ( i, j );
-                                        } else {
-                                                this->set_parent ( j, i );
-                                        }
+                        while ( true ) {
+                                i = basic_ccl::find_root ( parents, i );
+                                j = basic_ccl::find_root ( parents, j );
+
+                                if ( i == j ) {
+                                        return;
+                                } else if ( i > j ) {
+                                        std::swap ( i, j );
                                 }
-                                // both child : select lower
-                                else if ( p0 != -1 && p1 != -1 )  {
-                                        if      ( p0 < p1 ) {
-                                                this->set_parent ( p0, p1 );
-                                        } else if ( p0 > p1 ) {
-                                                this->set_parent ( p1, p0 );
-                                        }
-                                } else {
-                                        if      ( p0 == -1 ) {
-                                                this->set_parent ( p1, i );
-                                        } else if ( p1 == -1 ) {
-                                                this->set_parent ( p0, j );
-                                        }
+
+                                // link the larger root under the smaller one unless another thread has moved it.
+                                auto expected = j;
+                                if ( parents[static_cast<size_t> ( j )].compare_exchange_strong ( expected, i ) ) {
+                                        return;
                                 }
                         }
                 }
         };
+
+        using ccl = basic_ccl<26>;
 }
 #endif //MI4_CONNECTED_COMPONENT_LABELLER_RLE_HPP
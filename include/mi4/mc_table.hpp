@@ -13,7 +13,7 @@
  * Vertex indices to compute edge points.
  * Edge point i exists between vertices (2*i), (2*i+1)
  */
-static int mc_edtable[] = {
+constexpr int mc_edtable[] = {
         0, 1, 1, 3, 3, 2, 2, 0,
         4, 5, 5, 7, 7, 6, 6, 4,
         0, 4, 1, 5, 2, 6, 3, 7
@@ -22,7 +22,7 @@ static int mc_edtable[] = {
  * Start point of vertex sequence for triangluation of table i.
  */
 
-static int mc_colidx[] = {
+constexpr int mc_colidx[] = {
         0, 0, 3, 6, 12, 15, 21, 33, 42, 45,
         57, 63, 72, 78, 87, 96, 102, 105, 111, 123,
         132, 144, 153, 168, 180, 198, 213, 228, 240, 255,
@@ -50,7 +50,7 @@ static int mc_colidx[] = {
         2418, 2424, 2433, 2442, 2448, 2457, 2463, 2469, 2472, 2481,
         2487, 2493, 2496, 2502, 2505, 2508, 2508
 };
-static int mc_idxtable[] = {
+constexpr int mc_idxtable[] = {
         /*0(00000000)*/
         /*1(10000000)*/ 0, 3, 8,
         /*2(01000000)*/ 1, 0, 9,
@@ -308,5 +308,6 @@ static int mc_idxtable[] = {
         /*254(01111111)*/ 0, 8, 3
         /*255(11111111)*/
 };
+static_assert ( sizeof ( mc_colidx ) / sizeof ( int ) == 257 && mc_colidx[256] == sizeof ( mc_idxtable ) / sizeof ( int ), "inconsistent marching cubes tables" );
 #endif // MC_TABLE_HPP
 
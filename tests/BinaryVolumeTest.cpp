@@ -0,0 +1,108 @@
+#include "mi4/Test.hpp"
+#include "mi4/BinaryVolume.hpp"
+#include "mi4/VolumeDataUtility.hpp"
+
+class BinaryVolumeTest : public mi4::TestCase
+{
+public:
+        explicit BinaryVolumeTest ( void  ) : mi4::TestCase ( "binary_volume_test" )
+        {
+                return;
+        }
+
+        void init ( void )
+        {
+                this->add ( BinaryVolumeTest::test_conversion ) ;
+                this->add ( BinaryVolumeTest::test_operators ) ;
+                this->add ( BinaryVolumeTest::test_shift ) ;
+                this->add ( BinaryVolumeTest::test_utility ) ;
+                return ;
+        }
+
+        static mi4::VolumeData<char> create_mask ( const mi4::VolumeInfo& info, const int seed )
+        {
+                mi4::VolumeData<char> mask ( info );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        mask.set ( p, static_cast<char> ( ( p.x() * 131 + p.y() * 71 + p.z() * 29 + seed ) % 7 < 3 ) );
+                }
+                return mask;
+        }
+
+        static void test_conversion ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 130, 5, 3 ) );
+                const auto mask = create_mask ( info, 0 );
+                const mi4::BinaryVolume binary ( mask );
+                ASSERT_EQUALS ( 3, binary.getWordsPerRow() );
+
+                size_t count = 0;
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        ASSERT_EQUALS ( mask.get ( p ) != 0, binary.get ( p ) );
+                        count += static_cast<size_t> ( mask.get ( p ) );
+                }
+                ASSERT_EQUALS ( count, binary.count() );
+
+                const auto back = binary.toVolumeData();
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        ASSERT_EQUALS ( mask.get ( p ), back.get ( p ) );
+                }
+                return ;
+        }
+
+        static void test_operators ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 70, 4, 3 ) );
+                const mi4::BinaryVolume a ( create_mask ( info, 0 ) );
+                const mi4::BinaryVolume b ( create_mask ( info, 3 ) );
+                const auto c = a & b;
+                const auto d = a | b;
+                const auto e = a ^ b;
+                const auto f = ~a;
+
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        ASSERT_EQUALS ( a.get ( p ) && b.get ( p ), c.get ( p ) );
+                        ASSERT_EQUALS ( a.get ( p ) || b.get ( p ), d.get ( p ) );
+                        ASSERT_EQUALS ( a.get ( p ) != b.get ( p ), e.get ( p ) );
+                        ASSERT_EQUALS ( !a.get ( p ), f.get ( p ) );
+                }
+                ASSERT_EQUALS ( static_cast<size_t> ( 70 * 4 * 3 ), a.count() + f.count() );
+                return ;
+        }
+
+        static void test_shift ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 150, 5, 4 ) );
+                const mi4::BinaryVolume a ( create_mask ( info, 1 ) );
+
+                for ( const auto& d : { mi4::Point3i ( 1, 0, 0 ), mi4::Point3i ( -1, 1, 0 ), mi4::Point3i ( 65, 0, -1 ), mi4::Point3i ( -70, -2, 1 ), mi4::Point3i ( 64, 0, 0 ) } ) {
+                        const auto b = a.shift ( d );
+                        for ( const auto& p : mi4::Range ( info ) ) {
+                                const mi4::Point3i q = p - d;
+                                ASSERT_EQUALS ( info.isValid ( q ) && a.get ( q ), b.get ( p ) );
+                        }
+                }
+                return ;
+        }
+
+        static void test_utility ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 67, 9, 8 ) );
+                const auto mask0 = create_mask ( info, 2 );
+                const auto mask1 = create_mask ( info, 5 );
+
+                const auto boundary0 = mi4::VolumeDataUtility::extractBoundaryVoxels ( mask0 );
+                const auto boundary1 = mi4::VolumeDataUtility::extractBoundaryVoxels ( mi4::BinaryVolume ( mask0 ) );
+                const auto diff0 = mi4::VolumeDataUtility::diff ( mask0, mask1 );
+                const auto diff1 = mi4::VolumeDataUtility::diff ( mi4::BinaryVolume ( mask0 ), mi4::BinaryVolume ( mask1 ) );
+                const auto negate0 = mi4::VolumeDataUtility::negate_binary ( mask0 );
+                const auto negate1 = mi4::VolumeDataUtility::negate_binary ( mi4::BinaryVolume ( mask0 ) );
+
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        ASSERT_EQUALS ( boundary0.get ( p ) != 0, boundary1.get ( p ) );
+                        ASSERT_EQUALS ( diff0.get ( p ) != 0, diff1.get ( p ) );
+                        ASSERT_EQUALS ( negate0.get ( p ) != 0, negate1.get ( p ) );
+                }
+                return ;
+        }
+};
+static BinaryVolumeTest test;
@@ -0,0 +1,148 @@
+#include "mi4/Test.hpp"
+#include "mi4/BrickedVolumeData.hpp"
+#include <cstdio>
+#include <fstream>
+#if defined ( __unix__ ) || defined ( __APPLE__ )
+#include <csignal>
+#include <sys/resource.h>
+#endif
+
+class BrickedVolumeDataTest : public mi4::TestCase
+{
+public:
+        explicit BrickedVolumeDataTest ( void  ) : mi4::TestCase ( "bricked_volume_data_test" )
+        {
+                return;
+        }
+
+        void init ( void )
+        {
+                this->add ( BrickedVolumeDataTest::test_in_memory ) ;
+                this->add ( BrickedVolumeDataTest::test_paging ) ;
+                this->add ( BrickedVolumeDataTest::test_existing_backing_file ) ;
+                this->add ( BrickedVolumeDataTest::test_page_out_failure ) ;
+                this->add ( BrickedVolumeDataTest::test_move_assignment ) ;
+                return ;
+        }
+
+        static void test_in_memory ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 20, 17, 9 ) );
+                mi4::BrickedVolumeData<int, 8> data ( info );
+                ASSERT_EQUALS ( static_cast<size_t> ( 3 * 3 * 2 ), data.getNumBricks() );
+
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        data.set ( p, static_cast<int> ( info.toIndex ( p ) ) );
+                }
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        ASSERT_EQUALS ( static_cast<int> ( info.toIndex ( p ) ), data.get ( p ) );
+                }
+                const auto volume = data.toVolumeData();
+                ASSERT_EQUALS ( 123, volume.get ( info.fromIndex ( 123 ) ) );
+                return ;
+        }
+
+        static void test_paging ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 33, 30, 17 ) );
+                mi4::VolumeData<short> source ( info );
+
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        source.set ( p, static_cast<short> ( p.x() + p.y() * 3 - p.z() ) );
+                }
+
+                mi4::BrickedVolumeData<short, 8> data ( info, 4, "bricked_volume_data_test.bin" );
+                ASSERT_EQUALS ( static_cast<size_t> ( 4 ), data.getCapacity() );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( data.fromVolumeData ( source ) ) );
+                ASSERT_EQUALS ( static_cast<size_t> ( 4 ), data.getNumResidentBricks() );
+
+                // scanline order touches many bricks and forces paging.
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        ASSERT_EQUALS ( source.get ( p ), data.get ( p ) );
+                }
+                data.set ( mi4::Point3i ( 32, 29, 16 ), 1000 );
+                data.set ( mi4::Point3i ( 0, 0, 0 ), -1000 );
+                ASSERT_EQUALS ( static_cast<short> ( 1000 ), data.get ( mi4::Point3i ( 32, 29, 16 ) ) );
+                ASSERT_EQUALS ( static_cast<short> ( -1000 ), data.get ( mi4::Point3i ( 0, 0, 0 ) ) );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( data.flush() ) );
+                return ;
+        }
+
+        static void test_existing_backing_file ( void )
+        {
+                const std::string filename ( "bricked_volume_data_test_existing.bin" );
+                {
+                        std::ofstream fout ( filename.c_str() );
+                        fout << "keep";
+                }
+                {
+                        // refused. all bricks stay in memory.
+                        mi4::BrickedVolumeData<short, 8> data ( mi4::VolumeInfo ( mi4::Point3i ( 20, 20, 20 ) ), 2, filename );
+                        ASSERT_EQUALS ( data.getNumBricks(), data.getCapacity() );
+                }
+                std::ifstream fin ( filename.c_str() );
+                std::string str;
+                fin >> str;
+                ASSERT_EQUALS ( std::string ( "keep" ), str );
+                fin.close();
+                std::remove ( filename.c_str() );
+                return ;
+        }
+
+        static void test_page_out_failure ( void )
+        {
+#if defined ( __unix__ ) || defined ( __APPLE__ )
+                // 160 bricks of 8 KiB. bricks beyond 1 MiB cannot be written.
+                const mi4::VolumeInfo info ( mi4::Point3i ( 16, 16, 16 * 160 ) );
+                mi4::BrickedVolumeData<short, 16> data ( info, 2, "bricked_volume_data_test_failure.bin" );
+
+                struct rlimit limit;
+                getrlimit ( RLIMIT_FSIZE, &limit );
+                const struct rlimit oldLimit = limit;
+                limit.rlim_cur = 1024 * 1024;
+                const auto oldHandler = std::signal ( SIGXFSZ, SIG_IGN );
+                setrlimit ( RLIMIT_FSIZE, &limit );
+                for ( int i = 0 ; i < 160 ; ++i ) {
+                        data.set ( mi4::Point3i ( 0, 0, 16 * i ), static_cast<short> ( i + 1 ) );
+                }
+                setrlimit ( RLIMIT_FSIZE, &oldLimit );
+                std::signal ( SIGXFSZ, oldHandler );
+
+                // the bricks that could not be written are kept in memory.
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( data.hasPagingError() ) );
+                ASSERT_EQUALS ( true, data.getCapacity() < data.getNumResidentBricks() );
+                for ( int i = 0 ; i < 160 ; ++i ) {
+                        ASSERT_EQUALS ( static_cast<short> ( i + 1 ), data.get ( mi4::Point3i ( 0, 0, 16 * i ) ) );
+                }
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( data.flush() ) );
+#endif
+                return ;
+        }
+
+        static bool exists ( const std::string& filename )
+        {
+                return std::ifstream ( filename.c_str() ).is_open();
+        }
+
+        static void test_move_assignment ( void )
+        {
+                const std::string file0 ( "bricked_volume_data_test_move0.bin" );
+                const std::string file1 ( "bricked_volume_data_test_move1.bin" );
+                const mi4::VolumeInfo info ( mi4::Point3i ( 20, 20, 20 ) );
+                {
+                        mi4::BrickedVolumeData<short, 8> data0 ( info, 2, file0 );
+                        mi4::BrickedVolumeData<short, 8> data1 ( info, 2, file1 );
+                        data1.set ( mi4::Point3i ( 19, 19, 19 ), 7 );
+                        ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( exists ( file0 ) ) );
+
+                        data0 = std::move ( data1 );
+                        ASSERT_EQUALS ( static_cast<int> ( false ), static_cast<int> ( exists ( file0 ) ) );
+                        ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( exists ( file1 ) ) );
+                        ASSERT_EQUALS ( static_cast<short> ( 7 ), data0.get ( mi4::Point3i ( 19, 19, 19 ) ) );
+                        ASSERT_EQUALS ( static_cast<short> ( 0 ), data0.get ( mi4::Point3i ( 0, 0, 0 ) ) );
+                }
+                ASSERT_EQUALS ( static_cast<int> ( false ), static_cast<int> ( exists ( file1 ) ) );
+                return ;
+        }
+};
+static BrickedVolumeDataTest test;
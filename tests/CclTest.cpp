@@ -0,0 +1,305 @@
+#include "mi4/Test.hpp"
+#include "mi4/ccl.hpp"
+#include <deque>
+#include <random>
+
+class CclTest : public mi4::TestCase
+{
+public:
+        explicit CclTest ( void  ) : mi4::TestCase ( "ccl_test" )
+        {
+                return;
+        }
+
+        void init ( void )
+        {
+                this->add ( CclTest::test_label ) ;
+                this->add ( CclTest::test_sorted ) ;
+                this->add ( CclTest::test_components ) ;
+                this->add ( CclTest::test_connectivity ) ;
+                this->add ( CclTest::test_split_by_value ) ;
+                this->add ( CclTest::test_split_by_short_value ) ;
+                this->add ( CclTest::test_wide ) ;
+                this->add ( CclTest::test_stats ) ;
+                this->add ( CclTest::test_runs ) ;
+                return ;
+        }
+
+        static mi4::VolumeData<char> create_volume ( const mi4::Point3i& size, const double density, const unsigned int seed, const int numValues = 1 )
+        {
+                const mi4::VolumeInfo info ( size );
+                mi4::VolumeData<char> volume ( info );
+                std::mt19937 gen ( seed );
+                std::uniform_real_distribution<> dis ( 0, 1 );
+                for ( const auto& p : mi4::Range ( volume.getInfo() ) ) {
+                        const double r = dis ( gen );
+                        volume.set ( p, static_cast<char> ( r < density ? 1 + static_cast<int> ( r / density * numValues ) : 0 ) );
+                }
+                return volume;
+        }
+
+        /**
+         * Flood fill in z-y-x scan order (the order of the first voxel of each component).
+         */
+        template <typename T>
+        static mi4::VolumeData<int> reference ( const mi4::VolumeData<T>& volume, const bool joinXyz, std::vector<int>& counts, const int connectivity = 26, const bool splitByValue = false )
+        {
+                // number of non-zero offsets of neighbours.
+                const int maxOffsets = ( connectivity == 6 ) ? 1 : ( connectivity == 18 ) ? 2 : 3;
+                const auto& info = volume.getInfo();
+                mi4::VolumeData<int> label ( info );
+                const int dz = joinXyz ? 1 : 0;
+                counts.assign ( 1, 0 );
+
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        if ( volume.get ( p ) == 0 || label.get ( p ) != 0 ) {
+                                continue;
+                        }
+                        const int id = static_cast<int> ( counts.size() );
+                        counts.push_back ( 0 );
+                        std::deque<mi4::Point3i> queue ( 1, p );
+                        label.set ( p, id );
+                        while ( !queue.empty() ) {
+                                const mi4::Point3i q = queue.front();
+                                queue.pop_front();
+                                counts[id] += 1;
+                                for ( const auto& d : mi4::Range ( mi4::Point3i ( -1, -1, -dz ), mi4::Point3i ( 1, 1, dz ) ) ) {
+                                        const mi4::Point3i r = q + d;
+                                        if ( ( d.array() != 0 ).count() > maxOffsets || !info.isValid ( r ) ) {
+                                                continue;
+                                        }
+                                        if ( splitByValue && volume.get ( r ) != volume.get ( q ) ) {
+                                                continue;
+                                        }
+                                        if ( volume.get ( r ) != 0 && label.get ( r ) == 0 ) {
+                                                label.set ( r, id );
+                                                queue.push_back ( r );
+                                        }
+                                }
+                        }
+                }
+                return label;
+        }
+
+        static void test_label ( void )
+        {
+                for ( const bool joinXyz : {true, false} ) {
+                        const auto volume = create_volume ( mi4::Point3i ( 45, 31, 37 ), 0.3, 1 );
+                        std::vector<int> counts;
+                        const auto expected = reference ( volume, joinXyz, counts );
+                        const auto result = mi4::ccl ( volume ).label ( false, joinXyz ).getData<int>();
+                        for ( const auto& p : mi4::Range ( volume.getInfo() ) ) {
+                                ASSERT_EQUALS ( expected.get ( p ), result.get ( p ) );
+                        }
+                }
+                return ;
+        }
+
+        static void test_sorted ( void )
+        {
+                const auto volume = create_volume ( mi4::Point3i ( 40, 40, 40 ), 0.25, 2 );
+                std::vector<int> counts;
+                const auto expected = reference ( volume, true, counts );
+
+                // descending voxel count, ties by the original label.
+                std::vector<int> order ( counts.size() - 1 );
+                for ( size_t i = 0 ; i < order.size() ; ++i ) {
+                        order[i] = static_cast<int> ( i ) + 1;
+                }
+                std::stable_sort ( order.begin(), order.end(), [&counts] ( const int a, const int b ) {
+                        return counts[a] > counts[b];
+                } );
+                std::vector<int> sorted ( counts.size(), 0 );
+                for ( size_t i = 0 ; i < order.size() ; ++i ) {
+                        sorted[order[i]] = static_cast<int> ( i ) + 1;
+                }
+
+                const auto result = mi4::ccl ( volume ).label ( true ).getData<int>();
+                for ( const auto& p : mi4::Range ( volume.getInfo() ) ) {
+                        ASSERT_EQUALS ( sorted[expected.get ( p )], result.get ( p ) );
+                }
+                return ;
+        }
+
+        static void test_components ( void )
+        {
+                const auto volume = create_volume ( mi4::Point3i ( 20, 24, 18 ), 0.35, 3 );
+                mi4::ccl labeller ( volume );
+                labeller.label ( true );
+                const auto label = labeller.getData<short>();
+                const auto first = labeller.getNthComponent ( 1 );
+                const auto others = labeller.getNotNthComponents ( 1 );
+                for ( const auto& p : mi4::Range ( volume.getInfo() ) ) {
+                        ASSERT_EQUALS ( static_cast<char> ( label.get ( p ) == 1 ), first.get ( p ) );
+                        ASSERT_EQUALS ( static_cast<char> ( label.get ( p ) > 1 ), others.get ( p ) );
+                }
+                return ;
+        }
+
+        template <int Connectivity>
+        static void check_connectivity ( const mi4::VolumeData<char>& volume, const bool splitByValue )
+        {
+                std::vector<int> counts;
+                const auto expected = reference ( volume, true, counts, Connectivity, splitByValue );
+                mi4::basic_ccl<Connectivity> labeller ( volume, splitByValue );
+                const auto result = labeller.label().template getData<int>();
+                ASSERT_EQUALS ( static_cast<int> ( counts.size() ) - 1, labeller.getNumLabels() );
+                for ( const auto& p : mi4::Range ( volume.getInfo() ) ) {
+                        ASSERT_EQUALS ( expected.get ( p ), result.get ( p ) );
+                        ASSERT_EQUALS ( volume.get ( p ), labeller.getValue ( result.get ( p ) ) );
+                }
+        }
+
+        static void test_connectivity ( void )
+        {
+                const auto volume = create_volume ( mi4::Point3i ( 33, 29, 31 ), 0.4, 4 );
+                check_connectivity<6> ( volume, false );
+                check_connectivity<18> ( volume, false );
+                check_connectivity<26> ( volume, false );
+                return ;
+        }
+
+        static void test_split_by_value ( void )
+        {
+                const auto volume = create_volume ( mi4::Point3i ( 31, 27, 35 ), 0.7, 5, 3 );
+                check_connectivity<6> ( volume, true );
+                check_connectivity<18> ( volume, true );
+                check_connectivity<26> ( volume, true );
+
+                // without splitting, touching runs of different values are one component.
+                std::vector<int> counts;
+                const auto expected = reference ( volume, true, counts );
+                const auto result = mi4::ccl ( volume ).label().getData<int>();
+                for ( const auto& p : mi4::Range ( volume.getInfo() ) ) {
+                        ASSERT_EQUALS ( expected.get ( p ), result.get ( p ) );
+                }
+                return ;
+        }
+
+        static void test_split_by_short_value ( void )
+        {
+                // classes 44 - 45 and 300 - 301 alternate every 4 voxels along x, so they would collide if cast to char.
+                const mi4::VolumeInfo info ( mi4::Point3i ( 29, 23, 25 ) );
+                mi4::VolumeData<short> volume ( info );
+                std::mt19937 gen ( 9 );
+                std::uniform_real_distribution<> dis ( 0, 1 );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        const int value = ( ( p.x() / 4 ) % 2 ) * 256 + 44 + ( p.z() / 5 ) % 2;
+                        volume.set ( p, static_cast<short> ( dis ( gen ) < 0.8 ? value : 0 ) );
+                }
+
+                std::vector<int> counts;
+                const auto expected = reference ( volume, true, counts, 26, true );
+                mi4::basic_ccl<26, short, int, short> labeller ( volume, true );
+                const auto result = labeller.label().getData<int>();
+                ASSERT_EQUALS ( static_cast<int> ( counts.size() ) - 1, labeller.getNumLabels() );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        ASSERT_EQUALS ( expected.get ( p ), result.get ( p ) );
+                        ASSERT_EQUALS ( volume.get ( p ), labeller.getValue ( result.get ( p ) ) );
+                        ASSERT_EQUALS ( volume.get ( p ), labeller.getStats ( result.get ( p ) ).getValue() );
+                }
+                return ;
+        }
+
+        static void test_wide ( void )
+        {
+                // wider than 16-bit run codes.
+                const auto volume = create_volume ( mi4::Point3i ( 40000, 3, 2 ), 0.5, 6 );
+                std::vector<int> counts;
+                const auto expected = reference ( volume, true, counts );
+
+                mi4::basic_ccl<26, int, long long> labeller ( volume );
+                ASSERT_EQUALS ( true, labeller.isValid() );
+                const auto result = labeller.label().getData<int>();
+                ASSERT_EQUALS ( static_cast<long long> ( counts.size() ) - 1, labeller.getNumLabels() );
+                for ( const auto& p : mi4::Range ( volume.getInfo() ) ) {
+                        ASSERT_EQUALS ( expected.get ( p ), result.get ( p ) );
+                }
+
+                ASSERT_EQUALS ( false, mi4::ccl ( volume ).isValid() );
+                return ;
+        }
+
+        static void test_stats ( void )
+        {
+                const auto volume = create_volume ( mi4::Point3i ( 26, 22, 19 ), 0.3, 7 );
+                std::vector<int> counts;
+                const auto expected = reference ( volume, true, counts );
+
+                std::vector<mi4::ComponentStats<>> stats ( counts.size() );
+                for ( const auto& p : mi4::Range ( volume.getInfo() ) ) {
+                        stats[expected.get ( p )].addRun ( p.x(), p.y(), p.z(), 1 );
+                }
+
+                mi4::ccl labeller ( volume );
+                labeller.label();
+                ASSERT_EQUALS ( stats.size(), labeller.getStats().size() );
+                for ( size_t i = 1 ; i < stats.size() ; ++i ) {
+                        const auto& s = labeller.getStats ( static_cast<int> ( i ) );
+                        ASSERT_EQUALS ( static_cast<size_t> ( counts[i] ), s.getCount() );
+                        ASSERT_EQUALS ( stats[i].getMin(), s.getMin() );
+                        ASSERT_EQUALS ( stats[i].getMax(), s.getMax() );
+                        ASSERT_EQUALS ( true, ( stats[i].getCentroid() - s.getCentroid() ).norm() < 1.0e-9 );
+                        ASSERT_EQUALS ( true, ( stats[i].getSecondMoments() - s.getSecondMoments() ).norm() < 1.0e-6 );
+                }
+
+                const size_t minCount = 3;
+                const auto large = labeller.getComponentsLargerThan ( minCount );
+                for ( const auto& p : mi4::Range ( volume.getInfo() ) ) {
+                        ASSERT_EQUALS ( static_cast<char> ( counts[expected.get ( p )] > static_cast<int> ( minCount ) && expected.get ( p ) != 0 ), large.get ( p ) );
+                }
+                return ;
+        }
+
+        static void test_runs ( void )
+        {
+                const auto volume = create_volume ( mi4::Point3i ( 70, 13, 11 ), 0.6, 8 );
+                mi4::ccl labeller ( volume );
+                const auto label = labeller.label ( true ).getData<int>();
+
+                // runs reproduce the label volume.
+                mi4::VolumeData<int> result ( volume.getInfo() );
+                size_t numRuns = 0;
+                for ( const auto& run : labeller.getRuns() ) {
+                        for ( int x = run.start.x() ; x <= run.getEnd() ; ++x ) {
+                                ASSERT_EQUALS ( 0, result.at ( x, run.start.y(), run.start.z() ) );
+                                result.at ( x, run.start.y(), run.start.z() ) = run.label;
+                        }
+                        ++numRuns;
+                }
+                ASSERT_EQUALS ( labeller.getNumRuns(), numRuns );
+                for ( const auto& p : mi4::Range ( volume.getInfo() ) ) {
+                        ASSERT_EQUALS ( label.get ( p ), result.get ( p ) );
+                }
+
+                // row and slice ranges agree with the row index.
+                const auto& idx = labeller.getRowIndex();
+                for ( int z = 0 ; z < volume.getSize().z() ; ++z ) {
+                        size_t sliceRuns = 0;
+                        for ( int y = 0 ; y < volume.getSize().y() ; ++y ) {
+                                const auto row = labeller.getRuns ( y, z );
+                                const auto id = static_cast<size_t> ( z * volume.getSize().y() + y );
+                                ASSERT_EQUALS ( static_cast<size_t> ( idx[id + 1] - idx[id] ), row.size() );
+                                for ( const auto& run : row ) {
+                                        ASSERT_EQUALS ( y, run.start.y() );
+                                        ASSERT_EQUALS ( z, run.start.z() );
+                                }
+                                sliceRuns += row.size();
+                        }
+                        ASSERT_EQUALS ( sliceRuns, labeller.getRuns ( z ).size() );
+                }
+
+                const auto all = labeller.getBinaryVolume();
+                const auto first = labeller.getBinaryVolume ( 1 );
+                mi4::Octree<int> octree;
+                labeller.getOctree ( octree );
+                for ( const auto& p : mi4::Range ( volume.getInfo() ) ) {
+                        ASSERT_EQUALS ( label.get ( p ) != 0, all.get ( p ) );
+                        ASSERT_EQUALS ( label.get ( p ) == 1, first.get ( p ) );
+                        ASSERT_EQUALS ( label.get ( p ), octree.get ( p.x(), p.y(), p.z() ) );
+                }
+                return ;
+        }
+};
+
+static CclTest test;
@@ -0,0 +1,186 @@
+#include "mi4/Test.hpp"
+#include "mi4/DualContouring.hpp"
+#include "mi4/marching_cubes.hpp"
+#include <map>
+#include <cmath>
+
+class DualContouringTest : public mi4::TestCase
+{
+public:
+        explicit DualContouringTest ( void  ) : mi4::TestCase ( "dual_contouring_test" )
+        {
+                return;
+        }
+
+        void init ( void )
+        {
+                this->add ( DualContouringTest::test_sphere ) ;
+                this->add ( DualContouringTest::test_box ) ;
+                this->add ( DualContouringTest::test_slabs ) ;
+                return ;
+        }
+
+        static double signed_volume ( const mi4::Mesh& mesh )
+        {
+                double v = 0;
+                for ( size_t i = 0 ; i < mesh.getNumFaces() ; ++i ) {
+                        const auto f = mesh.getFaceIndices ( i );
+                        v += mesh.getPosition ( f[0] ).dot ( mesh.getPosition ( f[1] ).cross ( mesh.getPosition ( f[2] ) ) ) / 6.0;
+                }
+                return v;
+        }
+
+        static size_t count_intersected_cells ( const mi4::VolumeData<float>& volume, const double isovalue )
+        {
+                size_t count = 0;
+                const auto& info = volume.getInfo();
+                for ( const auto& p : mi4::Range ( info.getMin(), info.getMax() - mi4::Point3i ( 1, 1, 1 ) ) ) {
+                        int numAbove = 0;
+                        for ( const auto& dp : mi4::Range ( mi4::Point3i ( 0, 0, 0 ), mi4::Point3i ( 1, 1, 1 ) ) ) {
+                                numAbove += ( isovalue <= volume.get ( p + dp ) ) ? 1 : 0;
+                        }
+                        count += ( numAbove != 0 && numAbove != 8 ) ? 1 : 0;
+                }
+                return count;
+        }
+
+        /**
+         * Triangles whose minimum angle is less than 10 degrees.
+         */
+        static int count_slivers ( const mi4::Mesh& mesh )
+        {
+                int count = 0;
+                for ( size_t i = 0 ; i < mesh.getNumFaces() ; ++i ) {
+                        const auto f = mesh.getFaceIndices ( i );
+                        double minAngle = M_PI;
+                        for ( int j = 0 ; j < 3 ; ++j ) {
+                                const Eigen::Vector3d v0 = mesh.getPosition ( f[ ( j + 1 ) % 3] ) - mesh.getPosition ( f[j] );
+                                const Eigen::Vector3d v1 = mesh.getPosition ( f[ ( j + 2 ) % 3] ) - mesh.getPosition ( f[j] );
+                                minAngle = std::min ( minAngle, std::atan2 ( v0.cross ( v1 ).norm(), v0.dot ( v1 ) ) );
+                        }
+                        if ( minAngle < 10.0 * M_PI / 180.0 ) {
+                                ++count;
+                        }
+                }
+                return count;
+        }
+
+        /**
+         * Each directed edge is used once and its reverse once.
+         */
+        static bool is_closed ( const mi4::Mesh& mesh )
+        {
+                std::map<std::pair<size_t, size_t>, int> edges;
+                for ( size_t i = 0 ; i < mesh.getNumFaces() ; ++i ) {
+                        const auto f = mesh.getFaceIndices ( i );
+                        for ( int j = 0 ; j < 3 ; ++j ) {
+                                edges[std::make_pair ( f[j], f[ ( j + 1 ) % 3] )] += 1;
+                        }
+                }
+                for ( const auto& e : edges ) {
+                        const auto iter = edges.find ( std::make_pair ( e.first.second, e.first.first ) );
+                        if ( e.second != 1 || iter == edges.end() || iter->second != 1 ) {
+                                return false;
+                        }
+                }
+                return true;
+        }
+
+        static void test_sphere ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 30, 28, 26 ), mi4::Point3d ( 1.0, 1.0, 1.0 ), mi4::Point3d ( 0, 0, 0 ) );
+                const mi4::Point3d center ( 14.3, 13.6, 12.2 );
+                const double radius = 8.5;
+                mi4::VolumeData<float> volume ( info );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        volume.set ( p, static_cast<float> ( ( info.getPointInSpace ( p ) - center ).norm() ) );
+                }
+
+                std::vector<float> isovalue;
+                mi4::VolumeData<float> iso ( info );
+                iso.fill ( static_cast<float> ( radius ) );
+                const auto mc = mi4::anisosurf ( volume, iso, isovalue );
+
+                mi4::DualContouring<float> dc ( volume );
+                for ( const auto method : {mi4::DualContouring<float>::Method::SurfaceNets, mi4::DualContouring<float>::Method::Qef} ) {
+                        const auto mesh = dc.polygonize ( radius, method );
+                        ASSERT_EQUALS ( true, mesh.getNumFaces() > 0 );
+                        // one vertex per intersected cell : no slivers, unlike marching cubes.
+                        ASSERT_EQUALS ( count_intersected_cells ( volume, radius ), mesh.getNumVertices() );
+                        ASSERT_EQUALS ( 0, count_slivers ( mesh ) );
+                        ASSERT_EQUALS ( true, is_closed ( mesh ) );
+                        // Euler characteristic of a sphere.
+                        ASSERT_EQUALS ( 2, static_cast<int> ( mesh.getNumVertices() ) - static_cast<int> ( mesh.getNumFaces() * 3 / 2 ) + static_cast<int> ( mesh.getNumFaces() ) );
+                        // same orientation as marching cubes.
+                        ASSERT_EQUALS ( true, signed_volume ( mesh ) * signed_volume ( mc ) > 0 );
+
+                        double error = 0;
+                        for ( size_t i = 0 ; i < mesh.getNumVertices() ; ++i ) {
+                                error = std::max ( error, std::fabs ( ( mesh.getPosition ( i ) - center ).norm() - radius ) );
+                        }
+                        ASSERT_EQUALS ( true, error < 0.1 );
+                }
+                ASSERT_EQUALS ( true, count_slivers ( mc ) > 0 );
+                return ;
+        }
+
+        static void test_box ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 30, 28, 26 ) );
+                const mi4::Point3d center ( 14.3, 13.6, 12.2 );
+                const double halfSize = 8.5;
+                mi4::VolumeData<float> volume ( info );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        volume.set ( p, static_cast<float> ( ( info.getPointInSpace ( p ) - center ).cwiseAbs().maxCoeff() ) );
+                }
+
+                // Hermite data keeps the sharp edges and corners that surface nets round off.
+                mi4::DualContouring<float> dc ( volume );
+                double error[2] = {0, 0};
+                int i = 0;
+                for ( const auto method : {mi4::DualContouring<float>::Method::SurfaceNets, mi4::DualContouring<float>::Method::Qef} ) {
+                        const auto mesh = dc.polygonize ( halfSize, method );
+                        ASSERT_EQUALS ( true, is_closed ( mesh ) );
+                        for ( size_t v = 0 ; v < mesh.getNumVertices() ; ++v ) {
+                                error[i] = std::max ( error[i], std::fabs ( ( mesh.getPosition ( v ) - center ).cwiseAbs().maxCoeff() - halfSize ) );
+                        }
+                        ++i;
+                }
+                ASSERT_EQUALS ( true, error[1] < 0.25 );
+                ASSERT_EQUALS ( true, error[1] * 2 < error[0] );
+                return ;
+        }
+
+        static void test_slabs ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 21, 18, 17 ), mi4::Point3d ( 1.0, 0.5, 2.0 ) );
+                mi4::VolumeData<float> volume ( info );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        const mi4::Point3d d0 = info.getPointInSpace ( p ) - mi4::Point3d ( 7, 4, 12 );
+                        const mi4::Point3d d1 = info.getPointInSpace ( p ) - mi4::Point3d ( 13, 5, 20 );
+                        volume.set ( p, static_cast<float> ( std::min ( d0.norm(), d1.norm() ) ) );
+                }
+
+                mi4::DualContouring<float> dc ( volume );
+                for ( const auto method : {mi4::DualContouring<float>::Method::SurfaceNets, mi4::DualContouring<float>::Method::Qef} ) {
+                        dc.setSlabSize ( 100 );
+                        const auto expected = dc.polygonize ( 5.0, method );
+                        ASSERT_EQUALS ( true, expected.getNumFaces() > 0 );
+                        for ( const int slabSize : {0, 1, 2, 5} ) {
+                                dc.setSlabSize ( slabSize );
+                                const auto mesh = dc.polygonize ( 5.0, method );
+                                ASSERT_EQUALS ( expected.getNumVertices(), mesh.getNumVertices() );
+                                ASSERT_EQUALS ( expected.getNumFaces(), mesh.getNumFaces() );
+                                for ( size_t i = 0 ; i < mesh.getNumVertices() ; ++i ) {
+                                        ASSERT_EQUALS ( true, expected.getPosition ( i ) == mesh.getPosition ( i ) );
+                                }
+                                for ( size_t i = 0 ; i < mesh.getNumFaces() ; ++i ) {
+                                        ASSERT_EQUALS ( true, expected.getFaceIndices ( i ) == mesh.getFaceIndices ( i ) );
+                                }
+                        }
+                }
+                return ;
+        }
+};
+
+static DualContouringTest test;
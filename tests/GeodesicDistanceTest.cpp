@@ -0,0 +1,89 @@
+#include "mi4/Test.hpp"
+#include "mi4/GeodesicDistance.hpp"
+#include <cmath>
+
+class GeodesicDistanceTest : public mi4::TestCase
+{
+public:
+        explicit GeodesicDistanceTest ( void  ) : mi4::TestCase ( "geodesic_distance_test" )
+        {
+                return;
+        }
+
+        void init ( void )
+        {
+                this->add ( GeodesicDistanceTest::test_homogeneous ) ;
+                this->add ( GeodesicDistanceTest::test_obstacle ) ;
+                return ;
+        }
+
+        static void test_homogeneous ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 21, 17, 13 ), mi4::Point3d ( 1.0, 0.5, 2.0 ) );
+                mi4::VolumeData<float> speed ( info );
+                speed.fill ( 2.0f );
+                mi4::GeodesicDistance geodesic ( speed );
+                geodesic.addSeed ( mi4::Point3i ( 3, 4, 5 ) );
+
+                const auto fmm = geodesic.compute();
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        // exact along the axes through the seed.
+                        const mi4::Point3d d = ( p - mi4::Point3i ( 3, 4, 5 ) ).cast<double>().cwiseProduct ( info.getPitch() );
+                        if ( ( d.array() != 0 ).count() <= 1 ) {
+                                ASSERT_EQUALS ( true, std::fabs ( fmm.get ( p ) - d.norm() / 2.0 ) < 1.0e-5 );
+                        }
+                        // first-order error elsewhere.
+                        ASSERT_EQUALS ( true, fmm.get ( p ) >= d.norm() / 2.0 - 1.0e-5 && fmm.get ( p ) < d.norm() / 2.0 * 1.5 + 1.0e-5 );
+                }
+
+                for ( const int slabSize : {0, 1, 4, 13} ) {
+                        const auto fsm = geodesic.compute ( mi4::GeodesicDistance::Method::FastSweeping, slabSize );
+                        for ( const auto& p : mi4::Range ( info ) ) {
+                                ASSERT_EQUALS ( true, std::fabs ( fmm.get ( p ) - fsm.get ( p ) ) < 1.0e-4 );
+                        }
+                }
+                return ;
+        }
+
+        static void test_obstacle ( void )
+        {
+                // a wall at x = 10 with a gap at y >= 15.
+                const mi4::VolumeInfo info ( mi4::Point3i ( 20, 20, 6 ) );
+                mi4::VolumeData<float> speed ( info );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        const bool isWall = p.x() == 10 && p.y() < 15;
+                        speed.set ( p, isWall ? 0.0f : 1.0f );
+                }
+                // an unreachable pocket (18 - 19, 18 - 19, 5) at the corner.
+                for ( const auto& p : mi4::Range ( mi4::Point3i ( 17, 17, 4 ), mi4::Point3i ( 19, 19, 4 ) ) ) {
+                        speed.set ( p, 0.0f );
+                }
+                for ( const int y : {17, 18, 19} ) {
+                        speed.set ( mi4::Point3i ( 17, y, 5 ), 0.0f );
+                }
+                for ( const int x : {17, 18, 19} ) {
+                        speed.set ( mi4::Point3i ( x, 17, 5 ), 0.0f );
+                }
+
+                mi4::GeodesicDistance geodesic ( speed );
+                geodesic.addSeed ( mi4::Point3i ( 5, 2, 2 ) );
+                const auto fmm = geodesic.compute();
+                const auto fsm = geodesic.compute ( mi4::GeodesicDistance::Method::FastSweeping, 2 );
+
+                // around the wall : longer than the straight line.
+                const mi4::Point3i target ( 15, 2, 2 );
+                ASSERT_EQUALS ( true, fmm.get ( target ) > 2 * 13 - 1 );
+                ASSERT_EQUALS ( true, std::isinf ( fmm.get ( mi4::Point3i ( 10, 5, 2 ) ) ) );
+                ASSERT_EQUALS ( true, std::isinf ( fmm.get ( mi4::Point3i ( 19, 19, 5 ) ) ) );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        if ( std::isinf ( fmm.get ( p ) ) ) {
+                                ASSERT_EQUALS ( true, std::isinf ( fsm.get ( p ) ) );
+                        } else {
+                                ASSERT_EQUALS ( true, std::fabs ( fmm.get ( p ) - fsm.get ( p ) ) < 1.0e-4 );
+                        }
+                }
+                return ;
+        }
+};
+
+static GeodesicDistanceTest test;
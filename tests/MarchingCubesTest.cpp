@@ -0,0 +1,116 @@
+#include "mi4/Test.hpp"
+#include "mi4/marching_cubes.hpp"
+#include "mi4/Kdtree.hpp"
+#include <list>
+
+class MarchingCubesTest : public mi4::TestCase
+{
+public:
+        explicit MarchingCubesTest ( void  ) : mi4::TestCase ( "marching_cubes_test" )
+        {
+                return;
+        }
+
+        void init ( void )
+        {
+                this->add ( MarchingCubesTest::test_anisosurf ) ;
+                return ;
+        }
+
+        /**
+         * Triangle soup welded with Kdtree.
+         */
+        template<typename T, typename S>
+        static mi4::Mesh stitched_anisosurf ( const mi4::VolumeData<T>& inputData, const mi4::VolumeData<S>& isoData, std::vector<float>& isovalue )
+        {
+                mi4::Mesh mesh;
+                const auto& info = inputData.getInfo();
+                std::vector<float> intersection;
+                for ( const auto& p : mi4::Range ( info.getMin(), info.getMax() - mi4::Point3i ( 1, 1, 1 ) ) ) {
+                        std::vector<mi4::cell_type> cell;
+                        for ( const auto& dp : mi4::Range ( mi4::Point3i ( 0, 0, 0 ), mi4::Point3i ( 1, 1, 1 ) ) ) {
+                                const auto np = p + dp ;
+                                cell.push_back ( std::make_tuple ( info.getPointInSpace ( np ), inputData.get ( np ), isoData.get ( np ) ) );
+                        }
+                        mi4::polygonize_cell ( cell, mesh, intersection );
+                }
+
+                typedef mi4::IndexedVector<Eigen::Vector3d> VertexType;
+                std::vector<VertexType> points;
+                for ( size_t i = 0 ; i < mesh.getNumVertices() ; ++i ) {
+                        points.push_back ( VertexType ( mesh.getPosition ( i ), static_cast<int> ( i ) ) ) ;
+                }
+                mi4::Kdtree<VertexType> kdtree ( points );
+
+                mi4::Mesh result;
+                std::vector<int> newId ( mesh.getNumVertices(), -1 ) ;
+                for ( size_t i = 0 ; i < mesh.getNumVertices() ; ++i ) {
+                        if ( newId[i] != -1 ) {
+                                continue;
+                        }
+                        std::list<VertexType> near;
+                        kdtree.find ( VertexType ( mesh.getPosition ( i ), 0 ), 1.0e-10, near );
+                        const auto id = static_cast<int> ( result.addPoint ( mesh.getPosition ( i ) ) );
+                        isovalue.push_back ( intersection[i] );
+                        for ( const auto& v : near ) {
+                                newId[static_cast<size_t> ( v.id() )] = id;
+                        }
+                }
+                for ( size_t i = 0 ; i < mesh.getNumFaces() ; ++i ) {
+                        auto index = mesh.getFaceIndices ( i ) ;
+                        for ( auto& idx : index ) {
+                                idx = static_cast<size_t> ( newId.at ( idx ) );
+                        }
+                        result.addFace ( index );
+                }
+                return result;
+        }
+
+        static void test_anisosurf ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 19, 16, 13 ), mi4::Point3d ( 1.0, 0.5, 2.0 ) );
+                mi4::VolumeData<float> volume ( info );
+                mi4::VolumeData<float> iso ( info );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        // two blobs. some voxels are exactly on the isovalue.
+                        const mi4::Point3d d0 = ( p - mi4::Point3i ( 6, 6, 5 ) ).cast<double>();
+                        const mi4::Point3d d1 = ( p - mi4::Point3i ( 12, 9, 7 ) ).cast<double>();
+                        volume.set ( p, static_cast<float> ( std::min ( d0.norm(), d1.norm() ) ) );
+                        iso.set ( p, 4.0f + 0.1f * static_cast<float> ( p.x() % 3 ) );
+                }
+
+                std::vector<float> expectedValue;
+                const auto expected = stitched_anisosurf ( volume, iso, expectedValue );
+                std::vector<float> value;
+                const auto mesh = mi4::anisosurf ( volume, iso, value );
+
+                ASSERT_EQUALS ( true, expected.getNumFaces() > 0 );
+                ASSERT_EQUALS ( expected.getNumVertices(), mesh.getNumVertices() );
+                ASSERT_EQUALS ( expected.getNumFaces(), mesh.getNumFaces() );
+                ASSERT_EQUALS ( true, expectedValue == value );
+                for ( size_t i = 0 ; i < mesh.getNumVertices() ; ++i ) {
+                        ASSERT_EQUALS ( true, ( expected.getPosition ( i ) - mesh.getPosition ( i ) ).norm() < 1.0e-10 );
+                }
+                for ( size_t i = 0 ; i < mesh.getNumFaces() ; ++i ) {
+                        ASSERT_EQUALS ( true, expected.getFaceIndices ( i ) == mesh.getFaceIndices ( i ) );
+                }
+
+                // independent of slabs.
+                for ( const int slabSize : {1, 2, 5, 12} ) {
+                        std::vector<float> slabValue;
+                        const auto slabMesh = mi4::anisosurf ( volume, iso, slabValue, 1.0e-10, slabSize );
+                        ASSERT_EQUALS ( true, value == slabValue );
+                        ASSERT_EQUALS ( mesh.getNumVertices(), slabMesh.getNumVertices() );
+                        ASSERT_EQUALS ( mesh.getNumFaces(), slabMesh.getNumFaces() );
+                        for ( size_t i = 0 ; i < mesh.getNumVertices() ; ++i ) {
+                                ASSERT_EQUALS ( true, mesh.getPosition ( i ) == slabMesh.getPosition ( i ) );
+                        }
+                        for ( size_t i = 0 ; i < mesh.getNumFaces() ; ++i ) {
+                                ASSERT_EQUALS ( true, mesh.getFaceIndices ( i ) == slabMesh.getFaceIndices ( i ) );
+                        }
+                }
+                return ;
+        }
+};
+
+static MarchingCubesTest test;
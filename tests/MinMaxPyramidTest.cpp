@@ -0,0 +1,81 @@
+#include "mi4/Test.hpp"
+#include "mi4/MinMaxPyramid.hpp"
+#include <random>
+
+class MinMaxPyramidTest : public mi4::TestCase
+{
+public:
+        explicit MinMaxPyramidTest ( void  ) : mi4::TestCase ( "min_max_pyramid_test" )
+        {
+                return;
+        }
+
+        void init ( void )
+        {
+                this->add ( MinMaxPyramidTest::test_build ) ;
+                this->add ( MinMaxPyramidTest::test_active_blocks ) ;
+                return ;
+        }
+
+        static void test_build ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 21, 9, 14 ) );
+                mi4::VolumeData<int> volume ( info );
+                std::mt19937 gen ( 3 );
+                std::uniform_int_distribution<int> dist ( -1000, 1000 );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        volume.set ( p, dist ( gen ) );
+                }
+
+                const mi4::MinMaxPyramid<int> pyramid ( volume, 4 );
+                ASSERT_EQUALS ( true, pyramid.getNumBlocks() == mi4::Point3i ( 5, 2, 4 ) );
+                ASSERT_EQUALS ( 4, pyramid.getNumLevels() );
+                ASSERT_EQUALS ( true, pyramid.getNumBlocks ( 3 ) == mi4::Point3i ( 1, 1, 1 ) );
+
+                for ( int level = 0 ; level < pyramid.getNumLevels() ; ++level ) {
+                        const int bs = 4 << level;
+                        for ( const auto& b : mi4::Range ( mi4::Point3i ( 0, 0, 0 ), pyramid.getNumBlocks ( level ) - mi4::Point3i ( 1, 1, 1 ) ) ) {
+                                // voxels of cells in the block.
+                                const mi4::Point3i bmin = b * bs;
+                                const mi4::Point3i bmax = ( bmin + mi4::Point3i::Constant ( bs ) ).cwiseMin ( info.getMax() );
+                                int vmin = volume.get ( bmin );
+                                int vmax = vmin;
+                                for ( const auto& p : mi4::Range ( bmin, bmax ) ) {
+                                        vmin = std::min ( vmin, volume.get ( p ) );
+                                        vmax = std::max ( vmax, volume.get ( p ) );
+                                }
+                                ASSERT_EQUALS ( vmin, pyramid.getMin ( level, b ) );
+                                ASSERT_EQUALS ( vmax, pyramid.getMax ( level, b ) );
+                        }
+                }
+                return ;
+        }
+
+        static void test_active_blocks ( void )
+        {
+                // a slope along x.
+                const mi4::VolumeInfo info ( mi4::Point3i ( 33, 5, 5 ) );
+                mi4::VolumeData<float> volume ( info );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        volume.set ( p, static_cast<float> ( p.x() ) );
+                }
+                const mi4::MinMaxPyramid<float> pyramid ( volume );
+                ASSERT_EQUALS ( true, pyramid.getNumBlocks() == mi4::Point3i ( 4, 1, 1 ) );
+
+                const auto a0 = pyramid.getActiveBlocks ( 10.5, 10.5 );
+                ASSERT_EQUALS ( true, a0 == std::vector<char> ( {0, 1, 0, 0} ) );
+                // shared voxels of blocks.
+                const auto a1 = pyramid.getActiveBlocks ( 16.0, 16.0 );
+                ASSERT_EQUALS ( true, a1 == std::vector<char> ( {0, 1, 1, 0} ) );
+                const auto a2 = pyramid.getActiveBlocks ( 40.0, 50.0 );
+                ASSERT_EQUALS ( true, a2 == std::vector<char> ( {0, 0, 0, 0} ) );
+
+                mi4::VolumeData<float> iso ( info );
+                iso.fill ( 30.0f );
+                const auto a3 = pyramid.getActiveBlocks ( mi4::MinMaxPyramid<float> ( iso ), 0.0 );
+                ASSERT_EQUALS ( true, a3 == std::vector<char> ( {0, 0, 0, 1} ) );
+                return ;
+        }
+};
+
+static MinMaxPyramidTest test;
@@ -0,0 +1,107 @@
+#include "mi4/Test.hpp"
+#include "mi4/ParallelFor.hpp"
+#include "mi4/VolumeDataUtility.hpp"
+#include <atomic>
+
+class ParallelForTest : public mi4::TestCase
+{
+public:
+        explicit ParallelForTest ( void  ) : mi4::TestCase ( "parallel_for_test" )
+        {
+                return;
+        }
+
+        void init ( void )
+        {
+                this->add ( ParallelForTest::test_parallel_for ) ;
+                this->add ( ParallelForTest::test_nested ) ;
+                this->add ( ParallelForTest::test_for_each ) ;
+                this->add ( ParallelForTest::test_reduce ) ;
+                this->add ( ParallelForTest::test_morphology ) ;
+                return ;
+        }
+
+        static void test_parallel_for ( void )
+        {
+                std::vector<int> values ( 10007, 0 );
+                mi4::parallel_for ( 0, values.size(), [&values] ( const size_t b, const size_t e ) {
+                        for ( size_t i = b ; i < e ; ++i ) {
+                                values[i] += static_cast<int> ( i );
+                        }
+                }, 100 );
+
+                for ( size_t i = 0 ; i < values.size() ; ++i ) {
+                        ASSERT_EQUALS ( static_cast<int> ( i ), values[i] );
+                }
+                return ;
+        }
+
+        static void test_nested ( void )
+        {
+                std::atomic<int> count ( 0 );
+                mi4::parallel_for ( 0, 16, [&count] ( const size_t b, const size_t e ) {
+                        for ( size_t i = b ; i < e ; ++i ) {
+                                mi4::parallel_for ( 0, 100, [&count] ( const size_t b1, const size_t e1 ) {
+                                        count += static_cast<int> ( e1 - b1 );
+                                } );
+                        }
+                } );
+                ASSERT_EQUALS ( 1600, count.load() );
+                return ;
+        }
+
+        static void test_for_each ( void )
+        {
+                std::vector<int> values ( 1000, 1 );
+                mi4::parallel_for_each ( values.begin(), values.end(), [] ( int& v ) {
+                        v *= 2;
+                }, 7 );
+
+                for ( const auto& v : values ) {
+                        ASSERT_EQUALS ( 2, v );
+                }
+                return ;
+        }
+
+        static void test_reduce ( void )
+        {
+                const size_t n = 10007;
+                const auto sum = mi4::parallel_reduce ( 0, n, static_cast<size_t> ( 0 ), [] ( const size_t b, const size_t e, size_t value ) {
+                        for ( size_t i = b ; i < e ; ++i ) {
+                                value += i;
+                        }
+                        return value;
+                }, [] ( const size_t a, const size_t b ) {
+                        return a + b;
+                }, 10 );
+                ASSERT_EQUALS ( n * ( n - 1 ) / 2, sum );
+
+                // bool partials of neighbouring chunks are written concurrently.
+                for ( const size_t target : {static_cast<size_t> ( 0 ), static_cast<size_t> ( 5000 ), n - 1, n} ) {
+                        const bool found = mi4::parallel_transform_reduce ( 0, n, false, [target] ( const size_t i ) {
+                                return i == target;
+                        }, [] ( const bool a, const bool b ) {
+                                return a || b;
+                        }, 1 );
+                        ASSERT_EQUALS ( static_cast<int> ( target < n ), static_cast<int> ( found ) );
+                }
+                return ;
+        }
+
+        static void test_morphology ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 11, 11, 11 ) );
+                mi4::VolumeData<char> data ( info );
+                data.set ( mi4::Point3i ( 5, 5, 5 ), 1 );
+
+                const auto dilated = mi4::VolumeDataUtility::dilate ( data, 2.0 );
+                ASSERT_EQUALS ( static_cast<char> ( 1 ), dilated.get ( mi4::Point3i ( 7, 5, 5 ) ) );
+                ASSERT_EQUALS ( static_cast<char> ( 0 ), dilated.get ( mi4::Point3i ( 7, 7, 5 ) ) );
+
+                const auto eroded = mi4::VolumeDataUtility::erode ( dilated, 1.0 );
+                ASSERT_EQUALS ( static_cast<char> ( 1 ), eroded.get ( mi4::Point3i ( 5, 5, 5 ) ) );
+                ASSERT_EQUALS ( static_cast<char> ( 0 ), eroded.get ( mi4::Point3i ( 7, 5, 5 ) ) );
+                return ;
+        }
+};
+static ParallelForTest test;
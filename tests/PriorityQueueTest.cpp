@@ -0,0 +1,159 @@
+#include "mi4/Test.hpp"
+#include "mi4/PriorityQueue.hpp"
+#include "mi4/VolumeData.hpp"
+#include <random>
+#include <map>
+
+class PriorityQueueTest : public mi4::TestCase
+{
+public:
+        explicit PriorityQueueTest ( void  ) : mi4::TestCase ( "priority_queue_test" )
+        {
+                return;
+        }
+
+        void init ( void )
+        {
+                this->add ( PriorityQueueTest::test_priority_queue ) ;
+                this->add ( PriorityQueueTest::test_bucket_queue ) ;
+                this->add ( PriorityQueueTest::test_indexed ) ;
+                this->add ( PriorityQueueTest::test_radix_heap ) ;
+                return ;
+        }
+
+        static void test_priority_queue ( void )
+        {
+                mi4::PriorityQueue<int> pq;
+                const float costs[] = {3, 1, 4, 1.5f, 5, 9, 2, 6};
+                for ( int i = 0 ; i < 8 ; ++i ) {
+                        pq.push ( i, costs[i] );
+                }
+                float last = -1;
+                while ( !pq.empty() ) {
+                        ASSERT_EQUALS ( true, last <= pq.getTopCost() );
+                        ASSERT_EQUALS ( costs[pq.getTopIndex()], pq.getTopCost() );
+                        last = pq.getTopCost();
+                        pq.pop();
+                }
+                return ;
+        }
+
+        static void test_bucket_queue ( void )
+        {
+                mi4::BucketQueue<int> pq ( 10 );
+                pq.push ( 1, 5 );
+                pq.push ( 2, 3 );
+                pq.push ( 3, 7 );
+                ASSERT_EQUALS ( size_t ( 3 ), pq.getTopCost() );
+                ASSERT_EQUALS ( 2, pq.getTopIndex() );
+                pq.pop();
+                pq.push ( 4, 4 );
+                ASSERT_EQUALS ( 4, pq.getTopIndex() );
+                pq.pop();
+                ASSERT_EQUALS ( 1, pq.getTopIndex() );
+                pq.pop();
+                ASSERT_EQUALS ( 3, pq.getTopIndex() );
+                pq.pop();
+                ASSERT_EQUALS ( true, pq.empty() );
+                return ;
+        }
+
+        /**
+         * Random pushes and decreases against std::multimap.
+         */
+        static void test_indexed ( void )
+        {
+                std::mt19937 gen ( 1 );
+                std::uniform_int_distribution<int64_t> key ( 0, 199 );
+                std::uniform_real_distribution<float> cost ( 0, 100 );
+
+                mi4::IndexedPriorityQueue<> pq;
+                pq.reserve ( 100 ); // grows beyond it.
+                std::map<int64_t, float> expected;
+
+                for ( int n = 0 ; n < 2000 ; ++n ) {
+                        const auto idx = key ( gen );
+                        const auto c = cost ( gen );
+                        pq.push ( idx, c );
+                        const auto iter = expected.find ( idx );
+                        if ( iter == expected.end() ) {
+                                expected[idx] = c;
+                        } else {
+                                iter->second = std::min ( iter->second, c );
+                        }
+                        ASSERT_EQUALS ( expected.size(), pq.size() );
+
+                        if ( n % 3 == 0 ) {
+                                auto best = expected.begin();
+                                for ( auto i = expected.begin() ; i != expected.end() ; ++i ) {
+                                        if ( i->second < best->second ) {
+                                                best = i;
+                                        }
+                                }
+                                ASSERT_EQUALS ( best->second, pq.getTopCost() );
+                                ASSERT_EQUALS ( best->first, pq.getTopIndex() );
+                                pq.pop();
+                                ASSERT_EQUALS ( false, pq.contains ( best->first ) );
+                                expected.erase ( best );
+                        }
+                }
+
+                for ( const auto& e : expected ) {
+                        ASSERT_EQUALS ( e.second, pq.getCost ( e.first ) );
+                }
+                ASSERT_EQUALS ( false, pq.decrease ( expected.begin()->first, expected.begin()->second + 1 ) );
+                ASSERT_EQUALS ( true, pq.decrease ( expected.begin()->first, -1 ) );
+                ASSERT_EQUALS ( expected.begin()->first, pq.getTopIndex() );
+
+                pq.clear();
+                ASSERT_EQUALS ( true, pq.empty() );
+                ASSERT_EQUALS ( false, pq.contains ( expected.begin()->first ) );
+
+                pq.push ( -1, 0.0f );
+                ASSERT_EQUALS ( true, pq.empty() );
+                ASSERT_EQUALS ( false, pq.contains ( -1 ) );
+                return ;
+        }
+
+        static void test_radix_heap ( void )
+        {
+                std::mt19937 gen ( 2 );
+                std::uniform_int_distribution<uint32_t> delta ( 0, 1000 );
+                mi4::RadixHeap<int> heap;
+                std::multimap<uint32_t, int> expected;
+                uint32_t last = 0;
+
+                for ( int n = 0 ; n < 3000 ; ++n ) {
+                        const auto c = last + delta ( gen );
+                        heap.push ( n, c );
+                        expected.insert ( std::make_pair ( c, n ) );
+                        if ( n % 2 == 0 ) {
+                                ASSERT_EQUALS ( expected.begin()->first, heap.getTopCost() );
+                                last = heap.getTopCost();
+                                expected.erase ( expected.find ( last ) );
+                                heap.pop();
+                        }
+                }
+                while ( !heap.empty() ) {
+                        ASSERT_EQUALS ( expected.begin()->first, heap.getTopCost() );
+                        expected.erase ( expected.begin() );
+                        heap.pop();
+                }
+                ASSERT_EQUALS ( true, expected.empty() );
+
+                // values without operator <.
+                mi4::RadixHeap<mi4::Point3i> points;
+                points.push ( mi4::Point3i ( 1, 2, 3 ), 5 );
+                points.push ( mi4::Point3i ( 4, 5, 6 ), 3 );
+                points.push ( mi4::Point3i ( 7, 8, 9 ), 3 );
+                ASSERT_EQUALS ( 3u, points.getTopCost() );
+                points.pop();
+                ASSERT_EQUALS ( 3u, points.getTopCost() );
+                points.pop();
+                ASSERT_EQUALS ( 5u, points.getTopCost() );
+                ASSERT_EQUALS ( mi4::Point3i ( 1, 2, 3 ), points.getTopIndex() );
+                return ;
+        }
+};
+
+static PriorityQueueTest test;
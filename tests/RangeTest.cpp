@@ -4,6 +4,8 @@
 
 #include "mi4/Test.hpp"
 #include "mi4/VolumeData.hpp"
+#include <algorithm>
+#include <tuple>
 
 class RangeTest : public mi4::TestCase {
 public:
@@ -16,6 +18,8 @@ public:
         {
                 this->add(RangeTest::test_default_constructor);
                 this->add(RangeTest::test01);
+                this->add(RangeTest::test_random_access);
+                this->add(RangeTest::test_parallel_for);
 
                 return;
         }
@@ -48,6 +52,66 @@ public:
 
                 return;
         }
+
+        static void test_random_access (void)
+        {
+                const mi4::Range range(mi4::Point3i(2, 3, 4), mi4::Point3i(6, 5, 9));
+                ASSERT_EQUALS(static_cast<int64_t>(5 * 3 * 6), range.getNumVoxels());
+                ASSERT_EQUALS(static_cast<std::ptrdiff_t>(range.getNumVoxels()), std::distance(range.begin(), range.end()));
+
+                auto iter = range.begin();
+                for ( int i = 0 ; i < 37 ; ++i ) {
+                        ++iter;
+                }
+                const auto jump = range.begin() + 37;
+                ASSERT_EQUALS((*iter).transpose(), (*jump).transpose());
+                ASSERT_EQUALS((*iter).transpose(), range.begin()[37].transpose());
+                ASSERT_EQUALS(static_cast<std::ptrdiff_t>(37), jump - range.begin());
+                ASSERT_EQUALS(static_cast<int>(true), static_cast<int>(range.begin() + range.getNumVoxels() == range.end()));
+                ASSERT_EQUALS(static_cast<int>(true), static_cast<int>(37 + range.begin() == jump));
+                ASSERT_EQUALS(static_cast<int>(true), static_cast<int>(jump > range.begin() && range.begin() <= jump && range.end() >= jump));
+                ASSERT_EQUALS(iter->y(), (*jump).y());
+
+                // backward from the end visits all voxels in reverse order.
+                auto back = range.end();
+                for ( int64_t i = range.getNumVoxels() - 1 ; i >= 0 ; --i ) {
+                        back--;
+                        ASSERT_EQUALS((*back).transpose(), range.begin()[i].transpose());
+                }
+                ASSERT_EQUALS(static_cast<int>(true), static_cast<int>(back == range.begin()));
+                ASSERT_EQUALS((*std::prev(range.end())).transpose(), range.getMax().transpose());
+
+                // standard algorithms dispatching on the iterator category.
+                const auto found = std::lower_bound(range.begin(), range.end(), mi4::Point3i(4, 4, 7), [] (const mi4::Point3i& a, const mi4::Point3i& b) {
+                        return std::make_tuple(a.z(), a.y(), a.x()) < std::make_tuple(b.z(), b.y(), b.x());
+                });
+                ASSERT_EQUALS(mi4::Point3i(4, 4, 7).transpose(), (*found).transpose());
+                std::reverse_iterator<mi4::Range::iterator> rbegin(range.end());
+                ASSERT_EQUALS(range.getMax().transpose(), (*rbegin).transpose());
+                return;
+        }
+
+        static void test_parallel_for (void)
+        {
+                const mi4::VolumeInfo info(mi4::Point3i(13, 7, 9));
+                mi4::VolumeData<int> data(info);
+                mi4::parallel_for(mi4::Range(info), [&data] (const mi4::Range& block) {
+                        for ( const auto& p : block ) {
+                                data.at(p) += 1;
+                        }
+                }, mi4::Point3i(4, 4, 4));
+
+                mi4::parallel_for_rows(data, mi4::Range(mi4::Point3i(1, 0, 0), mi4::Point3i(12, 6, 8)), [] (int* row, const mi4::Point3i& start, const int length) {
+                        for ( int x = 0 ; x < length ; ++x ) {
+                                row[x] += start.x() + x;
+                        }
+                });
+
+                for ( const auto& p : mi4::Range(info)) {
+                        ASSERT_EQUALS(1 + p.x(), data.get(p));
+                }
+                return;
+        }
 };
 
 static RangeTest rangetest;
\ No newline at end of file
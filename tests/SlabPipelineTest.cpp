@@ -0,0 +1,96 @@
+#include "mi4/Test.hpp"
+#include "mi4/SlabPipeline.hpp"
+#include <cstdio>
+
+class SlabPipelineTest : public mi4::TestCase
+{
+public:
+        explicit SlabPipelineTest ( void  ) : mi4::TestCase ( "slab_pipeline_test" )
+        {
+                return;
+        }
+
+        void init ( void )
+        {
+                this->add ( SlabPipelineTest::test_stages ) ;
+                this->add ( SlabPipelineTest::test_file ) ;
+                return ;
+        }
+
+        static mi4::VolumeData<short> create_volume ( const mi4::VolumeInfo& info )
+        {
+                mi4::VolumeData<short> data ( info );
+                const mi4::Point3d c = info.getSize().cast<double>() * 0.5;
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        const double r = ( p.cast<double>() - c ).norm();
+                        data.set ( p, static_cast<short> ( 1000 - 100 * r + ( p.x() * 7 + p.y() * 13 + p.z() * 3 ) % 50 ) );
+                }
+                return data;
+        }
+
+        static void test_stages ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 23, 19, 29 ), mi4::Point3d ( 1, 1, 0.7 ) );
+                const auto data = create_volume ( info );
+
+                const auto mask = mi4::VolumeDataUtility::binarize ( data, short ( 500 ), char ( 1 ) );
+                const auto expected = mi4::VolumeDataUtility::extractBoundaryVoxels ( mi4::VolumeDataUtility::dilate ( mi4::VolumeDataUtility::erode ( mask, 1.5 ), 1.0 ) );
+
+                for ( const int slabSize : {1, 4, 7, 64} ) {
+                        mi4::VolumeDataSource<short> source ( data );
+                        mi4::BinarizeStage<short> binarize ( 500 );
+                        mi4::MorphologyStage<> erode ( mi4::MorphologyStage<>::Operation::Erode, 1.5 );
+                        mi4::MorphologyStage<> dilate ( mi4::MorphologyStage<>::Operation::Dilate, 1.0 );
+                        mi4::BoundaryStage boundary;
+                        mi4::VolumeData<char> result;
+                        mi4::VolumeDataSink<char> sink ( result, info );
+
+                        ASSERT_EQUALS ( true, mi4::SlabPipeline ( slabSize, 1 ).run ( source, binarize, erode, dilate, boundary, sink ) );
+                        for ( const auto& p : mi4::Range ( info ) ) {
+                                ASSERT_EQUALS ( expected.get ( p ), result.get ( p ) );
+                        }
+                }
+                return ;
+        }
+
+        static void test_file ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 17, 11, 13 ) );
+                const auto data = create_volume ( info );
+                const std::string inFile ( "slab_pipeline_test_in.raw" );
+                const std::string outFile ( "slab_pipeline_test_out.raw" );
+
+                {
+                        std::ofstream fout ( inFile.c_str(), std::ios::binary );
+                        const char header[8] = {0};
+                        fout.write ( header, sizeof ( header ) );
+                        fout.write ( reinterpret_cast<const char*> ( data.data() ), static_cast<std::streamsize> ( data.getNumVoxels() * sizeof ( short ) ) );
+                }
+
+                mi4::SlabReader<short> reader ( inFile, info, 8 );
+                mi4::BinarizeStage<short> binarize ( 700, 3 );
+                mi4::SlabWriter<char> writer ( outFile );
+                ASSERT_EQUALS ( true, mi4::SlabPipeline ( 5 ).run ( reader, binarize, writer ) );
+
+                mi4::VolumeData<char> result ( info );
+                {
+                        std::ifstream fin ( outFile.c_str(), std::ios::binary );
+                        ASSERT_EQUALS ( true, result.read ( fin ) );
+                }
+                const auto expected = mi4::VolumeDataUtility::binarize ( data, short ( 700 ), char ( 3 ) );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        ASSERT_EQUALS ( expected.get ( p ), result.get ( p ) );
+                }
+
+                mi4::SlabReader<short> missing ( "slab_pipeline_test_missing.raw", info );
+                mi4::VolumeData<char> unused;
+                mi4::VolumeDataSink<char> sink ( unused, info );
+                ASSERT_EQUALS ( false, mi4::SlabPipeline ( 5 ).run ( missing, binarize, sink ) );
+
+                std::remove ( inFile.c_str() );
+                std::remove ( outFile.c_str() );
+                return ;
+        }
+};
+
+static SlabPipelineTest test;
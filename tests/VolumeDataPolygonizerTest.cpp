@@ -0,0 +1,127 @@
+#include "mi4/Test.hpp"
+#include "mi4/VolumeDataPolygonizer.hpp"
+#include "mi4/marching_cubes.hpp"
+
+class VolumeDataPolygonizerTest : public mi4::TestCase
+{
+public:
+        explicit VolumeDataPolygonizerTest ( void  ) : mi4::TestCase ( "volume_data_polygonizer_test" )
+        {
+                return;
+        }
+
+        void init ( void )
+        {
+                this->add ( VolumeDataPolygonizerTest::test_slabs ) ;
+                this->add ( VolumeDataPolygonizerTest::test_skipping ) ;
+                return ;
+        }
+
+        static bool is_same ( const mi4::Mesh& m0, const mi4::Mesh& m1 )
+        {
+                if ( m0.getNumVertices() != m1.getNumVertices() || m0.getNumFaces() != m1.getNumFaces() ) {
+                        return false;
+                }
+                for ( size_t i = 0 ; i < m0.getNumVertices() ; ++i ) {
+                        if ( m0.getPosition ( i ) != m1.getPosition ( i ) ) {
+                                return false;
+                        }
+                }
+                for ( size_t i = 0 ; i < m0.getNumFaces() ; ++i ) {
+                        if ( m0.getFaceIndices ( i ) != m1.getFaceIndices ( i ) ) {
+                                return false;
+                        }
+                }
+                return true;
+        }
+
+        /**
+         * Slab-parallel output is the same as the one of a single slab.
+         */
+        static void test_slabs ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 17, 14, 11 ), mi4::Point3d ( 0.5, 1.0, 1.5 ) );
+                mi4::VolumeData<float> volume ( info );
+                mi4::VolumeData<float> iso ( info );
+                mi4::VolumeData<char> mask ( info );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        const mi4::Point3d d = ( p - mi4::Point3i ( 8, 6, 5 ) ).cast<double>();
+                        volume.set ( p, static_cast<float> ( d.norm() ) );
+                        iso.set ( p, 3.5f + 0.25f * static_cast<float> ( p.z() % 2 ) );
+                        mask.set ( p, p.x() < 10 ? 1 : 0 );
+                }
+
+                mi4::VolumeDataPolygonizer<float> polygonizer ( volume );
+                polygonizer.setSlabSize ( info.getSize().z() );
+                const auto expected0 = polygonizer.polygonize ( 4.0f );
+                const auto expected1 = polygonizer.polygonize ( iso );
+                const auto expected2 = polygonizer.polygonize ( 4.0f, mask );
+                const auto expected3 = polygonizer.polygonize ( iso, mask );
+                ASSERT_EQUALS ( true, expected0.getNumFaces() > 0 );
+                ASSERT_EQUALS ( true, expected2.getNumFaces() < expected0.getNumFaces() );
+
+                for ( const int slabSize : {0, 1, 3, 4} ) {
+                        polygonizer.setSlabSize ( slabSize );
+                        ASSERT_EQUALS ( true, is_same ( expected0, polygonizer.polygonize ( 4.0f ) ) );
+                        ASSERT_EQUALS ( true, is_same ( expected1, polygonizer.polygonize ( iso ) ) );
+                        ASSERT_EQUALS ( true, is_same ( expected2, polygonizer.polygonize ( 4.0f, mask ) ) );
+                        ASSERT_EQUALS ( true, is_same ( expected3, polygonizer.polygonize ( iso, mask ) ) );
+                }
+                return ;
+        }
+
+        /**
+         * Skipping blocks does not change the triangles of all cells.
+         */
+        static void test_skipping ( void )
+        {
+                const mi4::VolumeInfo info ( mi4::Point3i ( 40, 36, 30 ) );
+                mi4::VolumeData<float> volume ( info );
+                auto sphere = [&volume, &info] ( const mi4::Point3i & c ) {
+                        for ( const auto& p : mi4::Range ( info ) ) {
+                                volume.set ( p, static_cast<float> ( ( p - c ).cast<double>().norm() ) );
+                        }
+                };
+
+                auto polygonize = [&volume, &info] ( const float isovalue ) {
+                        mi4::Mesh mesh;
+                        std::vector<float> value;
+                        for ( const auto& p : mi4::Range ( info.getMin(), info.getMax() - mi4::Point3i ( 1, 1, 1 ) ) ) {
+                                std::vector<mi4::cell_type> cell;
+                                for ( const auto& dp : mi4::Range ( mi4::Point3i ( 0, 0, 0 ), mi4::Point3i ( 1, 1, 1 ) ) ) {
+                                        cell.push_back ( std::make_tuple ( info.getPointInSpace ( p + dp ), volume.get ( p + dp ), isovalue ) );
+                                }
+                                mi4::polygonize_cell ( cell, mesh, value, 1.0e-3 );
+                        }
+                        return mesh;
+                };
+
+                auto is_near = [] ( const mi4::Mesh & m0, const mi4::Mesh & m1 ) {
+                        if ( m0.getNumVertices() != m1.getNumVertices() || m0.getNumFaces() != m1.getNumFaces() ) {
+                                return false;
+                        }
+                        for ( size_t i = 0 ; i < m0.getNumVertices() ; ++i ) {
+                                if ( ( m0.getPosition ( i ) - m1.getPosition ( i ) ).norm() > 1.0e-9 ) {
+                                        return false;
+                                }
+                        }
+                        return true;
+                };
+
+                sphere ( mi4::Point3i ( 12, 10, 9 ) );
+                mi4::VolumeDataPolygonizer<float> polygonizer ( volume );
+                for ( const float isovalue : {3.0f, 5.0f, 8.0f} ) {
+                        const auto mesh = polygonizer.polygonize ( isovalue );
+                        ASSERT_EQUALS ( true, mesh.getNumFaces() > 0 );
+                        ASSERT_EQUALS ( true, is_near ( polygonize ( isovalue ), mesh ) );
+                }
+
+                // the pyramid is rebuilt after update().
+                sphere ( mi4::Point3i ( 27, 25, 20 ) );
+                polygonizer.update();
+                ASSERT_EQUALS ( true, is_near ( polygonize ( 5.0f ), polygonizer.polygonize ( 5.0f ) ) );
+                return ;
+        }
+};
+
+static VolumeDataPolygonizerTest test;
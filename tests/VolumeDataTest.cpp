@@ -1,5 +1,6 @@
 #include "mi4/Test.hpp"
 #include "mi4/VolumeData.hpp"
+#include <cstdio>
 class VolumeDataTest : public mi4::TestCase
 {
 public:
@@ -11,6 +12,11 @@ public:
         void init ( void )
         {
                 this->add ( VolumeDataTest::test_default_constructor ) ;
+                this->add ( VolumeDataTest::test_contiguous ) ;
+                this->add ( VolumeDataTest::test_open_unallocated ) ;
+                this->add ( VolumeDataTest::test_map ) ;
+                this->add ( VolumeDataTest::test_map_save_same_file ) ;
+                this->add ( VolumeDataTest::test_map_failure ) ;
                 return ;
         }
 
@@ -20,5 +26,139 @@ public:
                 ASSERT_EQUALS (static_cast<int> ( data.isReadable()), static_cast<int> ( true ));
                 return ;
         }
+
+        static void test_contiguous ( void )
+        {
+                mi4::VolumeData<short> data ( mi4::Point3i ( 5, 4, 3 ) );
+                ASSERT_EQUALS ( static_cast<int> ( data.isReadable() ), static_cast<int> ( true ) );
+                ASSERT_EQUALS ( static_cast<size_t> ( 60 ), data.getNumVoxels() );
+                ASSERT_EQUALS ( static_cast<uintptr_t> ( 0 ), reinterpret_cast<uintptr_t> ( data.data() ) % 64 );
+                ASSERT_EQUALS ( static_cast<int64_t> ( 1 ), data.stride().x() );
+                ASSERT_EQUALS ( static_cast<int64_t> ( 5 ), data.stride().y() );
+                ASSERT_EQUALS ( static_cast<int64_t> ( 20 ), data.stride().z() );
+
+                data.at ( 2, 3, 1 ) = 7;
+                ASSERT_EQUALS ( static_cast<short> ( 7 ), data.data()[2 + 3 * 5 + 1 * 20] );
+                ASSERT_EQUALS ( static_cast<short> ( 7 ), data.data ( 3, 1 )[2] );
+
+                mi4::VolumeData<short> copied;
+                copied.clone ( data );
+                ASSERT_EQUALS ( static_cast<short> ( 7 ), copied.get ( mi4::Point3i ( 2, 3, 1 ) ) );
+                return ;
+        }
+
+        static void test_open_unallocated ( void )
+        {
+                const std::string filename ( "volume_data_test_unallocated.raw" );
+                const mi4::VolumeInfo info ( mi4::Point3i ( 4, 4, 4 ) );
+                {
+                        std::ofstream fout ( filename.c_str(), std::ios::binary );
+                        const std::vector<char> bytes ( 64, 1 );
+                        fout.write ( bytes.data(), static_cast<std::streamsize> ( bytes.size() ) );
+                }
+
+                mi4::VolumeData<char> data ( info, false );
+                ASSERT_EQUALS ( static_cast<int> ( false ), static_cast<int> ( data.open ( filename ) ) );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( data.allocate() ) );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( data.open ( filename ) ) );
+                ASSERT_EQUALS ( static_cast<char> ( 1 ), data.get ( mi4::Point3i ( 3, 3, 3 ) ) );
+                std::remove ( filename.c_str() );
+                return ;
+        }
+
+        static void test_map ( void )
+        {
+                const std::string filename ( "volume_data_test_map.raw" );
+                const mi4::VolumeInfo info ( mi4::Point3i ( 7, 6, 5 ) );
+                mi4::VolumeData<short> data ( info );
+
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        data.set ( p, static_cast<short> ( info.toIndex ( p ) ) );
+                }
+                {
+                        std::ofstream fout ( filename.c_str(), std::ios::binary );
+                        const int header = 0x12345678;
+                        fout.write ( reinterpret_cast<const char*> ( &header ), sizeof ( header ) );
+                        data.write ( fout );
+                }
+
+                mi4::VolumeData<short> mapped ( info, false );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( mapped.map ( filename, sizeof ( int ), false ) ) );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( mapped.isReadable() ) );
+                mapped.advise ( mi4::MappedFile::Access::Sequential );
+                ASSERT_EQUALS ( static_cast<short> ( info.toIndex ( mi4::Point3i ( 3, 4, 2 ) ) ), mapped.get ( mi4::Point3i ( 3, 4, 2 ) ) );
+
+                mapped.set ( mi4::Point3i ( 1, 2, 3 ), -1 );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( mapped.save ( filename ) ) );
+
+                mi4::VolumeData<short> loaded ( info );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( loaded.open ( filename, sizeof ( int ) ) ) );
+                ASSERT_EQUALS ( static_cast<short> ( -1 ), loaded.get ( mi4::Point3i ( 1, 2, 3 ) ) );
+
+                mi4::VolumeData<short> copied ( mapped );
+                ASSERT_EQUALS ( static_cast<int> ( false ), static_cast<int> ( copied.isMapped() ) );
+                ASSERT_EQUALS ( static_cast<short> ( -1 ), copied.get ( mi4::Point3i ( 1, 2, 3 ) ) );
+                mapped.release();
+                std::remove ( filename.c_str() );
+                return ;
+        }
+
+        static void test_map_save_same_file ( void )
+        {
+                const std::string filename ( "volume_data_test_map_same.raw" );
+                const mi4::VolumeInfo info ( mi4::Point3i ( 7, 6, 5 ) );
+                mi4::VolumeData<short> data ( info );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        data.set ( p, static_cast<short> ( info.toIndex ( p ) ) );
+                }
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( data.save ( filename ) ) );
+
+                // read-only mapping saved to the same file under another name.
+                mi4::VolumeData<short> mapped ( info, false );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( mapped.map ( filename ) ) );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( mapped.save ( "./" + filename ) ) );
+                ASSERT_EQUALS ( static_cast<short> ( info.toIndex ( mi4::Point3i ( 6, 5, 4 ) ) ), mapped.get ( mi4::Point3i ( 6, 5, 4 ) ) );
+
+                mi4::VolumeData<short> loaded ( info );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( loaded.open ( filename ) ) );
+                for ( const auto& p : mi4::Range ( info ) ) {
+                        ASSERT_EQUALS ( data.get ( p ), loaded.get ( p ) );
+                }
+
+                // private modifications are saved.
+                mi4::VolumeData<short> cow ( info, false );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( cow.map ( filename, 0, mi4::MappedFile::Mode::CopyOnWrite ) ) );
+                cow.set ( mi4::Point3i ( 1, 2, 3 ), -1 );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( cow.save ( filename ) ) );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( loaded.open ( filename ) ) );
+                ASSERT_EQUALS ( static_cast<short> ( -1 ), loaded.get ( mi4::Point3i ( 1, 2, 3 ) ) );
+                ASSERT_EQUALS ( data.get ( mi4::Point3i ( 6, 5, 4 ) ), loaded.get ( mi4::Point3i ( 6, 5, 4 ) ) );
+
+                mapped.release();
+                cow.release();
+                std::remove ( filename.c_str() );
+                return ;
+        }
+
+        static void test_map_failure ( void )
+        {
+                const std::string filename ( "volume_data_test_map_failure.raw" );
+                const mi4::VolumeInfo info ( mi4::Point3i ( 7, 6, 5 ) );
+                {
+                        // too short.
+                        std::ofstream fout ( filename.c_str(), std::ios::binary );
+                        fout << "short";
+                }
+
+                mi4::VolumeData<short> data ( info );
+                data.fill ( 3 );
+                ASSERT_EQUALS ( static_cast<int> ( false ), static_cast<int> ( data.map ( "volume_data_test_map_missing.raw" ) ) );
+                ASSERT_EQUALS ( static_cast<int> ( false ), static_cast<int> ( data.map ( filename ) ) );
+                ASSERT_EQUALS ( static_cast<int> ( false ), static_cast<int> ( data.isMapped() ) );
+                ASSERT_EQUALS ( static_cast<int> ( true ), static_cast<int> ( data.isReadable() ) );
+                ASSERT_EQUALS ( static_cast<short> ( 3 ), data.get ( mi4::Point3i ( 6, 5, 4 ) ) );
+                std::remove ( filename.c_str() );
+                return ;
+        }
 };
 static VolumeDataTest test;
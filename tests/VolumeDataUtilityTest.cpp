@@ -3,6 +3,7 @@
 //
 #include <mi4/Test.hpp>
 #include <mi4/VolumeDataUtility.hpp>
+#include <mi4/NarrowBandDistanceField.hpp>
 
 class VolumeDataUtilityTest : public mi4::TestCase {
 public:
@@ -14,6 +15,13 @@ public:
         void init (void)
         {
                 this->add(VolumeDataUtilityTest::test_default_constructor);
+                this->add(VolumeDataUtilityTest::test_statistics);
+                this->add(VolumeDataUtilityTest::test_morphology);
+                this->add(VolumeDataUtilityTest::test_morphology_box);
+                this->add(VolumeDataUtilityTest::test_elementwise);
+                this->add(VolumeDataUtilityTest::test_distance_field);
+                this->add(VolumeDataUtilityTest::test_signed_distance_field);
+                this->add(VolumeDataUtilityTest::test_watershed);
                 return;
         }
 
@@ -23,6 +31,302 @@ public:
                 ASSERT_EQUALS (static_cast<int> ( data.isReadable()), static_cast<int> ( true ));
                 return;
         }
+
+        static void test_statistics (void)
+        {
+                const mi4::VolumeInfo info(mi4::Point3i(31, 17, 11));
+                mi4::VolumeData< short > data(info);
+                std::vector< size_t > counts(10, 0);
+                double total = 0;
+
+                for ( const auto& p : mi4::Range(info)) {
+                        const auto v = static_cast<short> ((p.x() * 7 + p.y() * 3 + p.z()) % 10 - 3);
+                        data.set(p, v);
+                        counts[static_cast<size_t> (v + 3)] += 1;
+                        total += v;
+                }
+                data.set(mi4::Point3i(30, 16, 10), 100);
+                counts[static_cast<size_t> ((30 * 7 + 16 * 3 + 10) % 10)] -= 1;
+                total += 100 - ((30 * 7 + 16 * 3 + 10) % 10 - 3);
+
+                const auto mm = mi4::VolumeDataUtility::minmax(data);
+                ASSERT_EQUALS(static_cast<short> (-3), mm.first);
+                ASSERT_EQUALS(static_cast<short> (100), mm.second);
+                ASSERT_EPSILON_EQUALS(total, mi4::VolumeDataUtility::sum(data), 1.0e-9);
+
+                const auto hist = mi4::VolumeDataUtility::histogram(data, static_cast<short> (-3), static_cast<short> (6), 10);
+                ASSERT_EQUALS(static_cast<size_t> (10), hist.size());
+                for ( size_t i = 0 ; i < hist.size() ; ++i ) {
+                        ASSERT_EQUALS(counts[i], hist[i]);
+                }
+
+                const auto sum = mi4::parallel_transform_reduce(0, 1000, 0, [] (const size_t i) { return static_cast<int> (i); }, std::plus< int >(), 7);
+                ASSERT_EQUALS(999 * 1000 / 2, sum);
+                return;
+        }
+
+        static mi4::VolumeData< char > create_mask (const mi4::VolumeInfo& info)
+        {
+                mi4::VolumeData< char > mask(info);
+                for ( const auto& p : mi4::Range(info)) {
+                        const auto v = (p.x() * 131 + p.y() * 71 + p.z() * 29) % 97;
+                        mask.set(p, static_cast<char> (v < 6 || (p - mi4::Point3i(9, 8, 7)).squaredNorm() < 16));
+                }
+                return mask;
+        }
+
+        static void test_morphology (void)
+        {
+                const mi4::VolumeInfo info(mi4::Point3i(19, 17, 15), mi4::Point3d(1.0, 1.5, 0.7));
+                const auto mask = create_mask(info);
+
+                for ( const auto r : {0.0, 1.0, 2.3, 3.5} ) {
+                        for ( const auto isDilate : {true, false} ) {
+                                mi4::VolumeData< char > expected(info);
+                                mi4::VolumeDataUtility::morphology morph(mask, expected, r, isDilate);
+                                for ( const auto& p : mi4::Range(info)) {
+                                        morph(p);
+                                }
+                                const auto actual = isDilate ? mi4::VolumeDataUtility::dilate(mask, r) : mi4::VolumeDataUtility::erode(mask, r);
+                                for ( const auto& p : mi4::Range(info)) {
+                                        ASSERT_EQUALS(expected.get(p), actual.get(p));
+                                }
+                        }
+                }
+
+                mi4::VolumeData< char > empty(info);
+                ASSERT_EQUALS(static_cast<char> (0), mi4::VolumeDataUtility::dilate(empty, 2.0).get(mi4::Point3i(3, 3, 3)));
+                ASSERT_EQUALS(static_cast<char> (1), mi4::VolumeDataUtility::erode(empty.fill(1), 2.0).get(mi4::Point3i(3, 3, 3)));
+                return;
+        }
+
+        static void test_morphology_box (void)
+        {
+                const mi4::VolumeInfo info(mi4::Point3i(21, 13, 11));
+                const auto mask = create_mask(info);
+                const mi4::Point3i k(3, 1, 2);
+                const auto dilated = mi4::VolumeDataUtility::dilateBox(mask, k);
+                const auto eroded = mi4::VolumeDataUtility::erodeBox(mask, k);
+
+                for ( const auto& p : mi4::Range(info)) {
+                        char mx = 0;
+                        char mn = 1;
+                        for ( const auto& d : mi4::Range(-k, k)) {
+                                if ( info.isValid(p + d)) {
+                                        mx = std::max(mx, mask.get(p + d));
+                                        mn = std::min(mn, mask.get(p + d));
+                                }
+                        }
+                        ASSERT_EQUALS(mx, dilated.get(p));
+                        ASSERT_EQUALS(mn, eroded.get(p));
+                }
+                return;
+        }
+
+        template < typename T >
+        static void check_elementwise (const T threshold)
+        {
+                const mi4::VolumeInfo info(mi4::Point3i(37, 5, 3));
+                mi4::VolumeData< T > data(info);
+                for ( const auto& p : mi4::Range(info)) {
+                        data.set(p, static_cast<T> ((p.x() * 13 + p.y() * 7 + p.z() * 5) % 120 - ((std::is_signed< T >::value) ? 60 : 0)));
+                }
+
+                const auto binary = mi4::VolumeDataUtility::binarize(data, threshold, char(3));
+                const auto negated = mi4::VolumeDataUtility::negate_binary(data);
+                const auto casted = mi4::VolumeDataUtility::cast< T, double >(data);
+                const auto floats = mi4::VolumeDataUtility::cast< T, float >(data);
+                const auto fromFloats = mi4::VolumeDataUtility::cast< float, T >(floats);
+                const auto swapped = mi4::VolumeDataUtility::changeEndian(data);
+                const auto restored = mi4::VolumeDataUtility::changeEndian(swapped);
+
+                for ( const auto& p : mi4::Range(info)) {
+                        const T v = data.get(p);
+                        ASSERT_EQUALS(static_cast<char> ((v < threshold) ? 0 : 3), binary.get(p));
+                        ASSERT_EQUALS(static_cast<T> (1 - v), negated.get(p));
+                        ASSERT_EQUALS(static_cast<double> (v), casted.get(p));
+                        ASSERT_EQUALS(static_cast<float> (v), floats.get(p));
+                        ASSERT_EQUALS(v, fromFloats.get(p));
+                        ASSERT_EQUALS(v, restored.get(p));
+
+                        const T s = swapped.get(p);
+                        const auto* b0 = reinterpret_cast<const unsigned char *> (&v);
+                        const auto* b1 = reinterpret_cast<const unsigned char *> (&s);
+                        for ( size_t i = 0 ; i < sizeof(T) ; ++i ) {
+                                ASSERT_EQUALS(b0[i], b1[sizeof(T) - 1 - i]);
+                        }
+                }
+                return;
+        }
+
+        /**
+         * Fractional floats are truncated toward zero.
+         */
+        template < typename S >
+        static void check_cast_from_float (void)
+        {
+                const mi4::VolumeInfo info(mi4::Point3i(37, 5, 3));
+                mi4::VolumeData< float > data(info);
+                const float lo = std::is_signed< S >::value ? -100.0f : 0.0f;
+                for ( const auto& p : mi4::Range(info)) {
+                        data.set(p, lo + static_cast<float> ((p.x() * 13 + p.y() * 7 + p.z() * 5) % 200) * 0.75f);
+                }
+                const auto casted = mi4::VolumeDataUtility::cast< float, S >(data);
+                for ( const auto& p : mi4::Range(info)) {
+                        ASSERT_EQUALS(static_cast<S> (data.get(p)), casted.get(p));
+                }
+                return;
+        }
+
+        static void test_elementwise (void)
+        {
+                const auto detected = mi4::simd::getInstructionSet();
+                for ( const auto isa : {mi4::simd::InstructionSet::Scalar, mi4::simd::InstructionSet::SSE2, mi4::simd::InstructionSet::SSSE3, mi4::simd::InstructionSet::AVX2} ) {
+                        mi4::simd::setInstructionSet(isa);
+                        check_elementwise< uint8_t >(50);
+                        check_elementwise< int8_t >(-5);
+                        check_elementwise< char >(10);
+                        check_elementwise< uint16_t >(40);
+                        check_elementwise< int16_t >(-20);
+                        check_elementwise< int32_t >(7);
+                        check_elementwise< uint32_t >(70);
+                        check_elementwise< float >(2.5f);
+                        check_elementwise< double >(-0.5);
+                        check_cast_from_float< uint8_t >();
+                        check_cast_from_float< int8_t >();
+                        check_cast_from_float< char >();
+                        check_cast_from_float< uint16_t >();
+                        check_cast_from_float< int16_t >();
+                }
+                mi4::simd::setInstructionSet(detected);
+                return;
+        }
+
+        static void test_distance_field (void)
+        {
+                const mi4::VolumeInfo info(mi4::Point3i(19, 14, 11), mi4::Point3d(0.8, 1.0, 1.7));
+                mi4::VolumeData< char > binary(info);
+                std::vector< mi4::Point3i > sites;
+                for ( const auto& p : mi4::Range(info)) {
+                        const bool isSite = (p.x() * 37 + p.y() * 17 + p.z() * 91) % 211 == 0;
+                        binary.set(p, isSite ? 0 : 1);
+                        if ( isSite ) {
+                                sites.push_back(p);
+                        }
+                }
+
+                const auto vec = mi4::VolumeDataUtility::distance_field(binary);
+                const auto dist = mi4::VolumeDataUtility::distance_map(binary);
+                for ( const auto& p : mi4::Range(info)) {
+                        float best = std::numeric_limits< float >::max();
+                        for ( const auto& q : sites ) {
+                                best = std::min(best, info.getLengthSquared(q - p));
+                        }
+                        const mi4::Point3i v = vec.get(p).cast< int >();
+                        ASSERT_EQUALS(true, std::fabs(std::sqrt(best) - dist.get(p)) < 1.0e-4f);
+                        ASSERT_EQUALS(true, std::fabs(best - info.getLengthSquared(v)) < 1.0e-3f);
+                        ASSERT_EQUALS(0, static_cast<int> (binary.get(p + v)));
+                }
+
+                binary.fill(1);
+                const auto empty = mi4::VolumeDataUtility::distance_map(binary);
+                ASSERT_EQUALS(true, std::isinf(empty.at(0, 0, 0)));
+                return;
+        }
+
+        static void test_signed_distance_field (void)
+        {
+                const mi4::VolumeInfo info(mi4::Point3i(40, 36, 30), mi4::Point3d(1.0, 1.0, 1.5));
+                mi4::VolumeData< char > mask(info);
+                for ( const auto& p : mi4::Range(info)) {
+                        const mi4::Point3d d = info.getPointInSpace(p) - mi4::Point3d(20, 18, 22);
+                        mask.set(p, static_cast<char> (d.norm() < 12.0));
+                }
+
+                const auto sdf = mi4::VolumeDataUtility::signedDistanceField(mask);
+                mi4::VolumeData< char > inverted(info);
+                for ( const auto& p : mi4::Range(info)) {
+                        inverted.set(p, static_cast<char> (1 - mask.get(p)));
+                }
+                const auto outside = mi4::VolumeDataUtility::distance_map(inverted);
+                const auto inside = mi4::VolumeDataUtility::distance_map(mask);
+                for ( const auto& p : mi4::Range(info)) {
+                        const float expected = (mask.get(p) != 0) ? -inside.get(p) : outside.get(p);
+                        ASSERT_EQUALS(expected, sdf.get(p));
+                }
+
+                const float band = 3.0f;
+                const auto narrow = mi4::NarrowBandDistanceField::fromMask(mask, band);
+                const auto numBricks = narrow.getNumBricks();
+                ASSERT_EQUALS(true, narrow.getNumActiveBricks() < static_cast<size_t> (numBricks.prod()));
+                for ( const auto& p : mi4::Range(info)) {
+                        const float v = sdf.get(p);
+                        if ( std::fabs(v) < band ) {
+                                ASSERT_EQUALS(v, narrow.get(p));
+                        } else {
+                                ASSERT_EQUALS(true, std::fabs(narrow.get(p)) >= band && (v < 0) == (narrow.get(p) < 0));
+                        }
+                }
+
+                auto dense = narrow.toVolumeData();
+                const auto mesh = mi4::VolumeDataPolygonizer< float >(dense).polygonize(0.0f);
+                ASSERT_EQUALS(true, mesh.getNumFaces() > 0);
+                ASSERT_EQUALS(mesh.getNumFaces(), narrow.polygonize(0.0f).getNumFaces());
+                return;
+        }
+
+        static void test_watershed (void)
+        {
+                // two cones meeting at a pass of 1 - 10 / 16 and an island without seeds.
+                const mi4::VolumeInfo info(mi4::Point3i(41, 33, 25));
+                const mi4::Point3d c1(10, 16, 12), c2(30, 16, 12);
+                const double radius = 16;
+                const double pass = 1 - 10 / radius;
+                mi4::VolumeData< float > weight(info);
+                for ( const auto& p : mi4::Range(info)) {
+                        const double g1 = 1 - (p.cast< double >() - c1).norm() / radius;
+                        const double g2 = 1 - (p.cast< double >() - c2).norm() / radius;
+                        const bool isIsland = p.x() >= 38 && p.y() >= 30 && p.z() >= 22;
+                        weight.set(p, isIsland ? 0.5f : static_cast<float> (std::max(0.0, std::max(g1, g2))));
+                }
+
+                // slab sizes, and numLevels = 0 (exact).
+                for ( const int slabSize : {0, 1, 3, 7, 25, -1} ) {
+                        mi4::VolumeData< int > label(info);
+                        label.set(c1.cast< int >(), 1);
+                        label.set(c2.cast< int >(), 2);
+                        mi4::VolumeDataUtility::watershed(label, weight, (slabSize < 0) ? 0 : 4096, std::max(slabSize, 0));
+
+                        for ( const auto& p : mi4::Range(info)) {
+                                const float w = weight.get(p);
+                                const bool isIsland = p.x() >= 38 && p.y() >= 30 && p.z() >= 22;
+                                if ( w <= 0 || isIsland ) {
+                                        ASSERT_EQUALS(0, label.get(p));
+                                } else if ( w > pass + 0.1 ) {
+                                        const bool isNear1 = (p.cast< double >() - c1).norm() < (p.cast< double >() - c2).norm();
+                                        ASSERT_EQUALS(isNear1 ? 1 : 2, label.get(p));
+                                } else {
+                                        ASSERT_EQUALS(true, label.get(p) == 1 || label.get(p) == 2);
+                                }
+                        }
+                }
+
+                // weights closer than a level apart are still ordered.
+                const mi4::VolumeInfo lineInfo(mi4::Point3i(5, 1, 1));
+                mi4::VolumeData< float > lineWeight(lineInfo);
+                const float w[5] = {1.0f, 0.5f + 1.0e-6f, 0.4f, 0.5f, 1.0f};
+                for ( int x = 0 ; x < 5 ; ++x ) {
+                        lineWeight.set(mi4::Point3i(x, 0, 0), w[x]);
+                }
+                mi4::VolumeData< int > lineLabel(lineInfo);
+                lineLabel.set(mi4::Point3i(0, 0, 0), 1);
+                lineLabel.set(mi4::Point3i(4, 0, 0), 2);
+                mi4::VolumeDataUtility::watershed(lineLabel, lineWeight, 0);
+                ASSERT_EQUALS(1, lineLabel.get(mi4::Point3i(1, 0, 0)));
+                ASSERT_EQUALS(1, lineLabel.get(mi4::Point3i(2, 0, 0)));
+                ASSERT_EQUALS(2, lineLabel.get(mi4::Point3i(3, 0, 0)));
+                return;
+        }
 };
 
 static VolumeDataUtilityTest test;
@@ -56,7 +56,7 @@ public:
 
                 mi4::Point3i p0(50, 50, 50);
                 auto p1 = info.getPointInSpace(p0);
-                auto p2 = mi4::Point3d(p0.x() * pitch.x(), p0.y() * pitch.y(), p0.z() * pitch.z()) + origin;
+                const mi4::Point3d p2 = mi4::Point3d(p0.x() * pitch.x(), p0.y() * pitch.y(), p0.z() * pitch.z()) + origin;
                 ASSERT_EQUALS(p2.x(), p1.x());
                 ASSERT_EQUALS(p2.y(), p1.y());
                 ASSERT_EQUALS(p2.z(), p1.z());